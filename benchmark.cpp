@@ -0,0 +1,823 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cherry.hpp"
+
+#ifndef CHERRY_BENCHMARK_BUILD_TYPE
+#define CHERRY_BENCHMARK_BUILD_TYPE "unknown"
+#endif
+
+
+// Headless micro-benchmarks: every primitive and Copy path is timed on its own, once per blend policy, over several
+// canvas and sprite sizes. Each case is calibrated so a sample takes at least the minimum sample time, and the
+// per-sample cost is reported as ns per touched pixel and Mpix/s at the median and the 99th percentile.
+
+
+struct Options {
+    int Samples{ 50 };
+    std::chrono::nanoseconds MinSampleTime{ std::chrono::microseconds{ 500 } };
+    std::string Filter;
+    std::string Format{ "table" };
+    std::string Output;
+    bool List{ false };
+};
+
+
+struct Case {
+    std::string Name;
+    std::string Blend;
+    int CanvasWidth{ 0 };
+    int CanvasHeight{ 0 };
+    int Size{ 0 };
+
+    // Draw uses the case's blend policy; Probe draws the same geometry with Overwrite to count touched pixels.
+    std::function<void(cherry::Canvas &)> Draw;
+    std::function<void(cherry::Canvas &)> Probe;
+
+
+    [[nodiscard]]
+    auto Id() const -> std::string {
+        return Name + "/" + Blend + "/" + std::to_string(CanvasWidth) + "x" + std::to_string(CanvasHeight) + "/"
+               + std::to_string(Size);
+    }
+};
+
+
+struct Result {
+    const Case * Source{ nullptr };
+    int64_t Pixels{ 0 };
+    int64_t Iterations{ 0 };
+    double P50NsPerPixel{ 0.0 };
+    double P99NsPerPixel{ 0.0 };
+
+
+    [[nodiscard]]
+    auto P50MpixPerSecond() const -> double {
+        return 1000.0 / P50NsPerPixel;
+    }
+
+
+    [[nodiscard]]
+    auto P99MpixPerSecond() const -> double {
+        return 1000.0 / P99NsPerPixel;
+    }
+};
+
+
+// A soft-edged disc with an opaque core, a translucent rim and transparent corners, so the alpha fast paths all fire.
+auto MakeImage(
+        int width,
+        int height) -> std::vector<uint32_t> {
+    auto pixels = cherry::utility::PixelBuffer(width, height);
+    const auto radius = 0.5f * static_cast<float>(std::min(width, height));
+
+    for (auto y = 0; y < height; y += 1) {
+        for (auto x = 0; x < width; x += 1) {
+            const auto dx = static_cast<float>(x) + 0.5f - 0.5f * static_cast<float>(width);
+            const auto dy = static_cast<float>(y) + 0.5f - 0.5f * static_cast<float>(height);
+            const auto distance = std::sqrt(dx * dx + dy * dy) / radius;
+            const auto alpha = std::clamp((1.0f - distance) * 4.0f, 0.0f, 1.0f);
+
+            pixels[width * y + x] = cherry::color::FromRGBA(
+                    static_cast<uint8_t>(255 * x / width),
+                    static_cast<uint8_t>(255 * y / height),
+                    160,
+                    static_cast<uint8_t>(std::lround(255.0f * alpha))
+            );
+        }
+    }
+
+    return pixels;
+}
+
+
+// Keeps one sprite size's source representations alive for the cases that reference them.
+struct Fixture {
+    int Size{ 0 };
+    std::vector<uint32_t> Pixels;
+    cherry::ConstCanvas Image;
+    cherry::Sprite Runs;
+    cherry::transform::MipChain Mips;
+
+
+    explicit Fixture(
+            int size)
+            :
+            Size(size),
+            Pixels(MakeImage(size, size)),
+            Image(Pixels.data(), size, size),
+            Runs(Image),
+            Mips(Image) {}
+};
+
+
+auto Additive(
+        uint32_t foreground,
+        uint32_t background) -> uint32_t {
+    const auto channel = [&](uint32_t shift) {
+        return std::min<uint32_t>(255, ((foreground >> shift) & 0xFF) + ((background >> shift) & 0xFF)) << shift;
+    };
+
+    return channel(0) | channel(8) | channel(16) | channel(24);
+}
+
+
+auto Clear(
+        cherry::Canvas & canvas,
+        uint32_t color) -> void {
+    for (auto y = 0; y < canvas.Height; y += 1) {
+        std::fill_n(canvas.Row(y), canvas.Width, color);
+    }
+}
+
+
+template<typename Blend, typename Geometry>
+auto MakeCase(
+        const std::string & name,
+        const std::string & blend_name,
+        int canvas_width,
+        int canvas_height,
+        int size,
+        const Geometry & geometry) -> Case {
+    return {
+            name,
+            blend_name,
+            canvas_width,
+            canvas_height,
+            size,
+            [geometry](cherry::Canvas & canvas) { geometry(canvas, Blend{}); },
+            [geometry](cherry::Canvas & canvas) { geometry(canvas, cherry::color::Overwrite{}); }
+    };
+}
+
+
+// Geometry is a callable (Canvas &, const Blend &) that draws the case once with whichever policy it is given.
+template<typename Geometry>
+auto AddBlendCases(
+        std::vector<Case> & cases,
+        const std::string & name,
+        int canvas_width,
+        int canvas_height,
+        int size,
+        const Geometry & geometry) -> void {
+    using namespace cherry::color;
+
+    cases.push_back(MakeCase<Overwrite>(name, "Overwrite", canvas_width, canvas_height, size, geometry));
+    cases.push_back(MakeCase<AlphaBlend>(name, "AlphaBlend", canvas_width, canvas_height, size, geometry));
+    cases.push_back(MakeCase<FastAlphaBlend>(name, "FastAlphaBlend", canvas_width, canvas_height, size, geometry));
+    cases.push_back(
+            MakeCase<PremultipliedOver>(name, "PremultipliedOver", canvas_width, canvas_height, size, geometry)
+    );
+    cases.push_back(MakeCase<Function<Additive>>(name, "Function", canvas_width, canvas_height, size, geometry));
+}
+
+
+auto AddCopyCases(
+        std::vector<Case> & cases,
+        const Fixture & fixture,
+        int width,
+        int height,
+        cherry::parallel::WorkerPool & pool) -> void {
+    using cherry::transform::Transform;
+    using cherry::transform::Sampling;
+
+    const auto size = fixture.Size;
+    const auto x = width / 2;
+    const auto y = height / 2;
+    const auto & image = fixture.Image;
+    const auto & runs = fixture.Runs;
+    const auto & mips = fixture.Mips;
+
+    const auto copy = [&](const std::string & name, const Transform & tf) {
+        AddBlendCases(cases, name, width, height, size, [&image, x, y, tf](cherry::Canvas & canvas, const auto & blend) {
+            using Blend = std::decay_t<decltype(blend)>;
+            cherry::transform::Copy<Blend>(image, canvas, x, y, tf, blend);
+        });
+    };
+
+    const auto center = size / 2;
+
+    copy("copy.blit", { .OriginX = center, .OriginY = center });
+    copy("copy.mirrored", { .OriginX = center, .OriginY = center, .ScaleX = -1.0f });
+    copy("copy.scaled", { .OriginX = center, .OriginY = center, .ScaleX = 1.5f, .ScaleY = 0.75f });
+    copy("copy.rotated", { .RotationRadians = 0.6f, .OriginX = center, .OriginY = center });
+    copy("copy.rotated_scaled", {
+            .RotationRadians = 0.6f, .OriginX = center, .OriginY = center, .ScaleX = 1.25f, .ScaleY = 0.8f
+    });
+    copy("copy.rotated_bilinear", {
+            .RotationRadians = 0.6f, .OriginX = center, .OriginY = center, .Filter = Sampling::Bilinear
+    });
+
+    const auto quarter = size / 4;
+    const auto source = cherry::utility::Rect{ quarter, quarter, size - quarter, size - quarter };
+    AddBlendCases(cases, "copy.source_rect", width, height, size,
+                  [&image, source, x, y, center](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::transform::Copy<Blend>(
+                              image, source, canvas, x, y,
+                              { .RotationRadians = 0.6f, .OriginX = center / 2, .OriginY = center / 2 },
+                              blend
+                      );
+                  });
+
+    AddBlendCases(cases, "copy.rotated_pooled", width, height, size,
+                  [&image, &pool, x, y, center](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::parallel::Copy<Blend>(
+                              pool, image, canvas, x, y,
+                              { .RotationRadians = 0.6f, .OriginX = center, .OriginY = center },
+                              blend
+                      );
+                  });
+
+    AddBlendCases(cases, "copy.sprite_runs", width, height, size,
+                  [&runs, x, y, center](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::transform::Copy<Blend>(runs, canvas, x, y, { .OriginX = center, .OriginY = center }, blend);
+                  });
+
+    AddBlendCases(cases, "copy.mip_minified", width, height, size,
+                  [&mips, x, y, center](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::transform::Copy<Blend>(
+                              mips, canvas, x, y,
+                              { .RotationRadians = 0.3f, .OriginX = center, .OriginY = center, .ScaleX = 0.3f, .ScaleY = 0.3f },
+                              blend
+                      );
+                  });
+}
+
+
+// Many small instances drawn from one atlas of ATLAS_CELL-sized cells, to time the per-instance setup and binning
+// of CopyBatch as well as its drawing. The case size is the instance count.
+auto AddBatchCases(
+        std::vector<Case> & cases,
+        const Fixture & atlas,
+        int width,
+        int height,
+        int count,
+        cherry::parallel::WorkerPool & pool) -> void {
+    using cherry::transform::Instance;
+
+    constexpr auto ATLAS_CELL = 16;
+    const auto cells = atlas.Size / ATLAS_CELL;
+
+    auto random = std::mt19937(count);
+    auto instances = std::make_shared<std::vector<Instance>>();
+    instances->reserve(count);
+
+    for (auto i = 0; i < count; i += 1) {
+        const auto cell = static_cast<int>(random() % (cells * cells));
+        const auto left = ATLAS_CELL * (cell % cells);
+        const auto top = ATLAS_CELL * (cell / cells);
+
+        auto instance = Instance{
+                static_cast<int>(random() % width),
+                static_cast<int>(random() % height),
+                { .OriginX = ATLAS_CELL / 2, .OriginY = ATLAS_CELL / 2 },
+                { left, top, left + ATLAS_CELL, top + ATLAS_CELL }
+        };
+
+        // A quarter of the instances rotate and another eighth scale, so both batch paths are in the mix
+        if (0 == i % 4) {
+            instance.Tf.RotationRadians = 0.1f * static_cast<float>(i % 31);
+        }
+        else if (1 == i % 8) {
+            instance.Tf.ScaleX = 1.5f;
+            instance.Tf.ScaleY = 1.5f;
+        }
+
+        instances->push_back(instance);
+    }
+
+    const auto & image = atlas.Image;
+
+    AddBlendCases(cases, "copy.batch", width, height, count,
+                  [&image, instances](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::transform::CopyBatch<Blend>(image, canvas, *instances, blend);
+                  });
+
+    AddBlendCases(cases, "copy.batch_pooled", width, height, count,
+                  [&image, &pool, instances](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::parallel::CopyBatch<Blend>(pool, image, canvas, *instances, blend);
+                  });
+}
+
+
+auto AddCanvasCases(
+        std::vector<Case> & cases,
+        const std::vector<uint32_t> & background,
+        int width,
+        int height) -> void {
+    const auto source = cherry::ConstCanvas(background.data(), width, height);
+
+    AddBlendCases(cases, "copy.background", width, height, 0,
+                  [source](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::transform::Copy<Blend>(source, canvas, 0, 0, {}, blend);
+                  });
+
+    AddBlendCases(cases, "blend.span", width, height, 0, [source](cherry::Canvas & canvas, const auto & blend) {
+        for (auto y = 0; y < canvas.Height; y += 1) {
+            cherry::color::BlendSpan(canvas.Row(y), source.Data + source.Stride * y, canvas.Width, blend);
+        }
+    });
+
+    AddBlendCases(cases, "blend.fill", width, height, 0, [](cherry::Canvas & canvas, const auto & blend) {
+        const auto color = cherry::color::FromRGBA(40, 120, 200, 160);
+        for (auto y = 0; y < canvas.Height; y += 1) {
+            cherry::color::FillSpan(canvas.Row(y), color, canvas.Width, blend);
+        }
+    });
+
+    const auto bounds = cherry::utility::Rect{ 0, 0, width, height };
+    const auto ramp = cherry::drawing::GradientRamp(
+            cherry::color::FromRGBA(0, 128, 192, 192),
+            cherry::color::FromRGBA(255, 0, 192, 192)
+    );
+
+    AddBlendCases(cases, "fill_rect", width, height, 0, [bounds](cherry::Canvas & canvas, const auto & blend) {
+        using Blend = std::decay_t<decltype(blend)>;
+        cherry::drawing::FillRect<Blend>(canvas, bounds, cherry::color::FromRGBA(40, 120, 200, 160), blend);
+    });
+
+    const auto linear = cherry::drawing::LinearGradient{
+            .X1 = static_cast<float>(width), .Y1 = static_cast<float>(height), .Ramp = ramp
+    };
+    AddBlendCases(cases, "fill_rect.linear", width, height, 0,
+                  [bounds, linear](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::drawing::FillRect<Blend>(canvas, bounds, linear, blend);
+                  });
+
+    const auto radial = cherry::drawing::RadialGradient{
+            .CenterX = static_cast<float>(width) / 2.0f,
+            .CenterY = static_cast<float>(height) / 2.0f,
+            .Radius = static_cast<float>(std::min(width, height)) / 2.0f,
+            .Ramp = ramp
+    };
+    AddBlendCases(cases, "fill_rect.radial", width, height, 0,
+                  [bounds, radial](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      cherry::drawing::FillRect<Blend>(canvas, bounds, radial, blend);
+                  });
+
+    const auto clear = [](cherry::Canvas & canvas) {
+        cherry::drawing::Clear(canvas, cherry::color::FromRGBA(16, 32, 48, 255));
+    };
+    cases.push_back({ "clear", "Overwrite", width, height, 0, clear, clear });
+
+    const auto swizzle = [source](cherry::Canvas & canvas) {
+        cherry::transform::Swizzle<cherry::color::PixelLayout, cherry::color::BGRA>(source, canvas);
+    };
+    cases.push_back({ "swizzle.bgra", "Overwrite", width, height, 0, swizzle, swizzle });
+
+    // A static backdrop under three translucent layers that move every frame; multipass composites the same stack
+    // with one full Copy per layer
+    const auto compositor = std::make_shared<cherry::render::Compositor>();
+    auto backdrop = compositor->AddLayer<cherry::color::Overwrite>(width, height).Pixels();
+    cherry::transform::Copy<cherry::color::Overwrite>(source, backdrop);
+    for (auto i = 0; i < 3; i += 1) {
+        auto & layer = compositor->AddLayer<cherry::color::FastAlphaBlend>(width / 2, height / 2);
+        auto pixels = layer.Pixels();
+        cherry::transform::Copy<cherry::color::Overwrite>(source, pixels, -i * width / 8, -i * height / 8);
+        layer.Opacity = 0xC0;
+    }
+    const auto frame = std::make_shared<int>(0);
+    const auto movement = [compositor, frame, width, height]() {
+        *frame += 1;
+        for (auto i = 1; i < compositor->LayerCount(); i += 1) {
+            auto & layer = (*compositor)[i];
+            layer.X = (*frame * 3 * i) % (width / 2);
+            layer.Y = (*frame * 2 * i) % (height / 2);
+        }
+    };
+
+    const auto composite = [compositor, movement](cherry::Canvas & canvas) {
+        movement();
+        compositor->Flatten(canvas);
+    };
+    cases.push_back({ "composite.layers", "Mixed", width, height, 0, composite, composite });
+
+    const auto multipass = [compositor, movement](cherry::Canvas & canvas) {
+        movement();
+        cherry::drawing::Clear(canvas);
+        for (auto i = 0; i < compositor->LayerCount(); i += 1) {
+            auto & layer = (*compositor)[i];
+            const auto pixels = cherry::ConstCanvas(layer.Pixels());
+            if (i) {
+                const auto blend = cherry::color::WithOpacity<cherry::color::FastAlphaBlend>(layer.Opacity);
+                cherry::transform::Copy<cherry::color::WithOpacity<cherry::color::FastAlphaBlend>>(
+                        pixels, canvas, layer.X, layer.Y, {}, blend
+                );
+            }
+            else {
+                cherry::transform::Copy<cherry::color::Overwrite>(pixels, canvas);
+            }
+        }
+    };
+    cases.push_back({ "composite.multipass", "Mixed", width, height, 0, multipass, multipass });
+
+    auto random = std::mt19937(1234);
+    const auto point = [&]() {
+        return std::make_pair(static_cast<int>(random() % width), static_cast<int>(random() % height));
+    };
+
+    auto segments = std::vector<std::pair<std::pair<int, int>, std::pair<int, int>>>(64);
+    for (auto & segment : segments) {
+        segment = { point(), point() };
+    }
+
+    const auto line_color = cherry::color::FromRGBA(255, 220, 40, 200);
+
+    AddBlendCases(cases, "line", width, height, 0, [segments, line_color](cherry::Canvas & canvas, const auto & blend) {
+        using Blend = std::decay_t<decltype(blend)>;
+        for (const auto &[a, b] : segments) {
+            cherry::drawing::Line<Blend>(canvas, a.first, a.second, b.first, b.second, line_color, blend);
+        }
+    });
+
+    AddBlendCases(cases, "line_aa", width, height, 0, [segments, line_color](cherry::Canvas & canvas, const auto & blend) {
+        using Blend = std::decay_t<decltype(blend)>;
+        for (const auto &[a, b] : segments) {
+            cherry::drawing::LineAA<Blend>(
+                    canvas,
+                    static_cast<float>(a.first) + 0.3f, static_cast<float>(a.second) + 0.6f,
+                    static_cast<float>(b.first) + 0.7f, static_cast<float>(b.second) + 0.2f,
+                    line_color,
+                    blend
+            );
+        }
+    });
+
+    auto polygons = std::vector<std::vector<std::pair<int, int>>>(16);
+    for (auto & polygon : polygons) {
+        for (auto i = 0; i < 6; i += 1) {
+            polygon.push_back(point());
+        }
+    }
+
+    const auto fill_color = cherry::color::FromRGBA(120, 40, 220, 128);
+
+    AddBlendCases(cases, "polygon", width, height, 0, [polygons, line_color](cherry::Canvas & canvas, const auto & blend) {
+        using Blend = std::decay_t<decltype(blend)>;
+        for (const auto & polygon : polygons) {
+            cherry::drawing::Polygon<Blend>(canvas, polygon, line_color, blend);
+        }
+    });
+
+    AddBlendCases(cases, "fill_polygon", width, height, 0,
+                  [polygons, fill_color](cherry::Canvas & canvas, const auto & blend) {
+                      using Blend = std::decay_t<decltype(blend)>;
+                      for (const auto & polygon : polygons) {
+                          cherry::drawing::FillPolygon<Blend>(
+                                  canvas, polygon, fill_color, cherry::drawing::FillRule::NonZero, blend
+                          );
+                      }
+                  });
+
+    // Triangles are measured at a small and a large size, since setup cost dominates the former.
+    for (const auto extent : { 16, std::min(width, height) / 2 }) {
+        auto triangles = std::vector<std::array<int, 6>>(64);
+        for (auto & triangle : triangles) {
+            const auto[x, y] = point();
+            triangle = {
+                    x, y,
+                    x + extent, y + static_cast<int>(random() % extent),
+                    x + static_cast<int>(random() % extent), y + extent
+            };
+        }
+
+        AddBlendCases(cases, "fill_triangle", width, height, extent,
+                      [triangles, fill_color](cherry::Canvas & canvas, const auto & blend) {
+                          using Blend = std::decay_t<decltype(blend)>;
+                          for (const auto & t : triangles) {
+                              cherry::drawing::FillTriangle<Blend>(
+                                      canvas, t[0], t[1], t[2], t[3], t[4], t[5], fill_color, blend
+                              );
+                          }
+                      });
+
+        AddBlendCases(cases, "fill_triangle_aa", width, height, extent,
+                      [triangles, fill_color](cherry::Canvas & canvas, const auto & blend) {
+                          using Blend = std::decay_t<decltype(blend)>;
+                          for (const auto & t : triangles) {
+                              cherry::drawing::FillTriangleAA<Blend>(
+                                      canvas,
+                                      static_cast<float>(t[0]) + 0.25f, static_cast<float>(t[1]) + 0.5f,
+                                      static_cast<float>(t[2]) + 0.75f, static_cast<float>(t[3]),
+                                      static_cast<float>(t[4]), static_cast<float>(t[5]) + 0.25f,
+                                      fill_color,
+                                      blend
+                              );
+                          }
+                      });
+    }
+}
+
+
+auto Percentile(
+        const std::vector<double> & sorted,
+        double percentile) -> double {
+    const auto rank = static_cast<size_t>(std::ceil(percentile * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+
+auto Run(
+        const Case & bench,
+        const Options & options) -> Result {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr auto SENTINEL = 0x01020304u;
+    const auto background = cherry::color::FromRGBA(16, 32, 48, 255);
+
+    auto buffer = cherry::utility::AlignedPixelBuffer(bench.CanvasWidth, bench.CanvasHeight);
+    auto canvas = cherry::Canvas(buffer);
+
+    Clear(canvas, SENTINEL);
+    bench.Probe(canvas);
+
+    auto pixels = int64_t{ 0 };
+    for (auto y = 0; y < canvas.Height; y += 1) {
+        const auto * row = canvas.Row(y);
+        pixels += canvas.Width - std::count(row, row + canvas.Width, SENTINEL);
+    }
+    pixels = std::max<int64_t>(pixels, 1);
+
+    Clear(canvas, background);
+
+    const auto time = [&](int64_t iterations) {
+        const auto begin = Clock::now();
+        for (auto i = int64_t{ 0 }; i < iterations; i += 1) {
+            bench.Draw(canvas);
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin);
+    };
+
+    const auto once = std::max(time(1).count(), int64_t{ 1 });
+    const auto iterations = std::clamp<int64_t>((options.MinSampleTime.count() + once - 1) / once, 1, 1'000'000);
+
+    auto samples = std::vector<double>();
+    samples.reserve(options.Samples);
+
+    for (auto s = 0; s < options.Samples; s += 1) {
+        const auto elapsed = static_cast<double>(time(iterations).count());
+        samples.push_back(elapsed / static_cast<double>(iterations * pixels));
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    return { &bench, pixels, iterations, Percentile(samples, 0.50), Percentile(samples, 0.99) };
+}
+
+
+auto SimdName() -> std::string {
+#if defined(CHERRY_SIMD_AVX2)
+    return "avx2";
+#elif defined(CHERRY_SIMD_SSE2)
+    return "sse2";
+#elif defined(CHERRY_SIMD_NEON)
+    return "neon";
+#else
+    return "none";
+#endif
+}
+
+
+auto WriteTable(
+        std::ostream & out,
+        const Result & result) -> void {
+    const auto & bench = *result.Source;
+
+    out << std::left << std::setw(60) << bench.Id() << std::right << std::fixed
+        << std::setw(10) << result.Pixels
+        << std::setprecision(3) << std::setw(10) << result.P50NsPerPixel << std::setw(10) << result.P99NsPerPixel
+        << std::setprecision(1) << std::setw(10) << result.P50MpixPerSecond()
+        << std::setw(10) << result.P99MpixPerSecond() << std::endl;
+}
+
+
+auto WriteJson(
+        std::ostream & out,
+        const std::vector<Result> & results) -> void {
+    out << "{\n"
+        << "  \"build_type\": \"" << CHERRY_BENCHMARK_BUILD_TYPE << "\",\n"
+        << "  \"simd\": \"" << SimdName() << "\",\n"
+        << "  \"results\": [\n";
+
+    out << std::setprecision(6);
+    for (auto i = size_t{ 0 }; i < results.size(); i += 1) {
+        const auto & result = results[i];
+        const auto & bench = *result.Source;
+
+        out << "    {\"id\": \"" << bench.Id() << "\", \"name\": \"" << bench.Name
+            << "\", \"blend\": \"" << bench.Blend
+            << "\", \"canvas_width\": " << bench.CanvasWidth << ", \"canvas_height\": " << bench.CanvasHeight
+            << ", \"size\": " << bench.Size << ", \"pixels\": " << result.Pixels
+            << ", \"iterations\": " << result.Iterations
+            << ", \"p50_ns_per_pixel\": " << result.P50NsPerPixel << ", \"p99_ns_per_pixel\": " << result.P99NsPerPixel
+            << ", \"p50_mpix_per_s\": " << result.P50MpixPerSecond()
+            << ", \"p99_mpix_per_s\": " << result.P99MpixPerSecond() << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    out << "  ]\n}\n";
+}
+
+
+auto WriteCsv(
+        std::ostream & out,
+        const std::vector<Result> & results) -> void {
+    out << "id,name,blend,canvas_width,canvas_height,size,pixels,iterations,"
+           "p50_ns_per_pixel,p99_ns_per_pixel,p50_mpix_per_s,p99_mpix_per_s\n";
+
+    out << std::setprecision(6);
+    for (const auto & result : results) {
+        const auto & bench = *result.Source;
+
+        out << bench.Id() << "," << bench.Name << "," << bench.Blend << "," << bench.CanvasWidth << ","
+            << bench.CanvasHeight << "," << bench.Size << "," << result.Pixels << "," << result.Iterations << ","
+            << result.P50NsPerPixel << "," << result.P99NsPerPixel << ","
+            << result.P50MpixPerSecond() << "," << result.P99MpixPerSecond() << "\n";
+    }
+}
+
+
+auto Usage() -> std::string {
+    return
+            "usage: cherry_benchmark [options]\n"
+            "  --filter TEXT        only run cases whose id contains TEXT (id is name/blend/WxH/size)\n"
+            "  --samples N          timed samples per case (default 50)\n"
+            "  --min-sample-us N    minimum duration of one sample in microseconds (default 500)\n"
+            "  --format FORMAT      table, json or csv (default table)\n"
+            "  --output FILE        write json or csv results to FILE; the table still goes to stdout\n"
+            "  --list               print case ids and exit\n";
+}
+
+
+auto ParseOptions(
+        int argc,
+        char ** argv) -> Options {
+    auto options = Options();
+
+    for (auto i = 1; i < argc; i += 1) {
+        const auto argument = std::string(argv[i]);
+        const auto value = [&]() {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + argument + "\n" + Usage());
+            }
+            i += 1;
+            return std::string(argv[i]);
+        };
+
+        if ("--filter" == argument) {
+            options.Filter = value();
+        }
+        else if ("--samples" == argument) {
+            options.Samples = std::max(1, std::stoi(value()));
+        }
+        else if ("--min-sample-us" == argument) {
+            options.MinSampleTime = std::chrono::microseconds{ std::max(1, std::stoi(value())) };
+        }
+        else if ("--format" == argument) {
+            options.Format = value();
+            if ("table" != options.Format and "json" != options.Format and "csv" != options.Format) {
+                throw std::invalid_argument("Unknown format: " + options.Format + "\n" + Usage());
+            }
+        }
+        else if ("--output" == argument) {
+            options.Output = value();
+        }
+        else if ("--list" == argument) {
+            options.List = true;
+        }
+        else {
+            throw std::invalid_argument("Unknown option: " + argument + "\n" + Usage());
+        }
+    }
+
+    if (not options.Output.empty() and "table" == options.Format) {
+        options.Format = "json";
+    }
+
+    return options;
+}
+
+
+auto Main(
+        const Options & options) -> void {
+    constexpr auto canvas_sizes = std::array<std::pair<int, int>, 2>{{ { 640, 480 }, { 1920, 1080 } }};
+    constexpr auto sprite_sizes = std::array<int, 3>{ 32, 128, 512 };
+    constexpr auto batch_counts = std::array<int, 2>{ 1'000, 10'000 };
+    constexpr auto atlas_size = 128;
+
+    const auto atlas = Fixture(atlas_size);
+    auto pool = cherry::parallel::WorkerPool();
+
+    auto fixtures = std::vector<std::unique_ptr<Fixture>>();
+    for (const auto size : sprite_sizes) {
+        fixtures.push_back(std::make_unique<Fixture>(size));
+    }
+
+    auto backgrounds = std::vector<std::vector<uint32_t>>();
+    for (const auto &[width, height] : canvas_sizes) {
+        backgrounds.push_back(MakeImage(width, height));
+    }
+
+    auto cases = std::vector<Case>();
+    for (auto i = size_t{ 0 }; i < canvas_sizes.size(); i += 1) {
+        const auto[width, height] = canvas_sizes[i];
+
+        for (const auto & fixture : fixtures) {
+            AddCopyCases(cases, *fixture, width, height, pool);
+        }
+
+        for (const auto count : batch_counts) {
+            AddBatchCases(cases, atlas, width, height, count, pool);
+        }
+
+        AddCanvasCases(cases, backgrounds[i], width, height);
+    }
+
+    const auto selected = [&](const Case & bench) {
+        return options.Filter.empty() or std::string::npos != bench.Id().find(options.Filter);
+    };
+
+    if (options.List) {
+        for (const auto & bench : cases) {
+            if (selected(bench)) {
+                std::cout << bench.Id() << "\n";
+            }
+        }
+        return;
+    }
+
+    const auto table = "table" == options.Format or not options.Output.empty();
+    if (table) {
+        std::cout << "build " << CHERRY_BENCHMARK_BUILD_TYPE << ", simd " << SimdName() << "\n"
+                  << std::left << std::setw(60) << "case" << std::right << std::setw(10) << "pixels"
+                  << std::setw(10) << "p50 ns/px" << std::setw(10) << "p99 ns/px"
+                  << std::setw(10) << "p50 Mpx/s" << std::setw(10) << "p99 Mpx/s" << std::endl;
+    }
+
+    auto results = std::vector<Result>();
+    for (const auto & bench : cases) {
+        if (not selected(bench)) {
+            continue;
+        }
+
+        results.push_back(Run(bench, options));
+        if (table) {
+            WriteTable(std::cout, results.back());
+        }
+    }
+
+    if ("table" == options.Format) {
+        return;
+    }
+
+    auto file = std::ofstream();
+    if (not options.Output.empty()) {
+        file.open(options.Output);
+        if (not file) {
+            throw std::runtime_error("Cannot open " + options.Output + " for writing");
+        }
+    }
+
+    auto & out = options.Output.empty() ? std::cout : static_cast<std::ostream &>(file);
+    if ("json" == options.Format) {
+        WriteJson(out, results);
+    }
+    else {
+        WriteCsv(out, results);
+    }
+}
+
+
+auto main(
+        int argc,
+        char ** argv) -> int {
+    try {
+        Main(ParseOptions(argc, argv));
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
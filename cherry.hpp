@@ -1,17 +1,68 @@
 #pragma once
 
-#ifdef CHERRY_CHECK_BOUNDS
-#include <stdexcept>
-#endif
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <tuple>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <utility>
 #include <type_traits>
 #include <vector>
 
+#if __has_include(<sys/mman.h>)
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CHERRY_HAS_MMAP
+#endif
+
+#ifdef CHERRY_STATS
+#include <chrono>
+#endif
+
+#if defined(CHERRY_CHECK_BOUNDS) and defined(CHERRY_CLIP_BOUNDS)
+#error "CHERRY_CHECK_BOUNDS and CHERRY_CLIP_BOUNDS are mutually exclusive"
+#endif
+
+#if defined(__GNUC__) or defined(__clang__)
+#define CHERRY_COLD [[gnu::cold, gnu::noinline]]
+#elif defined(_MSC_VER)
+#define CHERRY_COLD __declspec(noinline)
+#else
+#define CHERRY_COLD
+#endif
+
+#ifndef CHERRY_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CHERRY_SIMD_AVX2
+#endif
+#if defined(__SSE2__) or defined(_M_X64)
+#include <emmintrin.h>
+#define CHERRY_SIMD_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CHERRY_SIMD_NEON
+#endif
+#endif // CHERRY_NO_SIMD
+
 
 namespace cherry {
     namespace utility {
@@ -54,683 +105,7983 @@ namespace cherry {
         }
 
 
-        inline auto SortTopLeft(
-                int & x0,
-                int & y0,
-                int & x1,
-                int & y1) -> void {
-            if (x1 < x0) {
-                std::swap(x0, x1);
-            }
+        struct Rect {
+            int Left{ 0 };
+            int Top{ 0 };
+            int Right{ 0 };
+            int Bottom{ 0 };
 
-            if (y1 < y0) {
-                std::swap(y0, y1);
+
+            [[nodiscard]]
+            inline auto Width() const -> int {
+                return Right - Left;
             }
-        }
 
 
-        class Fixed final {
-            static constexpr auto DIGITS = 8;
+            [[nodiscard]]
+            inline auto Height() const -> int {
+                return Bottom - Top;
+            }
 
-            int repr;
-        public:
-            [[maybe_unused]]
-            explicit constexpr Fixed(float value) :
-                    repr(static_cast<int>(value * (1 << DIGITS))) {}
+
+            [[nodiscard]]
+            inline auto IsEmpty() const -> bool {
+                return Right <= Left or Bottom <= Top;
+            }
 
 
-            [[maybe_unused]]
-            explicit constexpr Fixed(double value) :
-                    repr(static_cast<int>(value * (1 << DIGITS))) {}
+            [[nodiscard]]
+            inline auto Intersects(
+                    const Rect & other) const -> bool {
+                return not Intersection(other).IsEmpty();
+            }
 
 
             [[nodiscard]]
-            inline auto operator*(int value) const -> int {
-                return (value * repr) >> DIGITS;
+            inline auto Intersection(
+                    const Rect & other) const -> Rect {
+                return {
+                        std::max(Left, other.Left),
+                        std::max(Top, other.Top),
+                        std::min(Right, other.Right),
+                        std::min(Bottom, other.Bottom)
+                };
             }
 
 
-            friend auto operator/(
-                    int a,
-                    Fixed b) -> int;
+            [[nodiscard]]
+            inline auto Union(
+                    const Rect & other) const -> Rect {
+                if (IsEmpty()) {
+                    return other;
+                }
+                if (other.IsEmpty()) {
+                    return *this;
+                }
 
-            friend auto operator*(
-                    int a,
-                    Fixed b) -> int;
+                return {
+                        std::min(Left, other.Left),
+                        std::min(Top, other.Top),
+                        std::max(Right, other.Right),
+                        std::max(Bottom, other.Bottom)
+                };
+            }
         };
 
 
-        [[nodiscard]]
-        inline auto operator/(
-                int a,
-                Fixed b) -> int {
-            return (a << Fixed::DIGITS) / b.repr;
-        }
+        class DirtyRegion final {
+            std::vector<Rect> rects;
+            int max_rects;
+            mutable std::mutex mutex;
+        public:
+            static constexpr auto DEFAULT_MAX_RECTS = 16;
 
 
-        [[nodiscard]]
-        inline auto operator*(
-                int a,
-                Fixed b) -> int {
-            return (a * b.repr) >> Fixed::DIGITS;
-        }
-    }
+            explicit DirtyRegion(
+                    int max_rects = DEFAULT_MAX_RECTS)
+                    :
+                    max_rects(std::max(max_rects, 1)) {}
 
 
-    namespace color {
-        constexpr auto INDEX_RED = 0u;
-        constexpr auto INDEX_GREEN = 1u;
-        constexpr auto INDEX_BLUE = 2u;
-        constexpr auto INDEX_ALPHA = 3u;
+            DirtyRegion(
+                    const DirtyRegion & other)
+                    :
+                    rects(other.Rects()),
+                    max_rects(other.max_rects) {}
 
 
-        constexpr auto SHIFT_RED = 8u * INDEX_RED;
-        constexpr auto SHIFT_GREEN = 8u * INDEX_GREEN;
-        constexpr auto SHIFT_BLUE = 8u * INDEX_BLUE;
-        constexpr auto SHIFT_ALPHA = 8u * INDEX_ALPHA;
+            auto operator=(
+                    const DirtyRegion & other) -> DirtyRegion & {
+                if (this != &other) {
+                    auto copy = other.Rects();
 
+                    const auto lock = std::lock_guard(mutex);
+                    rects = std::move(copy);
+                    max_rects = other.max_rects;
+                }
 
-        constexpr auto MASK_RED_BLUE = (0xFF << SHIFT_RED) | (0xFF << SHIFT_BLUE);
-        constexpr auto MASK_GREEN = (0xFF << SHIFT_GREEN);
-        constexpr auto MASK_ALPHA = (0xFF << SHIFT_ALPHA);
+                return *this;
+            }
 
 
-        [[nodiscard]]
-        constexpr inline auto FromRGBA(
-                uint32_t red,
-                uint32_t green,
-                uint32_t blue,
-                uint32_t alpha = 0xFF) -> uint32_t {
-            return
-                    ((red & 0xFF) << SHIFT_RED)
-                    | ((green & 0xFF) << SHIFT_GREEN)
-                    | ((blue & 0xFF) << SHIFT_BLUE)
-                    | ((alpha & 0xFF) << SHIFT_ALPHA);
-        }
+            inline auto Add(
+                    const Rect & rect) -> DirtyRegion & {
+                if (rect.IsEmpty()) {
+                    return *this;
+                }
 
+                const auto lock = std::lock_guard(mutex);
+                Insert(rect);
 
-        [[nodiscard]]
-        constexpr inline auto ToRGBA(
-                uint32_t pixel) -> std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> {
-            return {
-                    (pixel >> SHIFT_RED) & 0xFF,
-                    (pixel >> SHIFT_GREEN) & 0xFF,
-                    (pixel >> SHIFT_BLUE) & 0xFF,
-                    (pixel >> SHIFT_ALPHA) & 0xFF,
-            };
-        }
+                return *this;
+            }
 
 
-        [[maybe_unused]]
-        [[nodiscard]]
-        inline auto Overwrite(
-                uint32_t foreground,
-                uint32_t) -> uint32_t {
-            return foreground;
-        }
+            [[maybe_unused]]
+            inline auto Merge(
+                    const DirtyRegion & other) -> DirtyRegion & {
+                for (const auto & rect : other.Rects()) {
+                    Add(rect);
+                }
 
+                return *this;
+            }
 
-        [[maybe_unused]]
-        [[nodiscard]]
-        inline auto AlphaBlend(
-                uint32_t foreground,
-                uint32_t background) -> uint32_t {
-            const auto[fg_r, fg_g, fg_b, fg_a] = ToRGBA(foreground);
-            const auto[bg_r, bg_g, bg_b, bg_a] = ToRGBA(background);
 
-            const auto a = fg_a + bg_a * (255 - fg_a) / 255;
-            const auto r = (fg_r * fg_a + bg_r * bg_a * (255 - fg_a) / 255) / a;
-            const auto g = (fg_g * fg_a + bg_g * bg_a * (255 - fg_a) / 255) / a;
-            const auto b = (fg_b * fg_a + bg_b * bg_a * (255 - fg_a) / 255) / a;
+            [[maybe_unused]]
+            inline auto Clear() -> DirtyRegion & {
+                const auto lock = std::lock_guard(mutex);
+                rects.clear();
 
-            return FromRGBA(r, g, b, a);
-        }
+                return *this;
+            }
 
 
-        [[maybe_unused]]
-        [[nodiscard]]
-        inline auto FastAlphaBlend(
-                uint32_t foreground,
-                uint32_t background) -> uint32_t {
-            const auto fg_a = ((foreground & MASK_ALPHA) >> SHIFT_ALPHA);
-            if (not fg_a) {
-                return background;
+            [[nodiscard]]
+            inline auto Rects() const -> std::vector<Rect> {
+                const auto lock = std::lock_guard(mutex);
+                return rects;
             }
 
-            const auto alpha = fg_a + 1;
-            const auto inv_alpha = 256 - fg_a;
-
-            const auto rb =
-                    (alpha * static_cast<uint64_t >(foreground & MASK_RED_BLUE)
-                     + inv_alpha * static_cast<uint64_t >(background & MASK_RED_BLUE)) >> 8;
-            const auto g =
-                    (alpha * static_cast<uint64_t >(foreground & MASK_GREEN)
-                     + inv_alpha * static_cast<uint64_t >(background & MASK_GREEN)) >> 8;
 
-            return (rb & MASK_RED_BLUE) | (g & MASK_GREEN) | (~0 & MASK_ALPHA);
-        }
+            [[nodiscard]]
+            [[maybe_unused]]
+            inline auto Bounds() const -> Rect {
+                const auto lock = std::lock_guard(mutex);
 
+                auto bounds = Rect{};
+                for (const auto & rect : rects) {
+                    bounds = bounds.Union(rect);
+                }
 
-        using BlendType = decltype(Overwrite);
-    }
+                return bounds;
+            }
 
 
-    class Canvas final {
-    public:
-        uint32_t * const Data{ nullptr };
-        uint8_t * const DataUint8{ nullptr };
-        const int Width{ 0u };
-        const int Height{ 0u };
-        const int Stride{ 0u };
-        const bool Empty{ false };
+            [[nodiscard]]
+            [[maybe_unused]]
+            inline auto IsEmpty() const -> bool {
+                const auto lock = std::lock_guard(mutex);
+                return rects.empty();
+            }
 
 
-        Canvas(
-                uint32_t * data,
-                int width,
-                int height,
-                int stride)
-                :
-                Data(data),
-                DataUint8(reinterpret_cast<uint8_t *>(data)),
-                Width(width),
-                Height(height),
-                Stride(stride),
-                Empty(not width or not height) {
-#ifdef CHERRY_CHECK_BOUNDS
-            if (width < 0) {
-                throw std::out_of_range("Invalid width: " + std::to_string(width));
-            }
-            if (height < 0) {
-                throw std::out_of_range("Invalid height: " + std::to_string(height));
-            }
-            if (stride < 0 or stride < width) {
-                throw std::out_of_range("Invalid stride: " + std::to_string(stride));
+        private:
+            [[nodiscard]]
+            static inline auto Area(
+                    const Rect & rect) -> int64_t {
+                return static_cast<int64_t>(rect.Width()) * rect.Height();
             }
-#endif
-        }
 
 
-        [[maybe_unused]]
-        Canvas(
-                uint32_t * data,
-                int width,
-                int height)
-                :
-                Canvas(data, width, height, width) {}
+            [[nodiscard]]
+            static inline auto Touch(
+                    const Rect & a,
+                    const Rect & b) -> bool {
+                return a.Left <= b.Right and b.Left <= a.Right and a.Top <= b.Bottom and b.Top <= a.Bottom;
+            }
 
 
-        template<color::BlendType BlendFn = color::Overwrite>
-        inline auto BlendPixel(
-                int x,
-                int y,
-                uint32_t color) -> Canvas & {
-            CheckBounds(x, y);
+            inline auto Insert(
+                    Rect rect) -> void {
+                for (auto i = decltype(rects.size()){ 0 }; i < rects.size();) {
+                    if (Touch(rects[i], rect)) {
+                        rect = rect.Union(rects[i]);
+                        rects[i] = rects.back();
+                        rects.pop_back();
+                        i = 0;
+                    }
+                    else {
+                        i += 1;
+                    }
+                }
 
-            Data[Stride * y + x] = BlendFn(color, Data[Stride * y + x]);
+                if (static_cast<int>(rects.size()) < max_rects) {
+                    rects.push_back(rect);
+                    return;
+                }
 
-            return *this;
-        }
+                auto best = decltype(rects.size()){ 0 };
+                auto best_waste = std::numeric_limits<int64_t>::max();
+                for (auto i = decltype(rects.size()){ 0 }; i < rects.size(); i += 1) {
+                    const auto waste = Area(rects[i].Union(rect)) - Area(rects[i]) - Area(rect);
+                    if (waste < best_waste) {
+                        best = i;
+                        best_waste = waste;
+                    }
+                }
 
+                rect = rect.Union(rects[best]);
+                rects[best] = rects.back();
+                rects.pop_back();
+                Insert(rect);
+            }
+        };
 
-        [[nodiscard]]
-        inline auto Pixel(
-                int x,
-                int y) const -> uint32_t {
-            CheckBounds(x, y);
 
-            return Data[Stride * y + x];
-        }
+        constexpr auto BUFFER_ALIGNMENT = 64;
 
 
         [[nodiscard]]
-        inline auto IsWithinBounds(
-                int x,
-                int y) const -> bool {
-            return x >= 0 and y >= 0 and x < Width and y < Height;
+        constexpr inline auto AlignedStride(
+                int width) -> int {
+            constexpr auto pixels = BUFFER_ALIGNMENT / static_cast<int>(sizeof(uint32_t));
+            return (width + pixels - 1) / pixels * pixels;
         }
 
 
-    private:
-#ifdef CHERRY_CHECK_BOUNDS
+        enum class Initialization {
+            Zeroed,
+            Uninitialized
+        };
 
 
-        inline auto CheckBounds(
-                int x,
-                int y) const -> void {
-            if (IsWithinBounds(x, y)) {
-                return;
-            }
+        class AlignedPixelBuffer final {
+            struct Deleter {
+                auto operator()(uint32_t * data) const -> void {
+                    ::operator delete(data, std::align_val_t{ BUFFER_ALIGNMENT });
+                }
+            };
 
-            const auto message =
-                    "Coordinates ("
-                    + std::to_string(x) + ", " + std::to_string(y) +
-                    ") are out of bounds for image size ("
-                    + std::to_string(Width) + ", " + std::to_string(Height) + ")";
-            throw std::out_of_range(message);
-        }
 
+            std::unique_ptr<uint32_t[], Deleter> data;
+            int width{ 0 };
+            int height{ 0 };
+            int stride{ 0 };
+        public:
+            AlignedPixelBuffer() = default;
+
+
+            AlignedPixelBuffer(
+                    int width,
+                    int height,
+                    Initialization initialization = Initialization::Zeroed)
+                    :
+                    width(width),
+                    height(height),
+                    stride(AlignedStride(width)) {
+                const auto bytes = sizeof(uint32_t) * Size();
+                if (not bytes) {
+                    return;
+                }
 
-#else
+                data.reset(static_cast<uint32_t *>(::operator new(bytes, std::align_val_t{ BUFFER_ALIGNMENT })));
+                if (Initialization::Zeroed == initialization) {
+                    std::memset(data.get(), 0, bytes);
+                }
+            }
 
 
-        inline auto CheckBounds(
-                int,
-                int) const -> void {}
+            [[maybe_unused]]
+            AlignedPixelBuffer(
+                    int width,
+                    int height,
+                    uint32_t fill_color)
+                    :
+                    AlignedPixelBuffer(width, height, Initialization::Uninitialized) {
+                std::fill_n(data.get(), Size(), fill_color);
+            }
 
 
-#endif // CHERRY_CHECK_BOUNDS
-    };
+            [[nodiscard]]
+            inline auto Data() const -> uint32_t * {
+                return data.get();
+            }
 
 
-    namespace transform {
-        using FixedPoint = utility::Fixed;
+            [[nodiscard]]
+            inline auto Width() const -> int {
+                return width;
+            }
 
 
-        [[nodiscard]]
-        constexpr inline auto ApplyRotation(
-                int x,
-                int y,
-                float sin,
-                float cos) -> std::pair<int, int> {
-            return {
-                    std::lround(cos * static_cast<float>(x) + sin * static_cast<float>(y)),
-                    std::lround(-sin * static_cast<float>(x) + cos * static_cast<float>(y))
-            };
-        }
+            [[nodiscard]]
+            inline auto Height() const -> int {
+                return height;
+            }
 
 
-        template<color::BlendType BlendFn>
-        [[maybe_unused]]
-        inline auto Copy(
-                const Canvas & src,
-                Canvas & dst,
-                int x0,
-                int y0,
-                int x1,
-                int y1) -> decltype(dst) {
-            if (src.Empty) {
-                return dst;
+            [[nodiscard]]
+            inline auto Stride() const -> int {
+                return stride;
             }
 
-            const auto target_width = std::abs(x0 - x1);
-            const auto target_height = std::abs(y0 - y1);
-
-            const auto mirrored_x = x0 > x1;
-            const auto mirrored_y = y0 > y1;
 
-            utility::SortTopLeft(x0, y0, x1, y1);
+            [[nodiscard]]
+            inline auto Size() const -> size_t {
+                return static_cast<size_t>(stride) * height;
+            }
+        };
 
-            const auto dst_start_y = std::max(y0, 0);
-            const auto dst_end_y = std::min(y1, dst.Height);
 
-            const auto dst_start_x = std::max(x0, 0);
-            const auto dst_end_x = std::min(x1, dst.Width);
+        class PixelBufferPool final {
+            std::vector<AlignedPixelBuffer> free;
+            std::mutex mutex;
+        public:
+            class Lease final {
+                PixelBufferPool * pool{ nullptr };
+                AlignedPixelBuffer buffer;
+            public:
+                Lease(
+                        PixelBufferPool * pool,
+                        AlignedPixelBuffer buffer)
+                        :
+                        pool(pool),
+                        buffer(std::move(buffer)) {}
+
+
+                Lease(
+                        Lease && other) noexcept
+                        :
+                        pool(std::exchange(other.pool, nullptr)),
+                        buffer(std::move(other.buffer)) {}
+
+
+                auto operator=(
+                        Lease && other) noexcept -> Lease & {
+                    if (this != &other) {
+                        Return();
+                        pool = std::exchange(other.pool, nullptr);
+                        buffer = std::move(other.buffer);
+                    }
 
-            for (auto y = dst_start_y; y < dst_end_y; y += 1) {
-                auto v = (y - y0) * src.Height / target_height;
-                if (mirrored_y) {
-                    v = src.Height - 1 - v;
+                    return *this;
                 }
 
-                for (auto x = dst_start_x; x < dst_end_x; x += 1) {
-                    auto u = (x - x0) * src.Width / target_width;
-                    if (mirrored_x) {
-                        u = src.Width - 1 - u;
-                    }
 
-                    dst.BlendPixel<BlendFn>(x, y, src.Pixel(u, v));
+                ~Lease() {
+                    Return();
                 }
-            }
 
-            return dst;
-        }
 
+                [[nodiscard]]
+                inline auto operator*() -> AlignedPixelBuffer & {
+                    return buffer;
+                }
 
-        template<color::BlendType BlendFn>
-        [[maybe_unused]]
-        inline auto Copy(
-                const Canvas & src,
-                Canvas & dst,
-                int x0,
-                int y0,
-                int u0,
-                int v0,
-                float rotation) -> decltype(dst) {
-            const auto sin = std::sin(rotation);
-            const auto cos = std::cos(rotation);
 
-            const auto src_left = -u0;
-            const auto src_top = -v0;
-            const auto src_right = src_left + src.Width;
-            const auto src_bottom = src_top + src.Height;
+                [[nodiscard]]
+                inline auto operator->() -> AlignedPixelBuffer * {
+                    return &buffer;
+                }
 
-            const auto[ax, ay] = ApplyRotation(src_left, src_top, sin, cos);
-            const auto[bx, by] = ApplyRotation(src_right, src_top, sin, cos);
-            const auto[cx, cy] = ApplyRotation(src_right, src_bottom, sin, cos);
-            const auto[dx, dy] = ApplyRotation(src_left, src_bottom, sin, cos);
 
-            auto[min_x, max_x] = std::minmax({ ax, bx, cx, dx });
-            min_x += x0;
-            max_x += x0;
+            private:
+                inline auto Return() -> void {
+                    if (pool) {
+                        pool->Release(std::move(buffer));
+                        pool = nullptr;
+                    }
+                }
+            };
 
-            auto[min_y, max_y] = std::minmax({ ay, by, cy, dy });
-            min_y += y0;
-            max_y += y0;
 
-            const auto start_y = std::max(min_y, 0);
-            const auto end_y = std::min(max_y, dst.Height);
+            PixelBufferPool() = default;
 
-            const auto start_x = std::max(min_x, 0);
-            const auto end_x = std::min(max_x, dst.Width);
+            PixelBufferPool(const PixelBufferPool &) = delete;
 
-            constexpr auto transparent = color::FromRGBA(0xFF, 0xFF, 0xFF, 0x00);
+            auto operator=(const PixelBufferPool &) -> PixelBufferPool & = delete;
 
-            for (auto y = start_y; y < end_y; y += 1) {
-                for (auto x = start_x; x < end_x; x += 1) {
-                    auto[u, v] = ApplyRotation(x - x0, y - y0, -sin, cos);
-                    u += u0;
-                    v += v0;
 
-                    dst.BlendPixel<BlendFn>(x, y, src.IsWithinBounds(u, v) ? src.Pixel(u, v) : transparent);
+            // Hands out a recycled buffer of the same size if there is one; its contents are whatever the previous
+            // lease left behind, and a new buffer is not initialized either.
+            [[nodiscard]]
+            inline auto Acquire(
+                    int width,
+                    int height) -> Lease {
+                {
+                    const auto lock = std::lock_guard(mutex);
+
+                    for (auto & buffer : free) {
+                        if (buffer.Width() == width and buffer.Height() == height) {
+                            auto lease = Lease(this, std::move(buffer));
+                            buffer = std::move(free.back());
+                            free.pop_back();
+                            return lease;
+                        }
+                    }
                 }
+
+                return { this, AlignedPixelBuffer(width, height, Initialization::Uninitialized) };
             }
 
-            return dst;
-        }
 
+            [[maybe_unused]]
+            inline auto Trim() -> void {
+                const auto lock = std::lock_guard(mutex);
+                free.clear();
+            }
+
+
+        private:
+            inline auto Release(
+                    AlignedPixelBuffer buffer) -> void {
+                const auto lock = std::lock_guard(mutex);
+                free.push_back(std::move(buffer));
+            }
+        };
+
+
+        inline auto SortTopLeft(
+                int & x0,
+                int & y0,
+                int & x1,
+                int & y1) -> void {
+            if (x1 < x0) {
+                std::swap(x0, x1);
+            }
+
+            if (y1 < y0) {
+                std::swap(y0, y1);
+            }
+        }
+
+
+        [[nodiscard]]
+        constexpr inline auto FloorDiv(
+                int64_t a,
+                int64_t b) -> int64_t {
+            return a / b - ((a % b != 0) and ((a < 0) != (b < 0)));
+        }
+
+
+        [[nodiscard]]
+        constexpr inline auto CeilDiv(
+                int64_t a,
+                int64_t b) -> int64_t {
+            return a / b + ((a % b != 0) and ((a < 0) == (b < 0)));
+        }
+
+
+        // floor((a * b + c) / d) and its remainder, exact even where a * b overflows 64 bits, as it does for a line
+        // whose endpoints span the whole int range. The quotient must fit 64 bits and d must be below 2^63.
+        [[nodiscard]]
+        inline auto MulDiv(
+                uint64_t a,
+                uint64_t b,
+                uint64_t c,
+                uint64_t d) -> std::pair<uint64_t, uint64_t> {
+            constexpr auto MAX = std::numeric_limits<uint64_t>::max();
+            if (0 == a or b <= (MAX - c) / a) {
+                const auto n = a * b + c;
+                return { n / d, n % d };
+            }
+
+            constexpr auto LOW_HALF = uint64_t{ 0xFFFFFFFFu };
+            const auto low_low = (a & LOW_HALF) * (b & LOW_HALF);
+            const auto high_low = (a >> 32u) * (b & LOW_HALF);
+            const auto low_high = (a & LOW_HALF) * (b >> 32u);
+            const auto middle = (low_low >> 32u) + (high_low & LOW_HALF) + (low_high & LOW_HALF);
+
+            auto low = (middle << 32u) | (low_low & LOW_HALF);
+            auto high = (a >> 32u) * (b >> 32u) + (high_low >> 32u) + (low_high >> 32u) + (middle >> 32u);
+            low += c;
+            high += low < c;
+
+            // One bit at a time; this only runs once per line, for lines too long to fit 64 bits
+            auto quotient = uint64_t{ 0 };
+            auto remainder = uint64_t{ 0 };
+            for (auto bit = 127; bit >= 0; bit -= 1) {
+                const auto word = bit >= 64 ? high >> (bit - 64u) : low >> bit;
+                remainder = (remainder << 1u) | (word & 1u);
+                if (remainder >= d) {
+                    remainder -= d;
+                    quotient |= bit < 64 ? uint64_t{ 1 } << bit : 0;
+                }
+            }
+
+            return { quotient, remainder };
+        }
+
+
+        class RationalStep final {
+            int value;
+            int remainder;
+            int quotient;
+            int rest;
+            int denominator;
+        public:
+            RationalStep(
+                    int offset,
+                    int numerator,
+                    int denominator)
+                    :
+                    value(static_cast<int>(static_cast<int64_t>(offset) * numerator / denominator)),
+                    remainder(static_cast<int>(static_cast<int64_t>(offset) * numerator % denominator)),
+                    quotient(numerator / denominator),
+                    rest(numerator % denominator),
+                    denominator(denominator) {}
+
+
+            [[nodiscard]]
+            inline auto Value() const -> int {
+                return value;
+            }
+
+
+            inline auto Advance() -> RationalStep & {
+                value += quotient;
+                remainder += rest;
+
+                if (remainder >= denominator) {
+                    remainder -= denominator;
+                    value += 1;
+                }
+
+                return *this;
+            }
+        };
+
+
+        class Fixed final {
+            static constexpr auto DIGITS = 8;
+
+            int repr;
+        public:
+            [[maybe_unused]]
+            explicit constexpr Fixed(float value) :
+                    repr(static_cast<int>(value * (1 << DIGITS))) {}
+
+
+            [[maybe_unused]]
+            explicit constexpr Fixed(double value) :
+                    repr(static_cast<int>(value * (1 << DIGITS))) {}
+
+
+            [[nodiscard]]
+            explicit constexpr operator float() const {
+                return static_cast<float>(repr) / (1 << DIGITS);
+            }
+
+
+            [[nodiscard]]
+            inline auto operator*(int value) const -> int {
+                return (value * repr) >> DIGITS;
+            }
+
+
+            friend auto operator/(
+                    int a,
+                    Fixed b) -> int;
+
+            friend auto operator*(
+                    int a,
+                    Fixed b) -> int;
+        };
+
+
+        [[nodiscard]]
+        inline auto operator/(
+                int a,
+                Fixed b) -> int {
+            return (a << Fixed::DIGITS) / b.repr;
+        }
+
+
+        [[nodiscard]]
+        inline auto operator*(
+                int a,
+                Fixed b) -> int {
+            return (a * b.repr) >> Fixed::DIGITS;
+        }
+
+
+#if defined(CHERRY_CHECK_BOUNDS) or defined(CHERRY_CLIP_BOUNDS)
+
+
+        // Kept out of line and cold so that the checks calling them stay a compare and a branch.
+        CHERRY_COLD
+        [[noreturn]]
+        inline auto ThrowOutOfBounds(
+                int x,
+                int y,
+                int width,
+                int height) -> void {
+            throw std::out_of_range(
+                    "Coordinates (" + std::to_string(x) + ", " + std::to_string(y) +
+                    ") are out of bounds for image size (" + std::to_string(width) + ", " + std::to_string(height) + ")"
+            );
+        }
+
+
+        CHERRY_COLD
+        [[noreturn]]
+        inline auto ThrowOutOfBounds(
+                const Rect & rect,
+                int width,
+                int height) -> void {
+            throw std::out_of_range(
+                    "Area [" + std::to_string(rect.Left) + ", " + std::to_string(rect.Top) + ", "
+                    + std::to_string(rect.Right) + ", " + std::to_string(rect.Bottom) +
+                    ") is out of bounds for image size (" + std::to_string(width) + ", " + std::to_string(height) + ")"
+            );
+        }
+
+
+#endif // CHERRY_CHECK_BOUNDS or CHERRY_CLIP_BOUNDS
+
+
+        // Bounds checks shared by Canvas and ConstCanvas. Primitives check the area they have clipped to once, with
+        // CheckRect or CheckSpan, and then index rows through RowUnchecked or SpanUnchecked; only the single-pixel
+        // accessors check every access. All checks compile to nothing unless CHERRY_CHECK_BOUNDS is defined.
+        template<typename Derived>
+        class BoundsChecking {
+        public:
+            [[nodiscard]]
+            inline auto IsWithinBounds(
+                    int x,
+                    int y) const -> bool {
+                const auto bounds = static_cast<const Derived &>(*this).Bounds();
+                return x >= bounds.Left and y >= bounds.Top and x < bounds.Right and y < bounds.Bottom;
+            }
+
+
+            // Empty rectangles are always within bounds.
+            [[nodiscard]]
+            inline auto IsWithinBounds(
+                    const Rect & rect) const -> bool {
+                const auto bounds = static_cast<const Derived &>(*this).Bounds();
+                return rect.IsEmpty()
+                       or (rect.Left >= bounds.Left and rect.Top >= bounds.Top
+                           and rect.Right <= bounds.Right and rect.Bottom <= bounds.Bottom);
+            }
+
+
+            inline auto CheckRect(
+                    [[maybe_unused]] const Rect & rect) const -> void {
+#ifdef CHERRY_CHECK_BOUNDS
+                if (not IsWithinBounds(rect)) {
+                    const auto & self = static_cast<const Derived &>(*this);
+                    ThrowOutOfBounds(rect, self.Width, self.Height);
+                }
+#endif
+            }
+
+
+            inline auto CheckSpan(
+                    int x,
+                    int y,
+                    int count) const -> void {
+                CheckRect({ x, y, x + count, y + 1 });
+            }
+
+
+        protected:
+            inline auto CheckBounds(
+                    [[maybe_unused]] int x,
+                    [[maybe_unused]] int y) const -> void {
+#ifdef CHERRY_CHECK_BOUNDS
+                if (not IsWithinBounds(x, y)) {
+                    const auto & self = static_cast<const Derived &>(*this);
+                    ThrowOutOfBounds(x, y, self.Width, self.Height);
+                }
+#endif
+            }
+
+
+            // Under CHERRY_CLIP_BOUNDS this is the part of the view that lies on the image rather than a checked rect.
+            [[nodiscard]]
+            inline auto ViewRect(
+                    int x,
+                    int y,
+                    int width,
+                    int height) const -> Rect {
+                auto rect = Rect{ x, y, x + width, y + height };
+#ifdef CHERRY_CLIP_BOUNDS
+                rect = rect.Intersection(static_cast<const Derived &>(*this).Bounds());
+                if (rect.IsEmpty()) {
+                    return {};
+                }
+#else
+                CheckRect(rect);
+#endif
+                return rect;
+            }
+        };
+    }
+
+
+    // Per-primitive render statistics, collected only when CHERRY_STATS is defined. Without it Scope, the timers and
+    // every hook are empty inline code, so instrumented primitives compile to exactly what they were before.
+    namespace stats {
+        enum class Primitive : uint8_t {
+            Blit,
+            CopyScaled,
+            CopyAffine,
+            CopyBatch,
+            Line,
+            LineAA,
+            FillTriangle,
+            FillPolygon,
+            FillPolygonAA,
+            FillRect,
+            Clear,
+            Mesh,
+            Count
+        };
+
+
+        constexpr auto PRIMITIVE_COUNT = static_cast<size_t>(Primitive::Count);
+
+
+#ifdef CHERRY_STATS
+        constexpr auto ENABLED = true;
+#else
+        constexpr auto ENABLED = false;
+#endif
+
+
+        [[nodiscard]]
+        [[maybe_unused]]
+        constexpr inline auto Name(
+                Primitive primitive) -> const char * {
+            constexpr const char * names[] = {
+                    "Blit",
+                    "CopyScaled",
+                    "CopyAffine",
+                    "CopyBatch",
+                    "Line",
+                    "LineAA",
+                    "FillTriangle",
+                    "FillPolygon",
+                    "FillPolygonAA",
+                    "FillRect",
+                    "Clear",
+                    "Mesh"
+            };
+
+            return primitive < Primitive::Count ? names[static_cast<size_t>(primitive)] : "";
+        }
+
+
+        // Visited counts the destination pixels a primitive walks after clipping and Written the pixels it hands to a
+        // blend, less any a skipping blend drops as transparent, so Skipped is the walked part that was rejected.
+        struct Counters {
+            uint64_t Calls{ 0 };
+            uint64_t Visited{ 0 };
+            uint64_t Written{ 0 };
+            uint64_t Nanoseconds{ 0 };
+
+
+            [[nodiscard]]
+            inline auto Skipped() const -> uint64_t {
+                return Visited > Written ? Visited - Written : 0;
+            }
+        };
+
+
+#ifdef CHERRY_STATS
+
+
+        struct SharedCounters {
+            std::atomic<uint64_t> Calls{ 0 };
+            std::atomic<uint64_t> Visited{ 0 };
+            std::atomic<uint64_t> Written{ 0 };
+            std::atomic<uint64_t> Nanoseconds{ 0 };
+        };
+
+
+        inline auto Table() -> std::array<SharedCounters, PRIMITIVE_COUNT> & {
+            static auto table = std::array<SharedCounters, PRIMITIVE_COUNT>();
+            return table;
+        }
+
+
+        inline auto Current() -> SharedCounters *& {
+            thread_local SharedCounters * current = nullptr;
+            return current;
+        }
+
+
+        // The outermost scope on a thread owns attribution and timing: the Blit behind an identity Copy, or the
+        // copies a batch issues, count towards the primitive the caller invoked.
+        class Scope final {
+            SharedCounters * counters{ nullptr };
+            std::chrono::steady_clock::time_point start;
+        public:
+            explicit Scope(
+                    Primitive primitive) {
+                if (Current()) {
+                    return;
+                }
+
+                counters = &Table()[static_cast<size_t>(primitive)];
+                Current() = counters;
+                start = std::chrono::steady_clock::now();
+            }
+
+
+            Scope(const Scope &) = delete;
+
+            auto operator=(const Scope &) -> Scope & = delete;
+
+
+            ~Scope() {
+                if (not counters) {
+                    return;
+                }
+
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+                counters->Calls.fetch_add(1, std::memory_order_relaxed);
+                counters->Nanoseconds.fetch_add(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                        std::memory_order_relaxed
+                );
+                Current() = nullptr;
+            }
+        };
+
+
+        inline auto Visit(
+                int64_t pixels) -> void {
+            if (auto * counters = Current(); counters and pixels > 0) {
+                counters->Visited.fetch_add(pixels, std::memory_order_relaxed);
+            }
+        }
+
+
+        inline auto Write(
+                int64_t pixels) -> void {
+            if (auto * counters = Current(); counters and pixels > 0) {
+                counters->Written.fetch_add(pixels, std::memory_order_relaxed);
+            }
+        }
+
+
+        [[nodiscard]]
+        [[maybe_unused]]
+        inline auto Snapshot() -> std::array<Counters, PRIMITIVE_COUNT> {
+            auto snapshot = std::array<Counters, PRIMITIVE_COUNT>();
+
+            for (auto i = size_t{ 0 }; i < PRIMITIVE_COUNT; i += 1) {
+                const auto & shared = Table()[i];
+                snapshot[i] = {
+                        shared.Calls.load(std::memory_order_relaxed),
+                        shared.Visited.load(std::memory_order_relaxed),
+                        shared.Written.load(std::memory_order_relaxed),
+                        shared.Nanoseconds.load(std::memory_order_relaxed)
+                };
+            }
+
+            return snapshot;
+        }
+
+
+        [[maybe_unused]]
+        inline auto Reset() -> void {
+            for (auto & shared : Table()) {
+                shared.Calls.store(0, std::memory_order_relaxed);
+                shared.Visited.store(0, std::memory_order_relaxed);
+                shared.Written.store(0, std::memory_order_relaxed);
+                shared.Nanoseconds.store(0, std::memory_order_relaxed);
+            }
+        }
+
+
+        // Accumulated wall time of a code region chosen by the caller, such as a whole frame.
+        class Timer final {
+            std::atomic<uint64_t> calls{ 0 };
+            std::atomic<uint64_t> nanoseconds{ 0 };
+        public:
+            [[nodiscard]]
+            inline auto Calls() const -> uint64_t {
+                return calls.load(std::memory_order_relaxed);
+            }
+
+
+            [[nodiscard]]
+            inline auto Nanoseconds() const -> uint64_t {
+                return nanoseconds.load(std::memory_order_relaxed);
+            }
+
+
+            inline auto Add(
+                    uint64_t elapsed_ns) -> void {
+                calls.fetch_add(1, std::memory_order_relaxed);
+                nanoseconds.fetch_add(elapsed_ns, std::memory_order_relaxed);
+            }
+
+
+            inline auto Reset() -> void {
+                calls.store(0, std::memory_order_relaxed);
+                nanoseconds.store(0, std::memory_order_relaxed);
+            }
+        };
+
+
+        class ScopedTimer final {
+            Timer & timer;
+            std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+        public:
+            explicit ScopedTimer(
+                    Timer & timer)
+                    :
+                    timer(timer) {}
+
+
+            ScopedTimer(const ScopedTimer &) = delete;
+
+            auto operator=(const ScopedTimer &) -> ScopedTimer & = delete;
+
+
+            ~ScopedTimer() {
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+                timer.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+        };
+
+
+#else
+
+
+        class [[maybe_unused]] Scope final {
+        public:
+            explicit constexpr Scope(
+                    Primitive) {}
+        };
+
+
+        constexpr inline auto Visit(
+                int64_t) -> void {}
+
+
+        constexpr inline auto Write(
+                int64_t) -> void {}
+
+
+        [[nodiscard]]
+        [[maybe_unused]]
+        inline auto Snapshot() -> std::array<Counters, PRIMITIVE_COUNT> {
+            return {};
+        }
+
+
+        [[maybe_unused]]
+        inline auto Reset() -> void {}
+
+
+        class Timer final {
+        public:
+            [[nodiscard]]
+            constexpr inline auto Calls() const -> uint64_t {
+                return 0;
+            }
+
+
+            [[nodiscard]]
+            constexpr inline auto Nanoseconds() const -> uint64_t {
+                return 0;
+            }
+
+
+            constexpr inline auto Add(
+                    uint64_t) -> void {}
+
+
+            constexpr inline auto Reset() -> void {}
+        };
+
+
+        class [[maybe_unused]] ScopedTimer final {
+        public:
+            explicit constexpr ScopedTimer(
+                    Timer &) {}
+        };
+
+
+#endif
+
+
+        [[maybe_unused]]
+        inline auto Visit(
+                const utility::Rect & rect) -> void {
+            if (not rect.IsEmpty()) {
+                Visit(static_cast<int64_t>(rect.Width()) * rect.Height());
+            }
+        }
+    }
+
+
+    namespace color {
+        // The byte each channel occupies in memory, lowest address first. Red and blue must sit two bytes apart:
+        // the blends scale them together as one masked pair.
+        template<uint32_t Red, uint32_t Green, uint32_t Blue, uint32_t Alpha>
+        struct Layout {
+            static_assert(
+                    Red < 4 and Green < 4 and Blue < 4 and Alpha < 4
+                    and 6 == Red + Green + Blue + Alpha and 14 == Red * Red + Green * Green + Blue * Blue + Alpha * Alpha,
+                    "A pixel layout must place each channel in its own byte"
+            );
+            static_assert(2 == (Red > Blue ? Red - Blue : Blue - Red), "Red and blue must be two bytes apart");
+
+
+            static constexpr auto INDEX_RED = Red;
+            static constexpr auto INDEX_GREEN = Green;
+            static constexpr auto INDEX_BLUE = Blue;
+            static constexpr auto INDEX_ALPHA = Alpha;
+
+            static constexpr auto SHIFT_RED = 8u * INDEX_RED;
+            static constexpr auto SHIFT_GREEN = 8u * INDEX_GREEN;
+            static constexpr auto SHIFT_BLUE = 8u * INDEX_BLUE;
+            static constexpr auto SHIFT_ALPHA = 8u * INDEX_ALPHA;
+
+            static constexpr auto MASK_RED_BLUE = (0xFFu << SHIFT_RED) | (0xFFu << SHIFT_BLUE);
+            static constexpr auto MASK_GREEN = (0xFFu << SHIFT_GREEN);
+            static constexpr auto MASK_ALPHA = (0xFFu << SHIFT_ALPHA);
+        };
+
+
+        using RGBA = Layout<0, 1, 2, 3>;
+        using BGRA = Layout<2, 1, 0, 3>;
+        using ARGB = Layout<1, 2, 3, 0>;
+        using ABGR = Layout<3, 2, 1, 0>;
+
+
+        // The layout every canvas and blend works in, fixed at compile time, e.g. -DCHERRY_PIXEL_LAYOUT=BGRA to render
+        // straight into what a GPU upload or video encoder expects.
+#ifdef CHERRY_PIXEL_LAYOUT
+        using PixelLayout = CHERRY_PIXEL_LAYOUT;
+#else
+        using PixelLayout = RGBA;
+#endif
+
+
+        constexpr auto INDEX_RED = PixelLayout::INDEX_RED;
+        constexpr auto INDEX_GREEN = PixelLayout::INDEX_GREEN;
+        constexpr auto INDEX_BLUE = PixelLayout::INDEX_BLUE;
+        constexpr auto INDEX_ALPHA = PixelLayout::INDEX_ALPHA;
+
+
+        constexpr auto SHIFT_RED = PixelLayout::SHIFT_RED;
+        constexpr auto SHIFT_GREEN = PixelLayout::SHIFT_GREEN;
+        constexpr auto SHIFT_BLUE = PixelLayout::SHIFT_BLUE;
+        constexpr auto SHIFT_ALPHA = PixelLayout::SHIFT_ALPHA;
+
+
+        constexpr auto MASK_RED_BLUE = PixelLayout::MASK_RED_BLUE;
+        constexpr auto MASK_GREEN = PixelLayout::MASK_GREEN;
+        constexpr auto MASK_ALPHA = PixelLayout::MASK_ALPHA;
+
+
+        template<typename Layout = PixelLayout>
+        [[nodiscard]]
+        constexpr inline auto FromRGBA(
+                uint32_t red,
+                uint32_t green,
+                uint32_t blue,
+                uint32_t alpha = 0xFF) -> uint32_t {
+            return
+                    ((red & 0xFF) << Layout::SHIFT_RED)
+                    | ((green & 0xFF) << Layout::SHIFT_GREEN)
+                    | ((blue & 0xFF) << Layout::SHIFT_BLUE)
+                    | ((alpha & 0xFF) << Layout::SHIFT_ALPHA);
+        }
+
+
+        template<typename Layout = PixelLayout>
+        [[nodiscard]]
+        constexpr inline auto ToRGBA(
+                uint32_t pixel) -> std::tuple<uint8_t, uint8_t, uint8_t, uint8_t> {
+            return {
+                    (pixel >> Layout::SHIFT_RED) & 0xFF,
+                    (pixel >> Layout::SHIFT_GREEN) & 0xFF,
+                    (pixel >> Layout::SHIFT_BLUE) & 0xFF,
+                    (pixel >> Layout::SHIFT_ALPHA) & 0xFF,
+            };
+        }
+
+
+        // Moves every channel of a From pixel to where To keeps it.
+        template<typename From, typename To>
+        [[nodiscard]]
+        constexpr inline auto Swizzle(
+                uint32_t pixel) -> uint32_t {
+            const auto move = [pixel](uint32_t from, uint32_t to) {
+                return ((pixel >> from) & 0xFF) << to;
+            };
+
+            return
+                    move(From::SHIFT_RED, To::SHIFT_RED)
+                    | move(From::SHIFT_GREEN, To::SHIFT_GREEN)
+                    | move(From::SHIFT_BLUE, To::SHIFT_BLUE)
+                    | move(From::SHIFT_ALPHA, To::SHIFT_ALPHA);
+        }
+
+
+        template<typename Derived>
+        struct BlendPolicy {
+            static constexpr auto COPIES_SOURCE = false;
+            static constexpr auto SKIPS_TRANSPARENT = false;
+            static constexpr auto OVERWRITES_OPAQUE = false;
+            static constexpr auto PREMULTIPLIED = false;
+
+
+            inline auto Span(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) const -> void {
+                const auto & blend = static_cast<const Derived &>(*this);
+
+                for (auto i = 0; i < count; i += 1) {
+                    dst[i] = blend(src[i], dst[i]);
+                }
+            }
+
+
+            inline auto Fill(
+                    uint32_t * dst,
+                    uint32_t color,
+                    int count) const -> void {
+                const auto & blend = static_cast<const Derived &>(*this);
+
+                for (auto i = 0; i < count; i += 1) {
+                    dst[i] = blend(color, dst[i]);
+                }
+            }
+        };
+
+
+        struct Overwrite : BlendPolicy<Overwrite> {
+            static constexpr auto COPIES_SOURCE = true;
+            static constexpr auto OVERWRITES_OPAQUE = true;
+
+
+            [[nodiscard]]
+            constexpr inline auto operator()(
+                    uint32_t foreground,
+                    uint32_t) const -> uint32_t {
+                return foreground;
+            }
+
+
+            inline auto Span(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) const -> void {
+                std::memcpy(dst, src, sizeof(uint32_t) * count);
+            }
+
+
+            inline auto Fill(
+                    uint32_t * dst,
+                    uint32_t color,
+                    int count) const -> void {
+                std::fill_n(dst, count, color);
+            }
+        };
+
+
+        struct AlphaBlend : BlendPolicy<AlphaBlend> {
+            [[nodiscard]]
+            inline auto operator()(
+                    uint32_t foreground,
+                    uint32_t background) const -> uint32_t {
+                const auto[fg_r, fg_g, fg_b, fg_a] = ToRGBA(foreground);
+                const auto[bg_r, bg_g, bg_b, bg_a] = ToRGBA(background);
+
+                const auto a = fg_a + bg_a * (255 - fg_a) / 255;
+                if (not a) {
+                    return background;
+                }
+
+                const auto r = (fg_r * fg_a + bg_r * bg_a * (255 - fg_a) / 255) / a;
+                const auto g = (fg_g * fg_a + bg_g * bg_a * (255 - fg_a) / 255) / a;
+                const auto b = (fg_b * fg_a + bg_b * bg_a * (255 - fg_a) / 255) / a;
+
+                return FromRGBA(r, g, b, a);
+            }
+        };
+
+
+        struct FastAlphaBlend : BlendPolicy<FastAlphaBlend> {
+            static constexpr auto SKIPS_TRANSPARENT = true;
+            static constexpr auto OVERWRITES_OPAQUE = true;
+
+
+            [[nodiscard]]
+            inline auto operator()(
+                    uint32_t foreground,
+                    uint32_t background) const -> uint32_t {
+                const auto fg_a = ((foreground & MASK_ALPHA) >> SHIFT_ALPHA);
+                if (not fg_a) {
+                    return background;
+                }
+
+                const auto alpha = fg_a + 1;
+                const auto inv_alpha = 256 - fg_a;
+
+                const auto rb =
+                        (alpha * static_cast<uint64_t >(foreground & MASK_RED_BLUE)
+                         + inv_alpha * static_cast<uint64_t >(background & MASK_RED_BLUE)) >> 8;
+                const auto g =
+                        (alpha * static_cast<uint64_t >(foreground & MASK_GREEN)
+                         + inv_alpha * static_cast<uint64_t >(background & MASK_GREEN)) >> 8;
+
+                return (rb & MASK_RED_BLUE) | (g & MASK_GREEN) | (~0 & MASK_ALPHA);
+            }
+
+
+            inline auto Span(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) const -> void;
+
+
+            inline auto Fill(
+                    uint32_t * dst,
+                    uint32_t color,
+                    int count) const -> void;
+        };
+
+
+        [[nodiscard]]
+        constexpr inline auto MultiplyDiv255(
+                uint32_t a,
+                uint32_t b) -> uint32_t {
+            const auto t = a * b + 128;
+            return (t + (t >> 8)) >> 8;
+        }
+
+
+        constexpr auto BILINEAR_DIGITS = 7;
+        constexpr auto BILINEAR_ONE = 1u << BILINEAR_DIGITS;
+
+
+        // Weights are in 1 / BILINEAR_ONE steps: fx blends c00 towards c01 and c10 towards c11, fy the rows.
+        [[nodiscard]]
+        constexpr inline auto Bilinear(
+                uint32_t c00,
+                uint32_t c01,
+                uint32_t c10,
+                uint32_t c11,
+                uint32_t fx,
+                uint32_t fy) -> uint32_t {
+            const auto channel = [&](uint32_t shift) {
+                const auto top = ((c00 >> shift) & 0xFF) * (BILINEAR_ONE - fx) + ((c01 >> shift) & 0xFF) * fx;
+                const auto bottom = ((c10 >> shift) & 0xFF) * (BILINEAR_ONE - fx) + ((c11 >> shift) & 0xFF) * fx;
+                constexpr auto digits = 2 * BILINEAR_DIGITS;
+                return ((top * (BILINEAR_ONE - fy) + bottom * fy + (1u << (digits - 1))) >> digits) << shift;
+            };
+
+            return channel(SHIFT_RED) | channel(SHIFT_GREEN) | channel(SHIFT_BLUE) | channel(SHIFT_ALPHA);
+        }
+
+
+        [[nodiscard]]
+        [[maybe_unused]]
+        constexpr inline auto Premultiply(
+                uint32_t pixel) -> uint32_t {
+            const auto a = (pixel >> SHIFT_ALPHA) & 0xFF;
+
+            return
+                    (MultiplyDiv255((pixel >> SHIFT_RED) & 0xFF, a) << SHIFT_RED)
+                    | (MultiplyDiv255((pixel >> SHIFT_GREEN) & 0xFF, a) << SHIFT_GREEN)
+                    | (MultiplyDiv255((pixel >> SHIFT_BLUE) & 0xFF, a) << SHIFT_BLUE)
+                    | (pixel & MASK_ALPHA);
+        }
+
+
+        [[nodiscard]]
+        [[maybe_unused]]
+        constexpr inline auto Unpremultiply(
+                uint32_t pixel) -> uint32_t {
+            const auto a = (pixel >> SHIFT_ALPHA) & 0xFF;
+            if (not a) {
+                return 0;
+            }
+
+            const auto channel = [&](uint32_t shift) {
+                return std::min<uint32_t>(255, (((pixel >> shift) & 0xFF) * 255 + a / 2) / a) << shift;
+            };
+
+            return channel(SHIFT_RED) | channel(SHIFT_GREEN) | channel(SHIFT_BLUE) | (pixel & MASK_ALPHA);
+        }
+
+
+        // Scales the alpha of a straight-alpha pixel by coverage / 255, leaving the color channels untouched.
+        [[nodiscard]]
+        [[maybe_unused]]
+        constexpr inline auto ScaleAlpha(
+                uint32_t pixel,
+                uint32_t coverage) -> uint32_t {
+            return (pixel & ~MASK_ALPHA) | (MultiplyDiv255((pixel >> SHIFT_ALPHA) & 0xFF, coverage) << SHIFT_ALPHA);
+        }
+
+
+        // Scales all four channels of a premultiplied pixel by coverage / 255.
+        [[nodiscard]]
+        [[maybe_unused]]
+        constexpr inline auto ScalePremultiplied(
+                uint32_t pixel,
+                uint32_t coverage) -> uint32_t {
+            const auto channel = [&](uint32_t shift) {
+                return MultiplyDiv255((pixel >> shift) & 0xFF, coverage) << shift;
+            };
+
+            return channel(SHIFT_RED) | channel(SHIFT_GREEN) | channel(SHIFT_BLUE) | channel(SHIFT_ALPHA);
+        }
+
+
+        // Source-over for premultiplied pixels on both sides: result = src + dst * (255 - src alpha) / 255, alpha
+        // included, so translucent layers composite correctly onto transparent ones.
+        struct PremultipliedOver : BlendPolicy<PremultipliedOver> {
+            static constexpr auto OVERWRITES_OPAQUE = true;
+            static constexpr auto PREMULTIPLIED = true;
+
+
+            [[nodiscard]]
+            inline auto operator()(
+                    uint32_t foreground,
+                    uint32_t background) const -> uint32_t {
+                const auto inv_alpha = 255 - ((foreground >> SHIFT_ALPHA) & 0xFF);
+
+                const auto channel = [&](uint32_t shift) {
+                    const auto value =
+                            ((foreground >> shift) & 0xFF) + MultiplyDiv255((background >> shift) & 0xFF, inv_alpha);
+                    return std::min<uint32_t>(value, 255) << shift;
+                };
+
+                return channel(SHIFT_RED) | channel(SHIFT_GREEN) | channel(SHIFT_BLUE) | channel(SHIFT_ALPHA);
+            }
+
+
+            inline auto Span(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) const -> void;
+
+
+            inline auto Fill(
+                    uint32_t * dst,
+                    uint32_t color,
+                    int count) const -> void;
+        };
+
+
+        template<uint32_t (* BlendFn)(uint32_t, uint32_t)>
+        struct Function : BlendPolicy<Function<BlendFn>> {
+            [[nodiscard]]
+            inline auto operator()(
+                    uint32_t foreground,
+                    uint32_t background) const -> uint32_t {
+                return BlendFn(foreground, background);
+            }
+        };
+
+
+        namespace simd {
+#if defined(CHERRY_SIMD_AVX2)
+
+
+            [[nodiscard]]
+            inline auto FastAlphaBlend8(
+                    __m256i foreground,
+                    __m256i background) -> __m256i {
+                const auto zero = _mm256_setzero_si256();
+                const auto mask_alpha = _mm256_set1_epi32(static_cast<int>(MASK_ALPHA));
+
+                const auto fg_lo = _mm256_unpacklo_epi8(foreground, zero);
+                const auto fg_hi = _mm256_unpackhi_epi8(foreground, zero);
+                const auto bg_lo = _mm256_unpacklo_epi8(background, zero);
+                const auto bg_hi = _mm256_unpackhi_epi8(background, zero);
+
+                constexpr auto broadcast = _MM_SHUFFLE(INDEX_ALPHA, INDEX_ALPHA, INDEX_ALPHA, INDEX_ALPHA);
+                const auto fg_a_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(fg_lo, broadcast), broadcast);
+                const auto fg_a_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(fg_hi, broadcast), broadcast);
+
+                const auto one = _mm256_set1_epi16(1);
+                const auto full = _mm256_set1_epi16(256);
+
+                const auto lo = _mm256_srli_epi16(
+                        _mm256_add_epi16(
+                                _mm256_mullo_epi16(fg_lo, _mm256_add_epi16(fg_a_lo, one)),
+                                _mm256_mullo_epi16(bg_lo, _mm256_sub_epi16(full, fg_a_lo))),
+                        8);
+                const auto hi = _mm256_srli_epi16(
+                        _mm256_add_epi16(
+                                _mm256_mullo_epi16(fg_hi, _mm256_add_epi16(fg_a_hi, one)),
+                                _mm256_mullo_epi16(bg_hi, _mm256_sub_epi16(full, fg_a_hi))),
+                        8);
+
+                const auto blended = _mm256_or_si256(_mm256_packus_epi16(lo, hi), mask_alpha);
+                const auto transparent = _mm256_cmpeq_epi32(_mm256_and_si256(foreground, mask_alpha), zero);
+
+                return _mm256_blendv_epi8(blended, background, transparent);
+            }
+
+
+#endif // CHERRY_SIMD_AVX2
+#if defined(CHERRY_SIMD_SSE2)
+
+
+            [[nodiscard]]
+            inline auto FastAlphaBlend4(
+                    __m128i foreground,
+                    __m128i background) -> __m128i {
+                const auto zero = _mm_setzero_si128();
+                const auto mask_alpha = _mm_set1_epi32(static_cast<int>(MASK_ALPHA));
+
+                const auto fg_lo = _mm_unpacklo_epi8(foreground, zero);
+                const auto fg_hi = _mm_unpackhi_epi8(foreground, zero);
+                const auto bg_lo = _mm_unpacklo_epi8(background, zero);
+                const auto bg_hi = _mm_unpackhi_epi8(background, zero);
+
+                constexpr auto broadcast = _MM_SHUFFLE(INDEX_ALPHA, INDEX_ALPHA, INDEX_ALPHA, INDEX_ALPHA);
+                const auto fg_a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(fg_lo, broadcast), broadcast);
+                const auto fg_a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(fg_hi, broadcast), broadcast);
+
+                const auto one = _mm_set1_epi16(1);
+                const auto full = _mm_set1_epi16(256);
+
+                const auto lo = _mm_srli_epi16(
+                        _mm_add_epi16(
+                                _mm_mullo_epi16(fg_lo, _mm_add_epi16(fg_a_lo, one)),
+                                _mm_mullo_epi16(bg_lo, _mm_sub_epi16(full, fg_a_lo))),
+                        8);
+                const auto hi = _mm_srli_epi16(
+                        _mm_add_epi16(
+                                _mm_mullo_epi16(fg_hi, _mm_add_epi16(fg_a_hi, one)),
+                                _mm_mullo_epi16(bg_hi, _mm_sub_epi16(full, fg_a_hi))),
+                        8);
+
+                const auto blended = _mm_or_si128(_mm_packus_epi16(lo, hi), mask_alpha);
+                const auto transparent = _mm_cmpeq_epi32(_mm_and_si128(foreground, mask_alpha), zero);
+
+                return _mm_or_si128(_mm_and_si128(transparent, background), _mm_andnot_si128(transparent, blended));
+            }
+
+
+#elif defined(CHERRY_SIMD_NEON)
+
+
+            [[nodiscard]]
+            inline auto FastAlphaBlend4(
+                    uint32x4_t foreground,
+                    uint32x4_t background) -> uint32x4_t {
+                const auto mask_alpha = vdupq_n_u32(MASK_ALPHA);
+
+                const auto fg_a = vandq_u32(
+                        vshlq_u32(foreground, vdupq_n_s32(-static_cast<int32_t>(SHIFT_ALPHA))),
+                        vdupq_n_u32(0xFF));
+                const auto fg_a8 = vreinterpretq_u8_u32(vmulq_n_u32(fg_a, 0x01010101u));
+
+                const auto fg8 = vreinterpretq_u8_u32(foreground);
+                const auto bg8 = vreinterpretq_u8_u32(background);
+
+                const auto one = vdupq_n_u16(1);
+                const auto full = vdupq_n_u16(256);
+
+                const auto lo = vmlaq_u16(
+                        vmulq_u16(vmovl_u8(vget_low_u8(fg8)), vaddw_u8(one, vget_low_u8(fg_a8))),
+                        vmovl_u8(vget_low_u8(bg8)),
+                        vsubw_u8(full, vget_low_u8(fg_a8)));
+                const auto hi = vmlaq_u16(
+                        vmulq_u16(vmovl_u8(vget_high_u8(fg8)), vaddw_u8(one, vget_high_u8(fg_a8))),
+                        vmovl_u8(vget_high_u8(bg8)),
+                        vsubw_u8(full, vget_high_u8(fg_a8)));
+
+                const auto blended = vorrq_u32(
+                        vreinterpretq_u32_u8(vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8))),
+                        mask_alpha);
+                const auto transparent = vceqq_u32(vandq_u32(foreground, mask_alpha), vdupq_n_u32(0));
+
+                return vbslq_u32(transparent, background, blended);
+            }
+
+
+#endif // CHERRY_SIMD_SSE2 / CHERRY_SIMD_NEON
+
+
+            inline auto FastAlphaBlendSpan(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) -> void {
+                auto i = 0;
+#if defined(CHERRY_SIMD_AVX2)
+                for (; i + 8 <= count; i += 8) {
+                    const auto fg = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                    const auto bg = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), FastAlphaBlend8(fg, bg));
+                }
+#endif
+#if defined(CHERRY_SIMD_SSE2)
+                for (; i + 4 <= count; i += 4) {
+                    const auto fg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                    const auto bg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), FastAlphaBlend4(fg, bg));
+                }
+#elif defined(CHERRY_SIMD_NEON)
+                for (; i + 4 <= count; i += 4) {
+                    vst1q_u32(dst + i, FastAlphaBlend4(vld1q_u32(src + i), vld1q_u32(dst + i)));
+                }
+#endif
+                for (; i < count; i += 1) {
+                    dst[i] = FastAlphaBlend{}(src[i], dst[i]);
+                }
+            }
+
+
+            inline auto FastAlphaFillSpan(
+                    uint32_t * dst,
+                    uint32_t color,
+                    int count) -> void {
+                auto i = 0;
+#if defined(CHERRY_SIMD_AVX2)
+                const auto fg8 = _mm256_set1_epi32(static_cast<int>(color));
+                for (; i + 8 <= count; i += 8) {
+                    const auto bg = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), FastAlphaBlend8(fg8, bg));
+                }
+#endif
+#if defined(CHERRY_SIMD_SSE2)
+                const auto fg4 = _mm_set1_epi32(static_cast<int>(color));
+                for (; i + 4 <= count; i += 4) {
+                    const auto bg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), FastAlphaBlend4(fg4, bg));
+                }
+#elif defined(CHERRY_SIMD_NEON)
+                const auto fg4 = vdupq_n_u32(color);
+                for (; i + 4 <= count; i += 4) {
+                    vst1q_u32(dst + i, FastAlphaBlend4(fg4, vld1q_u32(dst + i)));
+                }
+#endif
+                for (; i < count; i += 1) {
+                    dst[i] = FastAlphaBlend{}(color, dst[i]);
+                }
+            }
+
+
+#if defined(CHERRY_SIMD_AVX2)
+
+
+            [[nodiscard]]
+            inline auto MultiplyDiv255x16(
+                    __m256i a,
+                    __m256i b) -> __m256i {
+                const auto t = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+                return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+            }
+
+
+            [[nodiscard]]
+            inline auto BroadcastAlpha16(
+                    __m256i pixels16) -> __m256i {
+                constexpr auto broadcast = _MM_SHUFFLE(INDEX_ALPHA, INDEX_ALPHA, INDEX_ALPHA, INDEX_ALPHA);
+                return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels16, broadcast), broadcast);
+            }
+
+
+            [[nodiscard]]
+            inline auto Premultiply8(
+                    __m256i pixels) -> __m256i {
+                const auto zero = _mm256_setzero_si256();
+                const auto mask_alpha = _mm256_set1_epi32(static_cast<int>(MASK_ALPHA));
+
+                const auto lo = _mm256_unpacklo_epi8(pixels, zero);
+                const auto hi = _mm256_unpackhi_epi8(pixels, zero);
+
+                const auto scaled = _mm256_packus_epi16(
+                        MultiplyDiv255x16(lo, BroadcastAlpha16(lo)),
+                        MultiplyDiv255x16(hi, BroadcastAlpha16(hi)));
+
+                return _mm256_or_si256(_mm256_andnot_si256(mask_alpha, scaled), _mm256_and_si256(pixels, mask_alpha));
+            }
+
+
+            [[nodiscard]]
+            inline auto PremultipliedOver8(
+                    __m256i foreground,
+                    __m256i background) -> __m256i {
+                const auto zero = _mm256_setzero_si256();
+                const auto full = _mm256_set1_epi16(255);
+
+                const auto inv_lo = _mm256_sub_epi16(full, BroadcastAlpha16(_mm256_unpacklo_epi8(foreground, zero)));
+                const auto inv_hi = _mm256_sub_epi16(full, BroadcastAlpha16(_mm256_unpackhi_epi8(foreground, zero)));
+
+                const auto scaled = _mm256_packus_epi16(
+                        MultiplyDiv255x16(_mm256_unpacklo_epi8(background, zero), inv_lo),
+                        MultiplyDiv255x16(_mm256_unpackhi_epi8(background, zero), inv_hi));
+
+                return _mm256_adds_epu8(foreground, scaled);
+            }
+
+
+#endif // CHERRY_SIMD_AVX2
+#if defined(CHERRY_SIMD_SSE2)
+
+
+            [[nodiscard]]
+            inline auto MultiplyDiv255x8(
+                    __m128i a,
+                    __m128i b) -> __m128i {
+                const auto t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+                return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            }
+
+
+            [[nodiscard]]
+            inline auto BroadcastAlpha8(
+                    __m128i pixels16) -> __m128i {
+                constexpr auto broadcast = _MM_SHUFFLE(INDEX_ALPHA, INDEX_ALPHA, INDEX_ALPHA, INDEX_ALPHA);
+                return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels16, broadcast), broadcast);
+            }
+
+
+            [[nodiscard]]
+            inline auto Premultiply4(
+                    __m128i pixels) -> __m128i {
+                const auto zero = _mm_setzero_si128();
+                const auto mask_alpha = _mm_set1_epi32(static_cast<int>(MASK_ALPHA));
+
+                const auto lo = _mm_unpacklo_epi8(pixels, zero);
+                const auto hi = _mm_unpackhi_epi8(pixels, zero);
+
+                const auto scaled = _mm_packus_epi16(
+                        MultiplyDiv255x8(lo, BroadcastAlpha8(lo)),
+                        MultiplyDiv255x8(hi, BroadcastAlpha8(hi)));
+
+                return _mm_or_si128(_mm_andnot_si128(mask_alpha, scaled), _mm_and_si128(pixels, mask_alpha));
+            }
+
+
+            [[nodiscard]]
+            inline auto PremultipliedOver4(
+                    __m128i foreground,
+                    __m128i background) -> __m128i {
+                const auto zero = _mm_setzero_si128();
+                const auto full = _mm_set1_epi16(255);
+
+                const auto inv_lo = _mm_sub_epi16(full, BroadcastAlpha8(_mm_unpacklo_epi8(foreground, zero)));
+                const auto inv_hi = _mm_sub_epi16(full, BroadcastAlpha8(_mm_unpackhi_epi8(foreground, zero)));
+
+                const auto scaled = _mm_packus_epi16(
+                        MultiplyDiv255x8(_mm_unpacklo_epi8(background, zero), inv_lo),
+                        MultiplyDiv255x8(_mm_unpackhi_epi8(background, zero), inv_hi));
+
+                return _mm_adds_epu8(foreground, scaled);
+            }
+
+
+            [[nodiscard]]
+            inline auto Bilinear4(
+                    __m128i c00,
+                    __m128i c01,
+                    __m128i c10,
+                    __m128i c11,
+                    __m128i fx,
+                    __m128i fy) -> __m128i {
+                const auto zero = _mm_setzero_si128();
+                const auto one = _mm_set1_epi32(BILINEAR_ONE);
+
+                const auto fx16 = _mm_or_si128(fx, _mm_slli_epi32(fx, 16));
+                const auto ifx16 = _mm_sub_epi16(_mm_set1_epi16(BILINEAR_ONE), fx16);
+
+                const auto lerp = [&](__m128i left, __m128i right, bool high) {
+                    const auto weight = high ? _mm_unpackhi_epi32(fx16, fx16) : _mm_unpacklo_epi32(fx16, fx16);
+                    const auto inverse = high ? _mm_unpackhi_epi32(ifx16, ifx16) : _mm_unpacklo_epi32(ifx16, ifx16);
+                    const auto left16 = high ? _mm_unpackhi_epi8(left, zero) : _mm_unpacklo_epi8(left, zero);
+                    const auto right16 = high ? _mm_unpackhi_epi8(right, zero) : _mm_unpacklo_epi8(right, zero);
+                    return _mm_add_epi16(_mm_mullo_epi16(left16, inverse), _mm_mullo_epi16(right16, weight));
+                };
+
+                const auto top_lo = lerp(c00, c01, false);
+                const auto top_hi = lerp(c00, c01, true);
+                const auto bottom_lo = lerp(c10, c11, false);
+                const auto bottom_hi = lerp(c10, c11, true);
+
+                const auto fy_pairs = _mm_or_si128(_mm_sub_epi32(one, fy), _mm_slli_epi32(fy, 16));
+                const auto rounding = _mm_set1_epi32(1 << (2 * BILINEAR_DIGITS - 1));
+
+                const auto vertical = [&](__m128i pairs, __m128i weights) {
+                    const auto sum = _mm_add_epi32(_mm_madd_epi16(pairs, weights), rounding);
+                    return _mm_srli_epi32(sum, 2 * BILINEAR_DIGITS);
+                };
+
+                const auto p0 = vertical(_mm_unpacklo_epi16(top_lo, bottom_lo), _mm_shuffle_epi32(fy_pairs, 0x00));
+                const auto p1 = vertical(_mm_unpackhi_epi16(top_lo, bottom_lo), _mm_shuffle_epi32(fy_pairs, 0x55));
+                const auto p2 = vertical(_mm_unpacklo_epi16(top_hi, bottom_hi), _mm_shuffle_epi32(fy_pairs, 0xAA));
+                const auto p3 = vertical(_mm_unpackhi_epi16(top_hi, bottom_hi), _mm_shuffle_epi32(fy_pairs, 0xFF));
+
+                return _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+            }
+
+
+#elif defined(CHERRY_SIMD_NEON)
+
+
+            [[nodiscard]]
+            inline auto MultiplyDiv255x8(
+                    uint8x8_t a,
+                    uint8x8_t b) -> uint8x8_t {
+                const auto t = vaddq_u16(vmull_u8(a, b), vdupq_n_u16(128));
+                return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+            }
+
+
+            [[nodiscard]]
+            inline auto BroadcastAlpha(
+                    uint32x4_t pixels) -> uint8x16_t {
+                const auto alpha = vandq_u32(
+                        vshlq_u32(pixels, vdupq_n_s32(-static_cast<int32_t>(SHIFT_ALPHA))),
+                        vdupq_n_u32(0xFF));
+                return vreinterpretq_u8_u32(vmulq_n_u32(alpha, 0x01010101u));
+            }
+
+
+            [[nodiscard]]
+            inline auto Premultiply4(
+                    uint32x4_t pixels) -> uint32x4_t {
+                const auto alpha = BroadcastAlpha(pixels);
+                const auto pixels8 = vreinterpretq_u8_u32(pixels);
+
+                const auto scaled = vreinterpretq_u32_u8(vcombine_u8(
+                        MultiplyDiv255x8(vget_low_u8(pixels8), vget_low_u8(alpha)),
+                        MultiplyDiv255x8(vget_high_u8(pixels8), vget_high_u8(alpha))));
+
+                return vbslq_u32(vdupq_n_u32(MASK_ALPHA), pixels, scaled);
+            }
+
+
+            [[nodiscard]]
+            inline auto PremultipliedOver4(
+                    uint32x4_t foreground,
+                    uint32x4_t background) -> uint32x4_t {
+                const auto inv_alpha = vmvnq_u8(BroadcastAlpha(foreground));
+                const auto background8 = vreinterpretq_u8_u32(background);
+
+                const auto scaled = vcombine_u8(
+                        MultiplyDiv255x8(vget_low_u8(background8), vget_low_u8(inv_alpha)),
+                        MultiplyDiv255x8(vget_high_u8(background8), vget_high_u8(inv_alpha)));
+
+                return vreinterpretq_u32_u8(vqaddq_u8(vreinterpretq_u8_u32(foreground), scaled));
+            }
+
+
+            [[nodiscard]]
+            inline auto Bilinear4(
+                    uint32x4_t c00,
+                    uint32x4_t c01,
+                    uint32x4_t c10,
+                    uint32x4_t c11,
+                    uint32x4_t fx,
+                    uint32x4_t fy) -> uint32x4_t {
+                const auto fx8 = vreinterpretq_u8_u32(vmulq_n_u32(fx, 0x01010101u));
+                const auto ifx8 = vsubq_u8(vdupq_n_u8(BILINEAR_ONE), fx8);
+
+                const auto lerp = [&](uint32x4_t left, uint32x4_t right, bool high) {
+                    const auto left8 = vreinterpretq_u8_u32(left);
+                    const auto right8 = vreinterpretq_u8_u32(right);
+                    return high
+                           ? vmlal_u8(vmull_u8(vget_high_u8(left8), vget_high_u8(ifx8)),
+                                      vget_high_u8(right8), vget_high_u8(fx8))
+                           : vmlal_u8(vmull_u8(vget_low_u8(left8), vget_low_u8(ifx8)),
+                                      vget_low_u8(right8), vget_low_u8(fx8));
+                };
+
+                const auto top_lo = lerp(c00, c01, false);
+                const auto top_hi = lerp(c00, c01, true);
+                const auto bottom_lo = lerp(c10, c11, false);
+                const auto bottom_hi = lerp(c10, c11, true);
+
+                const auto vertical = [&](uint16x4_t top, uint16x4_t bottom, uint32_t weight) {
+                    const auto sum = vmlal_n_u16(vmull_n_u16(top, static_cast<uint16_t>(BILINEAR_ONE - weight)),
+                                                 bottom, static_cast<uint16_t>(weight));
+                    return vrshrn_n_u32(sum, 2 * BILINEAR_DIGITS);
+                };
+
+                const auto lo = vcombine_u16(
+                        vertical(vget_low_u16(top_lo), vget_low_u16(bottom_lo), vgetq_lane_u32(fy, 0)),
+                        vertical(vget_high_u16(top_lo), vget_high_u16(bottom_lo), vgetq_lane_u32(fy, 1)));
+                const auto hi = vcombine_u16(
+                        vertical(vget_low_u16(top_hi), vget_low_u16(bottom_hi), vgetq_lane_u32(fy, 2)),
+                        vertical(vget_high_u16(top_hi), vget_high_u16(bottom_hi), vgetq_lane_u32(fy, 3)));
+
+                return vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+            }
+
+
+#endif // CHERRY_SIMD_SSE2 / CHERRY_SIMD_NEON
+
+
+            inline auto PremultiplySpan(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) -> void {
+                auto i = 0;
+#if defined(CHERRY_SIMD_AVX2)
+                for (; i + 8 <= count; i += 8) {
+                    const auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), Premultiply8(pixels));
+                }
+#endif
+#if defined(CHERRY_SIMD_SSE2)
+                for (; i + 4 <= count; i += 4) {
+                    const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), Premultiply4(pixels));
+                }
+#elif defined(CHERRY_SIMD_NEON)
+                for (; i + 4 <= count; i += 4) {
+                    vst1q_u32(dst + i, Premultiply4(vld1q_u32(src + i)));
+                }
+#endif
+                for (; i < count; i += 1) {
+                    dst[i] = Premultiply(src[i]);
+                }
+            }
+
+
+            inline auto PremultipliedOverSpan(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) -> void {
+                auto i = 0;
+#if defined(CHERRY_SIMD_AVX2)
+                for (; i + 8 <= count; i += 8) {
+                    const auto fg = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                    const auto bg = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), PremultipliedOver8(fg, bg));
+                }
+#endif
+#if defined(CHERRY_SIMD_SSE2)
+                for (; i + 4 <= count; i += 4) {
+                    const auto fg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                    const auto bg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), PremultipliedOver4(fg, bg));
+                }
+#elif defined(CHERRY_SIMD_NEON)
+                for (; i + 4 <= count; i += 4) {
+                    vst1q_u32(dst + i, PremultipliedOver4(vld1q_u32(src + i), vld1q_u32(dst + i)));
+                }
+#endif
+                for (; i < count; i += 1) {
+                    dst[i] = PremultipliedOver{}(src[i], dst[i]);
+                }
+            }
+
+
+            inline auto PremultipliedOverFillSpan(
+                    uint32_t * dst,
+                    uint32_t color,
+                    int count) -> void {
+                auto i = 0;
+#if defined(CHERRY_SIMD_AVX2)
+                const auto fg8 = _mm256_set1_epi32(static_cast<int>(color));
+                for (; i + 8 <= count; i += 8) {
+                    const auto bg = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), PremultipliedOver8(fg8, bg));
+                }
+#endif
+#if defined(CHERRY_SIMD_SSE2)
+                const auto fg4 = _mm_set1_epi32(static_cast<int>(color));
+                for (; i + 4 <= count; i += 4) {
+                    const auto bg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), PremultipliedOver4(fg4, bg));
+                }
+#elif defined(CHERRY_SIMD_NEON)
+                const auto fg4 = vdupq_n_u32(color);
+                for (; i + 4 <= count; i += 4) {
+                    vst1q_u32(dst + i, PremultipliedOver4(fg4, vld1q_u32(dst + i)));
+                }
+#endif
+                for (; i < count; i += 1) {
+                    dst[i] = PremultipliedOver{}(color, dst[i]);
+                }
+            }
+
+
+            template<typename From, typename To>
+            inline auto SwizzleSpan(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) -> void {
+                auto i = 0;
+#if defined(CHERRY_SIMD_AVX2)
+                // Byte To::INDEX_c of every output pixel takes byte From::INDEX_c of the same pixel.
+                constexpr auto pattern =
+                        (From::INDEX_RED << To::SHIFT_RED)
+                        | (From::INDEX_GREEN << To::SHIFT_GREEN)
+                        | (From::INDEX_BLUE << To::SHIFT_BLUE)
+                        | (From::INDEX_ALPHA << To::SHIFT_ALPHA);
+                const auto shuffle = _mm256_add_epi8(
+                        _mm256_set1_epi32(static_cast<int>(pattern)),
+                        _mm256_setr_epi32(0, 0x04040404, 0x08080808, 0x0C0C0C0C, 0, 0x04040404, 0x08080808, 0x0C0C0C0C));
+
+                for (; i + 8 <= count; i += 8) {
+                    const auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(pixels, shuffle));
+                }
+#endif
+#if defined(CHERRY_SIMD_SSE2)
+                const auto move = [](__m128i pixels, uint32_t from, uint32_t to) {
+                    const auto shifted = from < to
+                                         ? _mm_sll_epi32(pixels, _mm_cvtsi32_si128(static_cast<int>(to - from)))
+                                         : _mm_srl_epi32(pixels, _mm_cvtsi32_si128(static_cast<int>(from - to)));
+                    return _mm_and_si128(shifted, _mm_set1_epi32(static_cast<int>(0xFFu << to)));
+                };
+
+                for (; i + 4 <= count; i += 4) {
+                    const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                    const auto swizzled = _mm_or_si128(
+                            _mm_or_si128(move(pixels, From::SHIFT_RED, To::SHIFT_RED),
+                                         move(pixels, From::SHIFT_GREEN, To::SHIFT_GREEN)),
+                            _mm_or_si128(move(pixels, From::SHIFT_BLUE, To::SHIFT_BLUE),
+                                         move(pixels, From::SHIFT_ALPHA, To::SHIFT_ALPHA)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), swizzled);
+                }
+#elif defined(CHERRY_SIMD_NEON)
+                const auto move = [](uint32x4_t pixels, uint32_t from, uint32_t to) {
+                    const auto shift = vdupq_n_s32(static_cast<int32_t>(to) - static_cast<int32_t>(from));
+                    return vandq_u32(vshlq_u32(pixels, shift), vdupq_n_u32(0xFFu << to));
+                };
+
+                for (; i + 4 <= count; i += 4) {
+                    const auto pixels = vld1q_u32(src + i);
+                    const auto swizzled = vorrq_u32(
+                            vorrq_u32(move(pixels, From::SHIFT_RED, To::SHIFT_RED),
+                                      move(pixels, From::SHIFT_GREEN, To::SHIFT_GREEN)),
+                            vorrq_u32(move(pixels, From::SHIFT_BLUE, To::SHIFT_BLUE),
+                                      move(pixels, From::SHIFT_ALPHA, To::SHIFT_ALPHA)));
+                    vst1q_u32(dst + i, swizzled);
+                }
+#endif
+                for (; i < count; i += 1) {
+                    dst[i] = Swizzle<From, To>(src[i]);
+                }
+            }
+
+
+            // Non-temporal stores write around the cache instead of reading every line in first; call StreamFence
+            // once the last span is written so the stores are visible to other threads.
+            inline auto StreamFillSpan(
+                    uint32_t * dst,
+                    uint32_t color,
+                    int count) -> void {
+                auto i = 0;
+#if defined(CHERRY_SIMD_AVX2)
+                for (; i < count and reinterpret_cast<uintptr_t>(dst + i) % sizeof(__m256i); i += 1) {
+                    dst[i] = color;
+                }
+
+                const auto color8 = _mm256_set1_epi32(static_cast<int>(color));
+                for (; i + 8 <= count; i += 8) {
+                    _mm256_stream_si256(reinterpret_cast<__m256i *>(dst + i), color8);
+                }
+#elif defined(CHERRY_SIMD_SSE2)
+                for (; i < count and reinterpret_cast<uintptr_t>(dst + i) % sizeof(__m128i); i += 1) {
+                    dst[i] = color;
+                }
+
+                const auto color4 = _mm_set1_epi32(static_cast<int>(color));
+                for (; i + 4 <= count; i += 4) {
+                    _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i), color4);
+                }
+#endif
+                if (i < count) {
+                    std::fill_n(dst + i, count - i, color);
+                }
+            }
+
+
+            inline auto StreamFence() -> void {
+#if defined(CHERRY_SIMD_SSE2)
+                _mm_sfence();
+#endif
+            }
+        }
+
+
+        inline auto FastAlphaBlend::Span(
+                uint32_t * dst,
+                const uint32_t * src,
+                int count) const -> void {
+            simd::FastAlphaBlendSpan(dst, src, count);
+        }
+
+
+        inline auto FastAlphaBlend::Fill(
+                uint32_t * dst,
+                uint32_t color,
+                int count) const -> void {
+            simd::FastAlphaFillSpan(dst, color, count);
+        }
+
+
+        inline auto PremultipliedOver::Span(
+                uint32_t * dst,
+                const uint32_t * src,
+                int count) const -> void {
+            simd::PremultipliedOverSpan(dst, src, count);
+        }
+
+
+        inline auto PremultipliedOver::Fill(
+                uint32_t * dst,
+                uint32_t color,
+                int count) const -> void {
+            simd::PremultipliedOverFillSpan(dst, color, count);
+        }
+
+
+        [[maybe_unused]]
+        inline auto PremultiplySpan(
+                uint32_t * dst,
+                const uint32_t * src,
+                int count) -> void {
+            simd::PremultiplySpan(dst, src, count);
+        }
+
+
+        // Converts count pixels from one layout to another; dst may be src. Prefer building with the layout the
+        // output needs, which makes this pass unnecessary.
+        template<typename From, typename To>
+        [[maybe_unused]]
+        inline auto SwizzleSpan(
+                uint32_t * dst,
+                const uint32_t * src,
+                int count) -> void {
+            if constexpr (std::is_same_v<From, To>) {
+                if (dst != src) {
+                    std::memmove(dst, src, sizeof(uint32_t) * count);
+                }
+            }
+            else {
+                simd::SwizzleSpan<From, To>(dst, src, count);
+            }
+        }
+
+
+        [[maybe_unused]]
+        inline auto UnpremultiplySpan(
+                uint32_t * dst,
+                const uint32_t * src,
+                int count) -> void {
+            for (auto i = 0; i < count; i += 1) {
+                dst[i] = Unpremultiply(src[i]);
+            }
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto BlendSpan(
+                uint32_t * dst,
+                const uint32_t * src,
+                int count,
+                const Blend & blend = {}) -> void {
+            static_assert(
+                    std::is_invocable_r_v<uint32_t, const Blend &, uint32_t, uint32_t>,
+                    "Blend must be a color::BlendPolicy"
+            );
+
+            if (count <= 0) {
+                return;
+            }
+
+            if constexpr (stats::ENABLED and Blend::SKIPS_TRANSPARENT) {
+                stats::Write(count - std::count_if(src, src + count, [](uint32_t pixel) {
+                    return not (pixel & MASK_ALPHA);
+                }));
+            }
+            else {
+                stats::Write(count);
+            }
+
+            blend.Span(dst, src, count);
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto FillSpan(
+                uint32_t * dst,
+                uint32_t color,
+                int count,
+                const Blend & blend = {}) -> void {
+            if (count <= 0) {
+                return;
+            }
+
+            if constexpr (Blend::SKIPS_TRANSPARENT) {
+                if (not (color & MASK_ALPHA)) {
+                    return;
+                }
+            }
+
+            stats::Write(count);
+
+            if constexpr (Blend::OVERWRITES_OPAQUE and not Blend::COPIES_SOURCE) {
+                if (MASK_ALPHA == (color & MASK_ALPHA)) {
+                    std::fill_n(dst, count, color);
+                    return;
+                }
+            }
+
+            blend.Fill(dst, color, count);
+        }
+
+
+        constexpr auto SPAN_CHUNK = 256;
+
+
+        template<typename Blend, typename SampleFn>
+        [[maybe_unused]]
+        inline auto BlendSampled(
+                uint32_t * dst,
+                int count,
+                SampleFn && sample,
+                const Blend & blend = {}) -> void {
+            if constexpr (Blend::COPIES_SOURCE) {
+                stats::Write(count);
+                for (auto i = 0; i < count; i += 1) {
+                    dst[i] = sample(i);
+                }
+            }
+            else {
+                uint32_t span[SPAN_CHUNK];
+
+                for (auto start = 0; start < count; start += SPAN_CHUNK) {
+                    const auto length = std::min(SPAN_CHUNK, count - start);
+
+                    for (auto i = 0; i < length; i += 1) {
+                        span[i] = sample(start + i);
+                    }
+
+                    BlendSpan(dst + start, span, length, blend);
+                }
+            }
+        }
+
+
+        // Fades every source pixel by a constant opacity in [0, 255] before Blend sees it: the alpha of straight-alpha
+        // policies, all four channels of premultiplied ones.
+        template<typename Blend>
+        struct WithOpacity : BlendPolicy<WithOpacity<Blend>> {
+            static constexpr auto SKIPS_TRANSPARENT = Blend::SKIPS_TRANSPARENT;
+            static constexpr auto PREMULTIPLIED = Blend::PREMULTIPLIED;
+
+
+            uint32_t Opacity{ 0xFF };
+            Blend Inner{};
+
+
+            WithOpacity(
+                    uint32_t opacity = 0xFF,
+                    const Blend & inner = {})
+                    :
+                    Opacity(opacity),
+                    Inner(inner) {}
+
+
+            [[nodiscard]]
+            inline auto Fade(
+                    uint32_t pixel) const -> uint32_t {
+                return PREMULTIPLIED ? ScalePremultiplied(pixel, Opacity) : ScaleAlpha(pixel, Opacity);
+            }
+
+
+            [[nodiscard]]
+            inline auto operator()(
+                    uint32_t foreground,
+                    uint32_t background) const -> uint32_t {
+                return Inner(Fade(foreground), background);
+            }
+
+
+            inline auto Span(
+                    uint32_t * dst,
+                    const uint32_t * src,
+                    int count) const -> void {
+                uint32_t span[SPAN_CHUNK];
+
+                for (auto start = 0; start < count; start += SPAN_CHUNK) {
+                    const auto length = std::min(SPAN_CHUNK, count - start);
+
+                    for (auto i = 0; i < length; i += 1) {
+                        span[i] = Fade(src[start + i]);
+                    }
+
+                    Inner.Span(dst + start, span, length);
+                }
+            }
+
+
+            inline auto Fill(
+                    uint32_t * dst,
+                    uint32_t color,
+                    int count) const -> void {
+                Inner.Fill(dst, Fade(color), count);
+            }
+        };
+    }
+
+
+    class Canvas final : public utility::BoundsChecking<Canvas> {
+    public:
+        uint32_t * const Data{ nullptr };
+        uint8_t * const DataUint8{ nullptr };
+        const int Width{ 0u };
+        const int Height{ 0u };
+        const int Stride{ 0u };
+        const bool Empty{ false };
+
+
+        Canvas(
+                uint32_t * data,
+                int width,
+                int height,
+                int stride)
+                :
+                Data(data),
+                DataUint8(reinterpret_cast<uint8_t *>(data)),
+                Width(width),
+                Height(height),
+                Stride(stride),
+                Empty(not width or not height) {
+#ifdef CHERRY_CHECK_BOUNDS
+            if (width < 0) {
+                throw std::out_of_range("Invalid width: " + std::to_string(width));
+            }
+            if (height < 0) {
+                throw std::out_of_range("Invalid height: " + std::to_string(height));
+            }
+            if (stride < 0 or stride < width) {
+                throw std::out_of_range("Invalid stride: " + std::to_string(stride));
+            }
+#endif
+        }
+
+
+        [[maybe_unused]]
+        Canvas(
+                uint32_t * data,
+                int width,
+                int height)
+                :
+                Canvas(data, width, height, width) {}
+
+
+        [[maybe_unused]]
+        explicit Canvas(
+                utility::AlignedPixelBuffer & buffer)
+                :
+                Canvas(buffer.Data(), buffer.Width(), buffer.Height(), buffer.Stride()) {}
+
+
+        [[nodiscard]]
+        inline auto View(
+                int x,
+                int y,
+                int width,
+                int height) const -> Canvas {
+            const auto rect = ViewRect(x, y, width, height);
+            auto * const data = rect.IsEmpty() ? Data : SpanUnchecked(rect.Left, rect.Top);
+#ifdef CHERRY_CLIP_BOUNDS
+            // A view hanging off the top or left edge keeps its origin at (x, y) but its data at the first visible
+            // pixel; primitives clip to its Bounds()
+            if (not rect.IsEmpty() and (rect.Left != x or rect.Top != y)) {
+                auto view = Canvas(data, rect.Right - x, rect.Bottom - y, Stride);
+                view.clip_left = rect.Left - x;
+                view.clip_top = rect.Top - y;
+                view.dirty_region = dirty_region;
+                view.dirty_left = dirty_left + x;
+                view.dirty_top = dirty_top + y;
+
+                return view;
+            }
+#endif
+
+            auto view = Canvas(data, rect.Width(), rect.Height(), Stride);
+            view.dirty_region = dirty_region;
+            view.dirty_left = dirty_left + rect.Left;
+            view.dirty_top = dirty_top + rect.Top;
+
+            return view;
+        }
+
+
+        // The area primitives may touch: the whole canvas, except for a view clipped by CHERRY_CLIP_BOUNDS.
+        [[nodiscard]]
+        inline auto Bounds() const -> utility::Rect {
+#ifdef CHERRY_CLIP_BOUNDS
+            return { clip_left, clip_top, Width, Height };
+#else
+            return { 0, 0, Width, Height };
+#endif
+        }
+
+
+        [[maybe_unused]]
+        inline auto TrackDirty(
+                utility::DirtyRegion * region) -> Canvas & {
+            dirty_region = region;
+            dirty_left = 0;
+            dirty_top = 0;
+
+            return *this;
+        }
+
+
+        inline auto MarkDirty(
+                const utility::Rect & rect) const -> void {
+            if (not dirty_region) {
+                return;
+            }
+
+            dirty_region->Add({
+                    rect.Left + dirty_left,
+                    rect.Top + dirty_top,
+                    rect.Right + dirty_left,
+                    rect.Bottom + dirty_top
+            });
+        }
+
+
+        template<typename Blend = color::Overwrite>
+        inline auto BlendPixel(
+                int x,
+                int y,
+                uint32_t color,
+                const Blend & blend = {}) -> Canvas & {
+#ifdef CHERRY_CLIP_BOUNDS
+            if (not IsWithinBounds(x, y)) {
+                return *this;
+            }
+#endif
+            CheckBounds(x, y);
+            stats::Write(1);
+
+            auto & pixel = Data[Offset(x, y)];
+            pixel = blend(color, pixel);
+
+            return *this;
+        }
+
+
+        // A row has no pixel to drop, so under CHERRY_CLIP_BOUNDS a row outside Bounds(), or any row of a view clipped
+        // at its left edge, throws as it does under CHERRY_CHECK_BOUNDS.
+        [[nodiscard]]
+        inline auto Row(
+                int y) const -> uint32_t * {
+#ifdef CHERRY_CLIP_BOUNDS
+            if (clip_left or y < clip_top or y >= Height) {
+                utility::ThrowOutOfBounds(0, y, Width, Height);
+            }
+#endif
+            CheckBounds(0, y);
+
+            return Data + Offset(0, y);
+        }
+
+
+        // For callers that have already checked or clipped the rows they touch, on a canvas whose Bounds() start at
+        // column 0; anything that may draw into a clipped view goes through SpanUnchecked.
+        [[nodiscard]]
+        inline auto RowUnchecked(
+                int y) const -> uint32_t * {
+            return Data + Offset(0, y);
+        }
+
+
+        // Pixel (x, y) and the rest of its row, for callers that have already checked or clipped it to Bounds().
+        [[nodiscard]]
+        inline auto SpanUnchecked(
+                int x,
+                int y) const -> uint32_t * {
+            return Data + Offset(x, y);
+        }
+
+
+        // Under CHERRY_CLIP_BOUNDS pixels outside the image read as transparent.
+        [[nodiscard]]
+        inline auto Pixel(
+                int x,
+                int y) const -> uint32_t {
+#ifdef CHERRY_CLIP_BOUNDS
+            if (not IsWithinBounds(x, y)) {
+                return 0;
+            }
+#endif
+            CheckBounds(x, y);
+
+            return Data[Offset(x, y)];
+        }
+
+
+    private:
+        // Under CHERRY_CLIP_BOUNDS Data holds the first pixel of Bounds(), so a clipped view never points outside
+        // the pixels it was cut from.
+        [[nodiscard]]
+        inline auto Offset(
+                int x,
+                int y) const -> ptrdiff_t {
+#ifdef CHERRY_CLIP_BOUNDS
+            x -= clip_left;
+            y -= clip_top;
+#endif
+            return static_cast<ptrdiff_t>(Stride) * y + x;
+        }
+
+
+        utility::DirtyRegion * dirty_region{ nullptr };
+        int dirty_left{ 0 };
+        int dirty_top{ 0 };
+#ifdef CHERRY_CLIP_BOUNDS
+        int clip_left{ 0 };
+        int clip_top{ 0 };
+#endif
+    };
+
+
+    class ConstCanvas final : public utility::BoundsChecking<ConstCanvas> {
+    public:
+        const uint32_t * const Data{ nullptr };
+        const uint8_t * const DataUint8{ nullptr };
+        const int Width{ 0u };
+        const int Height{ 0u };
+        const int Stride{ 0u };
+        const bool Empty{ false };
+
+
+        ConstCanvas(
+                const uint32_t * data,
+                int width,
+                int height,
+                int stride)
+                :
+                Data(data),
+                DataUint8(reinterpret_cast<const uint8_t *>(data)),
+                Width(width),
+                Height(height),
+                Stride(stride),
+                Empty(not width or not height) {
+#ifdef CHERRY_CHECK_BOUNDS
+            if (width < 0) {
+                throw std::out_of_range("Invalid width: " + std::to_string(width));
+            }
+            if (height < 0) {
+                throw std::out_of_range("Invalid height: " + std::to_string(height));
+            }
+            if (stride < 0 or stride < width) {
+                throw std::out_of_range("Invalid stride: " + std::to_string(stride));
+            }
+#endif
+        }
+
+
+        [[maybe_unused]]
+        ConstCanvas(
+                const uint32_t * data,
+                int width,
+                int height)
+                :
+                ConstCanvas(data, width, height, width) {}
+
+
+        ConstCanvas(
+                const Canvas & canvas)
+                :
+                ConstCanvas(canvas.Data, canvas.Width, canvas.Height, canvas.Stride) {
+#ifdef CHERRY_CLIP_BOUNDS
+            if (canvas.Bounds().Left or canvas.Bounds().Top) {
+                utility::ThrowOutOfBounds(canvas.Bounds(), canvas.Width, canvas.Height);
+            }
+#endif
+        }
+
+
+        [[maybe_unused]]
+        explicit ConstCanvas(
+                const utility::AlignedPixelBuffer & buffer)
+                :
+                ConstCanvas(buffer.Data(), buffer.Width(), buffer.Height(), buffer.Stride()) {}
+
+
+        [[nodiscard]]
+        inline auto View(
+                int x,
+                int y,
+                int width,
+                int height) const -> ConstCanvas {
+            const auto rect = ViewRect(x, y, width, height);
+#ifdef CHERRY_CLIP_BOUNDS
+            // Sources are read whole, so one cannot hang off the top or left edge; the far edges still clip
+            if (not rect.IsEmpty() and (rect.Left != x or rect.Top != y)) {
+                utility::ThrowOutOfBounds({ x, y, x + width, y + height }, Width, Height);
+            }
+#endif
+
+            return { Data + Stride * rect.Top + rect.Left, rect.Width(), rect.Height(), Stride };
+        }
+
+
+        [[nodiscard]]
+        inline auto Bounds() const -> utility::Rect {
+            return { 0, 0, Width, Height };
+        }
+
+
+        // A row has no pixel to drop, so under CHERRY_CLIP_BOUNDS a row outside the image throws as it does under
+        // CHERRY_CHECK_BOUNDS.
+        [[nodiscard]]
+        inline auto Row(
+                int y) const -> const uint32_t * {
+#ifdef CHERRY_CLIP_BOUNDS
+            if (y < 0 or y >= Height) {
+                utility::ThrowOutOfBounds(0, y, Width, Height);
+            }
+#endif
+            CheckBounds(0, y);
+
+            return Data + Stride * y;
+        }
+
+
+        // For callers that have already checked or clipped the rows they touch.
+        [[nodiscard]]
+        inline auto RowUnchecked(
+                int y) const -> const uint32_t * {
+            return Data + Stride * y;
+        }
+
+
+        // Under CHERRY_CLIP_BOUNDS pixels outside the image read as transparent.
+        [[nodiscard]]
+        inline auto Pixel(
+                int x,
+                int y) const -> uint32_t {
+#ifdef CHERRY_CLIP_BOUNDS
+            if (not IsWithinBounds(x, y)) {
+                return 0;
+            }
+#endif
+            CheckBounds(x, y);
+
+            return Data[Stride * y + x];
+        }
+    };
+
+
+    // Per-row run-length classification of a source image by alpha, so blits can skip fully transparent texels and
+    // copy fully opaque ones. The pixels are referenced, not copied, and must outlive the sprite.
+    class Sprite final {
+    public:
+        enum class RunKind : uint8_t {
+            Transparent,
+            Opaque,
+            Partial
+        };
+
+
+        struct Run {
+            int Start{ 0 };
+            int Length{ 0 };
+            RunKind Kind{ RunKind::Partial };
+        };
+
+
+        const ConstCanvas Pixels;
+        const int Width{ 0 };
+        const int Height{ 0 };
+
+
+        explicit Sprite(
+                const ConstCanvas & pixels)
+                :
+                Pixels(pixels),
+                Width(pixels.Width),
+                Height(pixels.Height) {
+            row_begin.reserve(Height + 1);
+
+            for (auto y = 0; y < Height; y += 1) {
+                row_begin.push_back(static_cast<int>(runs.size()));
+
+                const auto * row = Pixels.RowUnchecked(y);
+                for (auto x = 0; x < Width;) {
+                    const auto kind = Classify(row[x]);
+                    const auto start = x;
+
+                    while (x < Width and kind == Classify(row[x])) {
+                        x += 1;
+                    }
+
+                    runs.push_back({ start, x - start, kind });
+                }
+            }
+
+            row_begin.push_back(static_cast<int>(runs.size()));
+        }
+
+
+        [[nodiscard]]
+        inline auto RowRuns(
+                int y) const -> std::pair<const Run *, const Run *> {
+            return { runs.data() + row_begin[y], runs.data() + row_begin[y + 1] };
+        }
+
+
+    private:
+        std::vector<Run> runs;
+        std::vector<int> row_begin;
+
+
+        [[nodiscard]]
+        static inline auto Classify(
+                uint32_t pixel) -> RunKind {
+            const auto alpha = pixel & color::MASK_ALPHA;
+
+            if (not alpha) {
+                return RunKind::Transparent;
+            }
+
+            return color::MASK_ALPHA == alpha ? RunKind::Opaque : RunKind::Partial;
+        }
+    };
+
+
+    // Packs many small images into one zero-initialized buffer using shelves: images are placed left to right on rows
+    // as tall as the first image that opened them. Adding images in decreasing height order packs tightest.
+    class Atlas final {
+        struct Shelf {
+            int Top{ 0 };
+            int Height{ 0 };
+            int Cursor{ 0 };
+        };
+
+
+        utility::AlignedPixelBuffer buffer;
+        std::vector<Shelf> shelves;
+        int next_top{ 0 };
+    public:
+        Atlas(
+                int width,
+                int height)
+                :
+                buffer(width, height) {}
+
+
+        [[nodiscard]]
+        inline auto Width() const -> int {
+            return buffer.Width();
+        }
+
+
+        [[nodiscard]]
+        inline auto Height() const -> int {
+            return buffer.Height();
+        }
+
+
+        [[nodiscard]]
+        inline auto Pixels() const -> ConstCanvas {
+            return { buffer.Data(), buffer.Width(), buffer.Height(), buffer.Stride() };
+        }
+
+
+        [[nodiscard]]
+        inline auto View(
+                const utility::Rect & rect) const -> ConstCanvas {
+            return Pixels().View(rect.Left, rect.Top, rect.Width(), rect.Height());
+        }
+
+
+        // Copies image into free space and returns where it went, or nothing if it does not fit.
+        [[nodiscard]]
+        inline auto Add(
+                const ConstCanvas & image) -> std::optional<utility::Rect> {
+            if (image.Empty or image.Width > Width()) {
+                return std::nullopt;
+            }
+
+            auto * best = static_cast<Shelf *>(nullptr);
+            for (auto & shelf : shelves) {
+                const auto fits = image.Height <= shelf.Height and image.Width <= Width() - shelf.Cursor;
+                if (fits and (not best or shelf.Height < best->Height)) {
+                    best = &shelf;
+                }
+            }
+
+            if (not best) {
+                if (image.Height > Height() - next_top) {
+                    return std::nullopt;
+                }
+
+                shelves.push_back({ next_top, image.Height, 0 });
+                next_top += image.Height;
+                best = &shelves.back();
+            }
+
+            const auto rect = utility::Rect{
+                    best->Cursor,
+                    best->Top,
+                    best->Cursor + image.Width,
+                    best->Top + image.Height
+            };
+            best->Cursor += image.Width;
+
+            for (auto y = 0; y < image.Height; y += 1) {
+                std::memcpy(
+                        buffer.Data() + buffer.Stride() * (rect.Top + y) + rect.Left,
+                        image.RowUnchecked(y),
+                        sizeof(uint32_t) * image.Width
+                );
+            }
+
+            return rect;
+        }
+
+
+        // Adds the images tallest first and returns their placements in the order given.
+        [[maybe_unused]]
+        inline auto AddAll(
+                const std::vector<ConstCanvas> & images) -> std::vector<std::optional<utility::Rect>> {
+            auto order = std::vector<int>(images.size());
+            for (auto i = 0; i < static_cast<int>(order.size()); i += 1) {
+                order[i] = i;
+            }
+
+            std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+                return images[a].Height > images[b].Height;
+            });
+
+            auto placements = std::vector<std::optional<utility::Rect>>(images.size());
+            for (const auto i : order) {
+                placements[i] = Add(images[i]);
+            }
+
+            return placements;
+        }
+
+
+        [[maybe_unused]]
+        inline auto Clear() -> void {
+            shelves.clear();
+            next_top = 0;
+            std::memset(buffer.Data(), 0, sizeof(uint32_t) * buffer.Size());
+        }
+    };
+
+
+    namespace transform {
+        using FixedPoint = utility::Fixed;
+
+
+        [[nodiscard]]
+        constexpr inline auto ApplyRotation(
+                int x,
+                int y,
+                float sin,
+                float cos) -> std::pair<int, int> {
+            return {
+                    std::lround(cos * static_cast<float>(x) + sin * static_cast<float>(y)),
+                    std::lround(-sin * static_cast<float>(x) + cos * static_cast<float>(y))
+            };
+        }
+
+
+        // Converts the overlapping area of src into dst from layout From to layout To, row by row; dst may view the
+        // same pixels as src.
+        template<typename From, typename To>
+        [[maybe_unused]]
+        inline auto Swizzle(
+                const ConstCanvas & src,
+                Canvas & dst) -> decltype(dst) {
+            const auto area = dst.Bounds().Intersection(src.Bounds());
+            if (area.IsEmpty()) {
+                return dst;
+            }
+
+            for (auto y = area.Top; y < area.Bottom; y += 1) {
+                color::SwizzleSpan<From, To>(
+                        dst.SpanUnchecked(area.Left, y),
+                        src.RowUnchecked(y) + area.Left,
+                        area.Width()
+                );
+            }
+            dst.MarkDirty(area);
+
+            return dst;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Blit(
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0,
+                int y0,
+                const Blend & blend = {}) -> decltype(dst) {
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::Blit);
+
+            const auto bounds = dst.Bounds();
+
+            const auto dst_start_y = std::max(y0, bounds.Top);
+            const auto dst_end_y = std::min(y0 + src.Height, bounds.Bottom);
+
+            const auto dst_start_x = std::max(x0, bounds.Left);
+            const auto dst_end_x = std::min(x0 + src.Width, bounds.Right);
+
+            if (dst_start_x >= dst_end_x) {
+                return dst;
+            }
+
+            stats::Visit({ dst_start_x, dst_start_y, dst_end_x, dst_end_y });
+            dst.CheckRect({ dst_start_x, dst_start_y, dst_end_x, dst_end_y });
+            src.CheckRect({ dst_start_x - x0, dst_start_y - y0, dst_end_x - x0, dst_end_y - y0 });
+
+            for (auto y = dst_start_y; y < dst_end_y; y += 1) {
+                color::BlendSpan<Blend>(
+                        dst.SpanUnchecked(dst_start_x, y),
+                        src.RowUnchecked(y - y0) + (dst_start_x - x0),
+                        dst_end_x - dst_start_x,
+                        blend
+                );
+            }
+
+            dst.MarkDirty({ dst_start_x, dst_start_y, dst_end_x, dst_end_y });
+
+            return dst;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Blit(
+                const Sprite & src,
+                Canvas & dst,
+                int x0,
+                int y0,
+                const Blend & blend = {}) -> decltype(dst) {
+            if constexpr (Blend::COPIES_SOURCE) {
+                return Blit<Blend>(src.Pixels, dst, x0, y0, blend);
+            }
+
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::Blit);
+
+            const auto bounds = dst.Bounds();
+
+            const auto dst_start_y = std::max(y0, bounds.Top);
+            const auto dst_end_y = std::min(y0 + src.Height, bounds.Bottom);
+
+            const auto src_start_x = std::max(x0, bounds.Left) - x0;
+            const auto src_end_x = std::min(x0 + src.Width, bounds.Right) - x0;
+
+            if (src_start_x >= src_end_x) {
+                return dst;
+            }
+
+            stats::Visit({ x0 + src_start_x, dst_start_y, x0 + src_end_x, dst_end_y });
+            dst.CheckRect({ x0 + src_start_x, dst_start_y, x0 + src_end_x, dst_end_y });
+            src.Pixels.CheckRect({ src_start_x, dst_start_y - y0, src_end_x, dst_end_y - y0 });
+
+            for (auto y = dst_start_y; y < dst_end_y; y += 1) {
+                const auto * src_row = src.Pixels.RowUnchecked(y - y0) + src_start_x;
+                auto * dst_row = dst.SpanUnchecked(x0 + src_start_x, y);
+
+                const auto [first, last] = src.RowRuns(y - y0);
+                for (auto run = first; run != last; ++run) {
+                    const auto start = std::max(run->Start, src_start_x) - src_start_x;
+                    const auto end = std::min(run->Start + run->Length, src_end_x) - src_start_x;
+                    if (start >= end) {
+                        continue;
+                    }
+
+                    if (Sprite::RunKind::Transparent == run->Kind and Blend::SKIPS_TRANSPARENT) {
+                        continue;
+                    }
+
+                    if (Sprite::RunKind::Opaque == run->Kind and Blend::OVERWRITES_OPAQUE) {
+                        stats::Write(end - start);
+                        std::memcpy(dst_row + start, src_row + start, sizeof(uint32_t) * (end - start));
+                        continue;
+                    }
+
+                    color::BlendSpan<Blend>(dst_row + start, src_row + start, end - start, blend);
+                }
+            }
+
+            dst.MarkDirty({ x0 + src_start_x, dst_start_y, x0 + src_end_x, dst_end_y });
+
+            return dst;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                const Blend & blend = {}) -> decltype(dst) {
+            if (src.Empty) {
+                return dst;
+            }
+
+            const auto target_width = std::abs(x0 - x1);
+            const auto target_height = std::abs(y0 - y1);
+
+            const auto mirrored_x = x0 > x1;
+            const auto mirrored_y = y0 > y1;
+
+            if (target_width == src.Width and target_height == src.Height and not mirrored_x and not mirrored_y) {
+                return Blit<Blend>(src, dst, x0, y0, blend);
+            }
+
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::CopyScaled);
+
+            utility::SortTopLeft(x0, y0, x1, y1);
+
+            const auto bounds = dst.Bounds();
+
+            const auto dst_start_y = std::max(y0, bounds.Top);
+            const auto dst_end_y = std::min(y1, bounds.Bottom);
+
+            const auto dst_start_x = std::max(x0, bounds.Left);
+            const auto dst_end_x = std::min(x1, bounds.Right);
+
+            if (dst_start_x >= dst_end_x or dst_start_y >= dst_end_y) {
+                return dst;
+            }
+
+            stats::Visit({ dst_start_x, dst_start_y, dst_end_x, dst_end_y });
+            dst.CheckRect({ dst_start_x, dst_start_y, dst_end_x, dst_end_y });
+
+            thread_local auto columns = std::vector<int>();
+            columns.resize(dst_end_x - dst_start_x);
+
+            auto u = utility::RationalStep(dst_start_x - x0, src.Width, target_width);
+            for (auto & column : columns) {
+                column = mirrored_x ? src.Width - 1 - u.Value() : u.Value();
+                u.Advance();
+            }
+
+            auto v = utility::RationalStep(dst_start_y - y0, src.Height, target_height);
+            for (auto y = dst_start_y; y < dst_end_y; y += 1, v.Advance()) {
+                const auto src_row = src.RowUnchecked(mirrored_y ? src.Height - 1 - v.Value() : v.Value());
+
+                color::BlendSampled<Blend>(
+                        dst.SpanUnchecked(dst_start_x, y),
+                        dst_end_x - dst_start_x,
+                        [&](int i) { return src_row[columns[i]]; },
+                        blend
+                );
+            }
+
+            dst.MarkDirty({ dst_start_x, dst_start_y, dst_end_x, dst_end_y });
+
+            return dst;
+        }
+
+
+        constexpr auto AFFINE_DIGITS = 16;
+
+
+        inline auto ClipLinearSpan(
+                int64_t start,
+                int64_t step,
+                int64_t low,
+                int64_t high,
+                int & begin,
+                int & end) -> void {
+            if (0 == step) {
+                if (start < low or start >= high) {
+                    end = begin;
+                }
+                return;
+            }
+
+            const auto first = step > 0
+                               ? utility::CeilDiv(low - start, step)
+                               : utility::FloorDiv(start - high, -step) + 1;
+            const auto last = step > 0
+                              ? utility::CeilDiv(high - start, step)
+                              : utility::FloorDiv(start - low, -step) + 1;
+
+            begin = static_cast<int>(std::clamp<int64_t>(first, begin, end));
+            end = static_cast<int>(std::clamp<int64_t>(last, begin, end));
+        }
+
+
+        enum class Sampling : uint8_t {
+            Nearest,
+            Bilinear
+        };
+
+
+        // Filters count pixels along a 16.16 texel-space line, clamping the footprint to the source edges.
+        inline auto SampleBilinear(
+                const ConstCanvas & src,
+                uint32_t * out,
+                int count,
+                int64_t u,
+                int64_t v,
+                int64_t du,
+                int64_t dv) -> void {
+            constexpr auto half = int64_t{ 1 } << (AFFINE_DIGITS - 1);
+            constexpr auto fraction_shift = AFFINE_DIGITS - color::BILINEAR_DIGITS;
+            constexpr auto fraction_mask = static_cast<int64_t>(color::BILINEAR_ONE - 1);
+
+            const auto texel = [&](int i, uint32_t (& quad)[4], uint32_t & fx, uint32_t & fy) {
+                const auto pu = u + i * du - half;
+                const auto pv = v + i * dv - half;
+
+                const auto x = static_cast<int>(pu >> AFFINE_DIGITS);
+                const auto y = static_cast<int>(pv >> AFFINE_DIGITS);
+
+                const auto x_a = std::max(x, 0);
+                const auto x_b = std::min(x + 1, src.Width - 1);
+                const auto * row_a = src.Data + src.Stride * std::max(y, 0);
+                const auto * row_b = src.Data + src.Stride * std::min(y + 1, src.Height - 1);
+
+                quad[0] = row_a[x_a];
+                quad[1] = row_a[x_b];
+                quad[2] = row_b[x_a];
+                quad[3] = row_b[x_b];
+                fx = static_cast<uint32_t>((pu >> fraction_shift) & fraction_mask);
+                fy = static_cast<uint32_t>((pv >> fraction_shift) & fraction_mask);
+            };
+
+            auto i = 0;
+#if defined(CHERRY_SIMD_SSE2) or defined(CHERRY_SIMD_NEON)
+            for (; i + 4 <= count; i += 4) {
+                alignas(16) uint32_t corners[4][4];
+                alignas(16) uint32_t fx[4];
+                alignas(16) uint32_t fy[4];
+
+                for (auto k = 0; k < 4; k += 1) {
+                    uint32_t quad[4];
+                    texel(i + k, quad, fx[k], fy[k]);
+                    for (auto c = 0; c < 4; c += 1) {
+                        corners[c][k] = quad[c];
+                    }
+                }
+
+#if defined(CHERRY_SIMD_SSE2)
+                const auto load = [](const uint32_t * data) {
+                    return _mm_load_si128(reinterpret_cast<const __m128i *>(data));
+                };
+                _mm_storeu_si128(
+                        reinterpret_cast<__m128i *>(out + i),
+                        color::simd::Bilinear4(
+                                load(corners[0]), load(corners[1]), load(corners[2]), load(corners[3]),
+                                load(fx), load(fy)
+                        )
+                );
+#else
+                vst1q_u32(
+                        out + i,
+                        color::simd::Bilinear4(
+                                vld1q_u32(corners[0]), vld1q_u32(corners[1]), vld1q_u32(corners[2]), vld1q_u32(corners[3]),
+                                vld1q_u32(fx), vld1q_u32(fy)
+                        )
+                );
+#endif
+            }
+#endif
+            for (; i < count; i += 1) {
+                uint32_t quad[4];
+                auto fx = 0u;
+                auto fy = 0u;
+                texel(i, quad, fx, fy);
+                out[i] = color::Bilinear(quad[0], quad[1], quad[2], quad[3], fx, fy);
+            }
+        }
+
+
+        // Maps destination offsets from the anchor onto the source around (U0, V0), which need not be a whole texel so
+        // that a mip level can pivot exactly where its source does. The trigonometry is evaluated once so that batches
+        // can reuse it for every band an instance touches.
+        struct AffineMap {
+            double U0{ 0.0 };
+            double V0{ 0.0 };
+
+            double Sin{ 0.0 };
+            double Cos{ 1.0 };
+
+            float ScaleX{ 1.0f };
+            float ScaleY{ 1.0f };
+        };
+
+
+        [[nodiscard]]
+        inline auto MakeAffineMap(
+                double u0,
+                double v0,
+                float rotation,
+                float scale_x,
+                float scale_y) -> AffineMap {
+            return {
+                    u0,
+                    v0,
+                    static_cast<double>(std::sin(rotation)),
+                    static_cast<double>(std::cos(rotation)),
+                    scale_x,
+                    scale_y
+            };
+        }
+
+
+        [[nodiscard]]
+        inline auto AffineBounds(
+                const ConstCanvas & src,
+                int x0,
+                int y0,
+                const AffineMap & map) -> utility::Rect {
+            const auto sin = map.Sin;
+            const auto cos = map.Cos;
+
+            const auto corner = [&](double u, double v) {
+                const auto ru = map.ScaleX * (u - map.U0 - 0.5);
+                const auto rv = map.ScaleY * (v - map.V0 - 0.5);
+                return std::pair(x0 + cos * ru + sin * rv, y0 - sin * ru + cos * rv);
+            };
+
+            const auto[ax, ay] = corner(0, 0);
+            const auto[bx, by] = corner(src.Width, 0);
+            const auto[cx, cy] = corner(src.Width, src.Height);
+            const auto[dx, dy] = corner(0, src.Height);
+
+            const auto[min_x, max_x] = std::minmax({ ax, bx, cx, dx });
+            const auto[min_y, max_y] = std::minmax({ ay, by, cy, dy });
+
+            constexpr auto limit = static_cast<double>(std::numeric_limits<int>::max() / 2);
+
+            return {
+                    static_cast<int>(std::clamp(std::floor(min_x) - 1, -limit, limit)),
+                    static_cast<int>(std::clamp(std::floor(min_y) - 1, -limit, limit)),
+                    static_cast<int>(std::clamp(std::ceil(max_x) + 1, -limit, limit)),
+                    static_cast<int>(std::clamp(std::ceil(max_y) + 1, -limit, limit))
+            };
+        }
+
+
+        [[nodiscard]]
+        inline auto AffineBounds(
+                const ConstCanvas & src,
+                int x0,
+                int y0,
+                int u0,
+                int v0,
+                float rotation,
+                float scale_x,
+                float scale_y) -> utility::Rect {
+            return AffineBounds(src, x0, y0, MakeAffineMap(u0, v0, rotation, scale_x, scale_y));
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto CopyAffine(
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0,
+                int y0,
+                const AffineMap & map,
+                const Blend & blend = {},
+                Sampling sampling = Sampling::Nearest) -> decltype(dst) {
+            const auto u0 = map.U0;
+            const auto v0 = map.V0;
+            const auto sin = map.Sin;
+            const auto cos = map.Cos;
+            const auto scale_x = static_cast<double>(map.ScaleX);
+            const auto scale_y = static_cast<double>(map.ScaleY);
+
+            if (src.Empty or dst.Empty or 0.0 == scale_x or 0.0 == scale_y) {
+                return dst;
+            }
+
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::CopyAffine);
+
+            const auto bounds = AffineBounds(src, x0, y0, map);
+            const auto clip = dst.Bounds();
+            const auto start_y = std::clamp(bounds.Top, clip.Top, clip.Bottom);
+            const auto end_y = std::clamp(bounds.Bottom, clip.Top, clip.Bottom);
+
+            dst.CheckRect({ clip.Left, start_y, clip.Right, end_y });
+
+            constexpr auto one = static_cast<double>(int64_t{ 1 } << AFFINE_DIGITS);
+
+            const auto du_dx = std::llround(one * cos / scale_x);
+            const auto dv_dx = std::llround(one * sin / scale_y);
+
+            const auto u_high = static_cast<int64_t>(src.Width) << AFFINE_DIGITS;
+            const auto v_high = static_cast<int64_t>(src.Height) << AFFINE_DIGITS;
+
+            auto dirty = utility::Rect{};
+
+            for (auto y = start_y; y < end_y; y += 1) {
+                const auto u_start = std::llround(one * (u0 + 0.5 - sin * (y - y0) / scale_x)) - x0 * du_dx;
+                const auto v_start = std::llround(one * (v0 + 0.5 + cos * (y - y0) / scale_y)) - x0 * dv_dx;
+
+                auto begin = clip.Left;
+                auto end = clip.Right;
+                ClipLinearSpan(u_start, du_dx, 0, u_high, begin, end);
+                ClipLinearSpan(v_start, dv_dx, 0, v_high, begin, end);
+
+                if (begin >= end) {
+                    continue;
+                }
+
+                stats::Visit(end - begin);
+                dirty = dirty.Union({ begin, y, end, y + 1 });
+
+                auto u = u_start + begin * du_dx;
+                auto v = v_start + begin * dv_dx;
+
+                if (Sampling::Bilinear == sampling) {
+                    auto * out = dst.SpanUnchecked(begin, y);
+                    const auto count = end - begin;
+
+                    if constexpr (Blend::COPIES_SOURCE) {
+                        stats::Write(count);
+                        SampleBilinear(src, out, count, u, v, du_dx, dv_dx);
+                    }
+                    else {
+                        uint32_t span[color::SPAN_CHUNK];
+
+                        for (auto start = 0; start < count; start += color::SPAN_CHUNK) {
+                            const auto length = std::min(color::SPAN_CHUNK, count - start);
+                            SampleBilinear(src, span, length, u + start * du_dx, v + start * dv_dx, du_dx, dv_dx);
+                            color::BlendSpan(out + start, span, length, blend);
+                        }
+                    }
+                    continue;
+                }
+
+                color::BlendSampled<Blend>(
+                        dst.SpanUnchecked(begin, y),
+                        end - begin,
+                        [&](int) {
+                            const auto pixel = src.Data[(v >> AFFINE_DIGITS) * src.Stride + (u >> AFFINE_DIGITS)];
+                            u += du_dx;
+                            v += dv_dx;
+                            return pixel;
+                        },
+                        blend
+                );
+            }
+
+            dst.MarkDirty(dirty);
+
+            return dst;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto CopyAffine(
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0,
+                int y0,
+                int u0,
+                int v0,
+                float rotation,
+                float scale_x,
+                float scale_y,
+                const Blend & blend = {},
+                Sampling sampling = Sampling::Nearest) -> decltype(dst) {
+            return CopyAffine<Blend>(src, dst, x0, y0, MakeAffineMap(u0, v0, rotation, scale_x, scale_y), blend, sampling);
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0,
+                int y0,
+                int u0,
+                int v0,
+                float rotation,
+                const Blend & blend = {}) -> decltype(dst) {
+            return CopyAffine<Blend>(src, dst, x0, y0, u0, v0, rotation, 1.0f, 1.0f, blend);
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0,
+                int y0,
+                int u0,
+                int v0,
+                float rotation,
+                FixedPoint scale_x,
+                FixedPoint scale_y,
+                const Blend & blend = {}) -> decltype(dst) {
+            return CopyAffine<Blend>(
+                    src,
+                    dst,
+                    x0, y0,
+                    u0, v0,
+                    rotation,
+                    static_cast<float>(scale_x),
+                    static_cast<float>(scale_y),
+                    blend
+            );
+        }
+
+
+        struct Transform {
+            float RotationRadians{ 0.0f };
+
+            int OriginX{ 0 };
+            int OriginY{ 0 };
+
+            float ScaleX{ 1.0f };
+            float ScaleY{ 1.0f };
+
+            Sampling Filter{ Sampling::Nearest };
+        };
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0 = 0,
+                int y0 = 0,
+                const Transform & tf = {},
+                const Blend & blend = {}) -> decltype(dst) {
+            if (0.0f == tf.RotationRadians and 1.0f == tf.ScaleX and 1.0f == tf.ScaleY) {
+                return Blit<Blend>(src, dst, x0 - tf.OriginX, y0 - tf.OriginY, blend);
+            }
+
+            if (Sampling::Bilinear == tf.Filter) {
+                return CopyAffine<Blend>(
+                        src,
+                        dst,
+                        x0, y0,
+                        tf.OriginX, tf.OriginY,
+                        tf.RotationRadians,
+                        static_cast<float>(FixedPoint{ tf.ScaleX }),
+                        static_cast<float>(FixedPoint{ tf.ScaleY }),
+                        blend,
+                        Sampling::Bilinear
+                );
+            }
+
+            if (0.0f == tf.RotationRadians) {
+                const auto scale_x = FixedPoint{ tf.ScaleX };
+                const auto scale_y = FixedPoint{ tf.ScaleY };
+
+                return Copy<Blend>(
+                        src,
+                        dst,
+                        x0 - tf.OriginX * scale_x,
+                        y0 - tf.OriginY * scale_y,
+                        x0 + (src.Width - tf.OriginX) * scale_x,
+                        y0 + (src.Height - tf.OriginY) * scale_y,
+                        blend
+                );
+            }
+
+            if (1.0f == tf.ScaleX and 1.0f == tf.ScaleY) {
+                return Copy<Blend>(
+                        src,
+                        dst,
+                        x0, y0,
+                        tf.OriginX, tf.OriginY,
+                        tf.RotationRadians,
+                        blend
+                );
+            }
+
+            return Copy<Blend>(
+                    src,
+                    dst,
+                    x0, y0,
+                    tf.OriginX, tf.OriginY,
+                    tf.RotationRadians,
+                    FixedPoint{ tf.ScaleX },
+                    FixedPoint{ tf.ScaleY },
+                    blend
+            );
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const Sprite & src,
+                Canvas & dst,
+                int x0 = 0,
+                int y0 = 0,
+                const Transform & tf = {},
+                const Blend & blend = {}) -> decltype(dst) {
+            if (0.0f == tf.RotationRadians and 1.0f == tf.ScaleX and 1.0f == tf.ScaleY) {
+                return Blit<Blend>(src, dst, x0 - tf.OriginX, y0 - tf.OriginY, blend);
+            }
+
+            return Copy<Blend>(src.Pixels, dst, x0, y0, tf, blend);
+        }
+
+
+        [[nodiscard]]
+        [[maybe_unused]]
+        inline auto Bounds(
+                const ConstCanvas & src,
+                int x0 = 0,
+                int y0 = 0,
+                const Transform & tf = {}) -> utility::Rect {
+            const auto unscaled = 1.0f == tf.ScaleX and 1.0f == tf.ScaleY;
+
+            if (0.0f == tf.RotationRadians and (unscaled or Sampling::Nearest == tf.Filter)) {
+                const auto scale_x = FixedPoint{ tf.ScaleX };
+                const auto scale_y = FixedPoint{ tf.ScaleY };
+
+                auto left = x0 - tf.OriginX * scale_x;
+                auto top = y0 - tf.OriginY * scale_y;
+                auto right = x0 + (src.Width - tf.OriginX) * scale_x;
+                auto bottom = y0 + (src.Height - tf.OriginY) * scale_y;
+
+                utility::SortTopLeft(left, top, right, bottom);
+
+                return { left, top, right, bottom };
+            }
+
+            if (unscaled) {
+                return AffineBounds(src, x0, y0, tf.OriginX, tf.OriginY, tf.RotationRadians, 1.0f, 1.0f);
+            }
+
+            return AffineBounds(
+                    src,
+                    x0, y0,
+                    tf.OriginX, tf.OriginY,
+                    tf.RotationRadians,
+                    static_cast<float>(FixedPoint{ tf.ScaleX }),
+                    static_cast<float>(FixedPoint{ tf.ScaleY })
+            );
+        }
+
+
+        // The overloads below taking a source rect draw only that region of src, as if it were an image of its own;
+        // rotation origins are relative to the region. The rect must lie within src.
+        [[nodiscard]]
+        inline auto SourceView(
+                const ConstCanvas & src,
+                const utility::Rect & source) -> ConstCanvas {
+            return src.View(source.Left, source.Top, source.Width(), source.Height());
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Blit(
+                const ConstCanvas & src,
+                const utility::Rect & source,
+                Canvas & dst,
+                int x0,
+                int y0,
+                const Blend & blend = {}) -> decltype(dst) {
+            return Blit<Blend>(SourceView(src, source), dst, x0, y0, blend);
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const ConstCanvas & src,
+                const utility::Rect & source,
+                Canvas & dst,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                const Blend & blend = {}) -> decltype(dst) {
+            return Copy<Blend>(SourceView(src, source), dst, x0, y0, x1, y1, blend);
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const ConstCanvas & src,
+                const utility::Rect & source,
+                Canvas & dst,
+                int x0,
+                int y0,
+                int u0,
+                int v0,
+                float rotation,
+                const Blend & blend = {}) -> decltype(dst) {
+            return Copy<Blend>(SourceView(src, source), dst, x0, y0, u0, v0, rotation, blend);
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const ConstCanvas & src,
+                const utility::Rect & source,
+                Canvas & dst,
+                int x0,
+                int y0,
+                int u0,
+                int v0,
+                float rotation,
+                FixedPoint scale_x,
+                FixedPoint scale_y,
+                const Blend & blend = {}) -> decltype(dst) {
+            return Copy<Blend>(SourceView(src, source), dst, x0, y0, u0, v0, rotation, scale_x, scale_y, blend);
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const ConstCanvas & src,
+                const utility::Rect & source,
+                Canvas & dst,
+                int x0 = 0,
+                int y0 = 0,
+                const Transform & tf = {},
+                const Blend & blend = {}) -> decltype(dst) {
+            return Copy<Blend>(SourceView(src, source), dst, x0, y0, tf, blend);
+        }
+
+
+        [[nodiscard]]
+        [[maybe_unused]]
+        inline auto Bounds(
+                const ConstCanvas & src,
+                const utility::Rect & source,
+                int x0 = 0,
+                int y0 = 0,
+                const Transform & tf = {}) -> utility::Rect {
+            return Bounds(SourceView(src, source), x0, y0, tf);
+        }
+
+
+        // Successively halved copies of a source image, box-filtered with alpha weighting so transparent texels do not
+        // bleed their color into the edges. Level 0 references the source pixels, which must outlive the chain.
+        class MipChain final {
+            std::vector<utility::AlignedPixelBuffer> buffers;
+            std::vector<ConstCanvas> levels;
+        public:
+            explicit MipChain(
+                    const ConstCanvas & src) {
+                levels.push_back(src);
+
+                while (levels.back().Width > 1 or levels.back().Height > 1) {
+                    const auto & level = levels.back();
+                    if (level.Empty) {
+                        break;
+                    }
+
+                    auto buffer = utility::AlignedPixelBuffer(
+                            (level.Width + 1) / 2,
+                            (level.Height + 1) / 2,
+                            utility::Initialization::Uninitialized
+                    );
+                    Downsample(level, buffer);
+
+                    levels.emplace_back(buffer.Data(), buffer.Width(), buffer.Height(), buffer.Stride());
+                    buffers.push_back(std::move(buffer));
+                }
+            }
+
+
+            [[nodiscard]]
+            inline auto Levels() const -> int {
+                return static_cast<int>(levels.size());
+            }
+
+
+            [[nodiscard]]
+            inline auto Level(
+                    int index) const -> const ConstCanvas & {
+                return levels[index];
+            }
+
+
+            // The coarsest level that still holds at least one texel per destination pixel along the less minified axis.
+            [[nodiscard]]
+            inline auto LevelFor(
+                    float scale_x,
+                    float scale_y) const -> int {
+                const auto scale = std::max(std::abs(scale_x), std::abs(scale_y));
+                if (not (scale > 0.0f and scale < 1.0f)) {
+                    return 0;
+                }
+
+                auto index = 0;
+                for (auto footprint = 1.0f / scale; footprint >= 2.0f and index + 1 < Levels(); footprint *= 0.5f) {
+                    index += 1;
+                }
+
+                return index;
+            }
+
+
+        private:
+            static inline auto Downsample(
+                    const ConstCanvas & src,
+                    utility::AlignedPixelBuffer & dst) -> void {
+                for (auto y = 0; y < dst.Height(); y += 1) {
+                    const auto * row0 = src.RowUnchecked(2 * y);
+                    const auto * row1 = src.RowUnchecked(std::min(2 * y + 1, src.Height - 1));
+                    auto * out = dst.Data() + dst.Stride() * y;
+
+                    for (auto x = 0; x < dst.Width(); x += 1) {
+                        const auto x1 = std::min(2 * x + 1, src.Width - 1);
+                        const uint32_t texels[] = { row0[2 * x], row0[x1], row1[2 * x], row1[x1] };
+
+                        auto alpha = 0u;
+                        auto red = 0u;
+                        auto green = 0u;
+                        auto blue = 0u;
+
+                        for (const auto texel : texels) {
+                            const auto [r, g, b, a] = color::ToRGBA(texel);
+                            alpha += a;
+                            red += r * a;
+                            green += g * a;
+                            blue += b * a;
+                        }
+
+                        if (not alpha) {
+                            out[x] = 0;
+                            continue;
+                        }
+
+                        out[x] = color::FromRGBA(
+                                (red + alpha / 2) / alpha,
+                                (green + alpha / 2) / alpha,
+                                (blue + alpha / 2) / alpha,
+                                (alpha + 2) / 4
+                        );
+                    }
+                }
+            }
+        };
+
+
+        // Builds mip chains on first use and keeps them keyed by the source view. Chains are not rebuilt when the source
+        // pixels change; call Invalidate for sources that are redrawn.
+        class MipCache final {
+            std::vector<std::unique_ptr<MipChain>> chains;
+            std::mutex mutex;
+
+
+            [[nodiscard]]
+            static inline auto Matches(
+                    const ConstCanvas & a,
+                    const ConstCanvas & b) -> bool {
+                return a.Data == b.Data and a.Width == b.Width and a.Height == b.Height and a.Stride == b.Stride;
+            }
+        public:
+            [[nodiscard]]
+            inline auto Get(
+                    const ConstCanvas & src) -> const MipChain & {
+                auto lock = std::lock_guard(mutex);
+
+                for (const auto & chain : chains) {
+                    if (Matches(chain->Level(0), src)) {
+                        return *chain;
+                    }
+                }
+
+                chains.push_back(std::make_unique<MipChain>(src));
+                return *chains.back();
+            }
+
+
+            [[maybe_unused]]
+            inline auto Invalidate(
+                    const ConstCanvas & src) -> void {
+                auto lock = std::lock_guard(mutex);
+
+                chains.erase(
+                        std::remove_if(
+                                chains.begin(),
+                                chains.end(),
+                                [&](const auto & chain) { return Matches(chain->Level(0), src); }
+                        ),
+                        chains.end()
+                );
+            }
+
+
+            [[maybe_unused]]
+            inline auto Clear() -> void {
+                auto lock = std::lock_guard(mutex);
+                chains.clear();
+            }
+        };
+
+
+        // Same placement as the Transform overload on the chain's source, sampled from the level matching the scale.
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                const MipChain & mips,
+                Canvas & dst,
+                int x0 = 0,
+                int y0 = 0,
+                const Transform & tf = {},
+                const Blend & blend = {}) -> decltype(dst) {
+            const auto index = mips.LevelFor(tf.ScaleX, tf.ScaleY);
+            const auto & src = mips.Level(0);
+            if (not index) {
+                return Copy<Blend>(src, dst, x0, y0, tf, blend);
+            }
+
+            const auto & level = mips.Level(index);
+            const auto factor_x = static_cast<float>(src.Width) / static_cast<float>(level.Width);
+            const auto factor_y = static_cast<float>(src.Height) / static_cast<float>(level.Height);
+
+            if (0.0f == tf.RotationRadians and Sampling::Nearest == tf.Filter) {
+                const auto scale_x = FixedPoint{ tf.ScaleX };
+                const auto scale_y = FixedPoint{ tf.ScaleY };
+
+                return Copy<Blend>(
+                        level,
+                        dst,
+                        x0 - tf.OriginX * scale_x,
+                        y0 - tf.OriginY * scale_y,
+                        x0 + (src.Width - tf.OriginX) * scale_x,
+                        y0 + (src.Height - tf.OriginY) * scale_y,
+                        blend
+                );
+            }
+
+            // The pivot is the centre of source texel (OriginX, OriginY), which falls between the level's texels
+            return CopyAffine<Blend>(
+                    level,
+                    dst,
+                    x0, y0,
+                    MakeAffineMap(
+                            (tf.OriginX + 0.5) / factor_x - 0.5,
+                            (tf.OriginY + 0.5) / factor_y - 0.5,
+                            tf.RotationRadians,
+                            static_cast<float>(FixedPoint{ tf.ScaleX }) * factor_x,
+                            static_cast<float>(FixedPoint{ tf.ScaleY }) * factor_y
+                    ),
+                    blend,
+                    tf.Filter
+            );
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                MipCache & cache,
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0 = 0,
+                int y0 = 0,
+                const Transform & tf = {},
+                const Blend & blend = {}) -> decltype(dst) {
+            return Copy<Blend>(cache.Get(src), dst, x0, y0, tf, blend);
+        }
+
+
+        // One draw of a batch: the atlas region Source (the whole atlas when empty) placed like Copy(src, dst, X, Y, Tf).
+        struct Instance {
+            int X{ 0 };
+            int Y{ 0 };
+
+            Transform Tf{};
+
+            utility::Rect Source{};
+        };
+
+
+        // Per-instance setup computed once per batch and shared by every band the instance touches.
+        struct PreparedInstance {
+            ConstCanvas Source;
+            const Instance * Draw{ nullptr };
+            utility::Rect Bounds{};
+            bool Affine{ false };
+            AffineMap Map{};
+        };
+
+
+        constexpr auto BATCH_BAND_HEIGHT = 64;
+
+
+        [[nodiscard]]
+        inline auto PrepareBatch(
+                const ConstCanvas & atlas,
+                const Canvas & dst,
+                const std::vector<Instance> & instances) -> std::vector<PreparedInstance> {
+            const auto atlas_rect = utility::Rect{ 0, 0, atlas.Width, atlas.Height };
+            const auto dst_rect = dst.Bounds();
+
+            auto prepared = std::vector<PreparedInstance>();
+            prepared.reserve(instances.size());
+
+            auto rotation = 0.0f;
+            auto sin = 0.0;
+            auto cos = 1.0;
+
+            for (const auto & instance : instances) {
+                const auto rect = instance.Source.IsEmpty() ? atlas_rect : instance.Source.Intersection(atlas_rect);
+                if (rect.IsEmpty()) {
+                    continue;
+                }
+
+                const auto & tf = instance.Tf;
+                const auto source = atlas.View(rect.Left, rect.Top, rect.Width(), rect.Height());
+                const auto unscaled = 1.0f == tf.ScaleX and 1.0f == tf.ScaleY;
+                const auto affine = 0.0f != tf.RotationRadians or (Sampling::Bilinear == tf.Filter and not unscaled);
+
+                auto map = AffineMap{};
+                if (affine) {
+                    if (tf.RotationRadians != rotation) {
+                        rotation = tf.RotationRadians;
+                        sin = static_cast<double>(std::sin(rotation));
+                        cos = static_cast<double>(std::cos(rotation));
+                    }
+
+                    map = {
+                            static_cast<double>(tf.OriginX),
+                            static_cast<double>(tf.OriginY),
+                            sin,
+                            cos,
+                            static_cast<float>(FixedPoint{ tf.ScaleX }),
+                            static_cast<float>(FixedPoint{ tf.ScaleY })
+                    };
+                }
+
+                const auto bounds = (affine ? AffineBounds(source, instance.X, instance.Y, map)
+                                            : Bounds(source, instance.X, instance.Y, tf)).Intersection(dst_rect);
+                if (bounds.IsEmpty()) {
+                    continue;
+                }
+
+                prepared.push_back({ source, &instance, bounds, affine, map });
+            }
+
+            return prepared;
+        }
+
+
+        // Groups prepared instances by the bands of band_height rows they overlap, keeping submission order per band.
+        [[nodiscard]]
+        inline auto BinBatch(
+                const std::vector<PreparedInstance> & prepared,
+                int height,
+                int band_height) -> std::vector<std::vector<int>> {
+            const auto band_count = (height + band_height - 1) / band_height;
+            auto bins = std::vector<std::vector<int>>(band_count);
+
+            for (auto i = 0; i < static_cast<int>(prepared.size()); i += 1) {
+                const auto & bounds = prepared[i].Bounds;
+                const auto first = bounds.Top / band_height;
+                const auto last = (bounds.Bottom - 1) / band_height;
+
+                for (auto band = first; band <= last; band += 1) {
+                    bins[band].push_back(i);
+                }
+            }
+
+            return bins;
+        }
+
+
+        template<typename Blend>
+        inline auto DrawPrepared(
+                const PreparedInstance & instance,
+                Canvas & band,
+                int top,
+                const Blend & blend) -> void {
+            const auto & draw = *instance.Draw;
+
+            if (instance.Affine) {
+                CopyAffine<Blend>(instance.Source, band, draw.X, draw.Y - top, instance.Map, blend, draw.Tf.Filter);
+            }
+            else {
+                Copy<Blend>(instance.Source, band, draw.X, draw.Y - top, draw.Tf, blend);
+            }
+        }
+
+
+        // Draws every instance from one atlas, rasterized band by band so each band stays cache-resident while all
+        // the instances overlapping it are drawn. Instances still compose in submission order.
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto CopyBatch(
+                const ConstCanvas & atlas,
+                Canvas & dst,
+                const std::vector<Instance> & instances,
+                const Blend & blend = {}) -> decltype(dst) {
+            if (dst.Empty or atlas.Empty) {
+                return dst;
+            }
+
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::CopyBatch);
+
+            const auto prepared = PrepareBatch(atlas, dst, instances);
+            const auto bins = BinBatch(prepared, dst.Height, BATCH_BAND_HEIGHT);
+
+            for (auto index = 0; index < static_cast<int>(bins.size()); index += 1) {
+                if (bins[index].empty()) {
+                    continue;
+                }
+
+                const auto top = index * BATCH_BAND_HEIGHT;
+                auto band = dst.View(0, top, dst.Width, std::min(BATCH_BAND_HEIGHT, dst.Height - top));
+
+                for (const auto i : bins[index]) {
+                    DrawPrepared<Blend>(prepared[i], band, top, blend);
+                }
+            }
+
+            return dst;
+        }
+
+
+        // Copies the dirty areas of the background back into dst. The restored areas are not marked dirty again;
+        // whoever presents dst should take the union of this region and whatever is drawn afterwards.
+        [[maybe_unused]]
+        inline auto Restore(
+                const ConstCanvas & background,
+                Canvas & dst,
+                const utility::DirtyRegion & region) -> decltype(dst) {
+            const auto bounds = dst.Bounds().Intersection(background.Bounds());
+
+            for (const auto & dirty : region.Rects()) {
+                const auto rect = dirty.Intersection(bounds);
+                if (rect.IsEmpty()) {
+                    continue;
+                }
+
+                dst.CheckRect(rect);
+                background.CheckRect(rect);
+
+                for (auto y = rect.Top; y < rect.Bottom; y += 1) {
+                    color::BlendSpan<color::Overwrite>(
+                            dst.SpanUnchecked(rect.Left, y),
+                            background.RowUnchecked(y) + rect.Left,
+                            rect.Width()
+                    );
+                }
+            }
+
+            return dst;
+        }
+    }
+
+
+    namespace drawing {
+        // Bresenham steps a line along its major axis; after k steps the minor axis has moved
+        // n(k) = floor((2 * minor * k + major - 1) / (2 * major)) pixels. n is monotonic, so the steps that keep the
+        // minor coordinate within [0, minor_limit) form one range, and [begin, end) is narrowed to it exactly. n runs
+        // from 0 to minor, so low and high are clamped to that range before the products, which can exceed 64 bits.
+        inline auto ClipBresenham(
+                int64_t major,
+                int64_t minor,
+                int64_t minor_start,
+                int minor_direction,
+                int64_t minor_limit,
+                int64_t & begin,
+                int64_t & end) -> void {
+            const auto low = minor_direction > 0 ? -minor_start : minor_start - (minor_limit - 1);
+            const auto high = minor_direction > 0 ? minor_limit - 1 - minor_start : minor_start;
+
+            if (0 == minor) {
+                if (low > 0 or high < 0) {
+                    end = begin;
+                }
+                return;
+            }
+
+            if (low > minor or high < 0) {
+                end = begin;
+                return;
+            }
+
+            // ceil((2 * major * v - major + 1) / (2 * minor)) for v = low and v = high + 1, with v >= 1
+            const auto first_step = [&](int64_t v) {
+                return static_cast<int64_t>(utility::MulDiv(2 * major, v - 1, major + 2 * minor, 2 * minor).first);
+            };
+
+            if (low > 0) {
+                begin = std::max(begin, first_step(low));
+            }
+            if (high < minor) {
+                end = std::min(end, first_step(high + 1));
+            }
+        }
+
+
+        // Draws steps [begin, end) of the line from (x0, y0) to (x1, y1), clipped to the canvas, and returns the bounds
+        // of what it drew. Step 0 is (x0, y0) and the last step is (x1, y1).
+        template<typename Blend>
+        inline auto LineSteps(
+                Canvas & canvas,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                bool skip_first,
+                bool skip_last,
+                uint32_t color,
+                const Blend & blend) -> utility::Rect {
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::Line);
+
+            const auto dx = std::abs(static_cast<int64_t>(x1) - x0);
+            const auto dy = std::abs(static_cast<int64_t>(y1) - y0);
+            const auto xi = x1 >= x0 ? 1 : -1;
+            const auto yi = y1 >= y0 ? 1 : -1;
+
+            const auto x_major = dy < dx;
+            const auto major = x_major ? dx : dy;
+            const auto minor = x_major ? dy : dx;
+
+            auto begin = int64_t{ skip_first ? 1 : 0 };
+            auto end = major + (skip_last ? 0 : 1);
+
+            const auto clip_major = [&](int64_t start, int direction, int64_t limit) {
+                begin = std::max(begin, direction > 0 ? -start : start - limit + 1);
+                end = std::min(end, direction > 0 ? limit - start : start + 1);
+            };
+
+            // Both clips work relative to the near edge of the canvas bounds
+            const auto clip = canvas.Bounds();
+            if (x_major) {
+                clip_major(x0 - clip.Left, xi, clip.Width());
+                ClipBresenham(major, minor, y0 - clip.Top, yi, clip.Height(), begin, end);
+            }
+            else {
+                clip_major(y0 - clip.Top, yi, clip.Height());
+                ClipBresenham(major, minor, x0 - clip.Left, xi, clip.Width(), begin, end);
+            }
+
+            if (begin >= end) {
+                return {};
+            }
+
+            // n(k) of ClipBresenham and the remainder of its division, which sets the error term at step k
+            const auto divide = [&](int64_t k) {
+                return utility::MulDiv(2 * minor, k, major - 1, 2 * major);
+            };
+            const auto offset = [&](int64_t k) {
+                return 0 == major ? int64_t{ 0 } : static_cast<int64_t>(divide(k).first);
+            };
+
+            const auto point = [&](int64_t k) {
+                const auto along = x_major ? k : offset(k);
+                const auto across = x_major ? offset(k) : k;
+                return std::pair(static_cast<int>(x0 + xi * along), static_cast<int>(y0 + yi * across));
+            };
+
+            const auto[first_x, first_y] = point(begin);
+            const auto[last_x, last_y] = point(end - 1);
+            const auto count = static_cast<int>(end - begin);
+
+            const auto bounds = utility::Rect{
+                    std::min(first_x, last_x),
+                    std::min(first_y, last_y),
+                    std::max(first_x, last_x) + 1,
+                    std::max(first_y, last_y) + 1
+            };
+
+            stats::Visit(count);
+            canvas.CheckRect(bounds);
+
+            if (0 == minor and x_major) {
+                color::FillSpan<Blend>(canvas.SpanUnchecked(bounds.Left, first_y), color, count, blend);
+            }
+            else if (0 == minor) {
+                stats::Write(count);
+                auto * const column = canvas.SpanUnchecked(first_x, bounds.Top);
+                for (auto i = 0; i < count; i += 1) {
+                    auto & pixel = column[static_cast<ptrdiff_t>(canvas.Stride) * i];
+                    pixel = blend(color, pixel);
+                }
+            }
+            else {
+                stats::Write(count);
+
+                auto D = static_cast<int64_t>(divide(begin).second) + 2 * minor - 2 * major + 1;
+
+                // Steps through the pixel offsets from the first pixel directly; the clipped bounds were checked once
+                // above.
+                const auto stride = static_cast<ptrdiff_t>(canvas.Stride);
+                const auto major_step = x_major ? xi : yi * stride;
+                const auto minor_step = x_major ? yi * stride : xi;
+                auto * const first = canvas.SpanUnchecked(first_x, first_y);
+                auto index = ptrdiff_t{ 0 };
+
+                for (auto i = 0; i < count; i += 1) {
+                    first[index] = blend(color, first[index]);
+
+                    index += major_step;
+                    if (D > 0) {
+                        index += minor_step;
+                        D += 2 * (minor - major);
+                    }
+                    else {
+                        D += 2 * minor;
+                    }
+                }
+            }
+
+            return bounds;
+        }
+
+
+        // Whether LineSteps should run from (x1, y1) instead, so a line is stepped from the end with the smaller major
+        // coordinate whichever way it was given. Taken in 64 bits, as LineSteps does, for endpoints far off the canvas.
+        inline auto IsReversedLine(
+                int x0,
+                int y0,
+                int x1,
+                int y1) -> bool {
+            const auto dx = std::abs(static_cast<int64_t>(x1) - x0);
+            const auto dy = std::abs(static_cast<int64_t>(y1) - y0);
+
+            return dy < dx ? x0 > x1 : y0 > y1;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Line(
+                Canvas & canvas,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            const auto reversed = IsReversedLine(x0, y0, x1, y1);
+            const auto dirty = reversed
+                               ? LineSteps<Blend>(canvas, x1, y1, x0, y0, false, false, color, blend)
+                               : LineSteps<Blend>(canvas, x0, y0, x1, y1, false, false, color, blend);
+
+            canvas.MarkDirty(dirty);
+
+            return canvas;
+        }
+
+
+        // Connected line segments; each vertex where two segments meet is drawn once. A closed polyline also joins the
+        // last vertex back to the first.
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Polyline(
+                Canvas & canvas,
+                const std::vector<std::pair<int, int>> & vertices,
+                uint32_t color,
+                bool closed = false,
+                const Blend & blend = {}) -> decltype(canvas) {
+            if (vertices.empty()) {
+                return canvas;
+            }
+
+            const auto count = vertices.size();
+            const auto segments = closed and count > 2 ? count : count - 1;
+
+            if (0 == segments) {
+                const auto[x, y] = vertices.front();
+                return Line<Blend>(canvas, x, y, x, y, color, blend);
+            }
+
+            auto dirty = utility::Rect{};
+
+            for (auto i = decltype(count){ 0 }; i < segments; i += 1) {
+                const auto[x0, y0] = vertices[i];
+                const auto[x1, y1] = vertices[(i + 1) % count];
+
+                auto skip_first = i > 0;
+                auto skip_last = closed and count > 2 and i + 1 == segments;
+
+                const auto reversed = IsReversedLine(x0, y0, x1, y1);
+                if (reversed) {
+                    std::swap(skip_first, skip_last);
+                }
+
+                dirty = dirty.Union(
+                        reversed
+                        ? LineSteps<Blend>(canvas, x1, y1, x0, y0, skip_first, skip_last, color, blend)
+                        : LineSteps<Blend>(canvas, x0, y0, x1, y1, skip_first, skip_last, color, blend)
+                );
+            }
+
+            canvas.MarkDirty(dirty);
+
+            return canvas;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Polygon(
+                Canvas & canvas,
+                const std::vector<std::pair<int, int>> & vertices,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            return Polyline<Blend>(canvas, vertices, color, true, blend);
+        }
+
+
+        enum class FillRule : uint8_t {
+            EvenOdd,
+            NonZero
+        };
+
+
+        // A non-horizontal polygon edge in an active edge table. Its crossing with scanline y is tracked exactly as
+        // Q + R / D (0 <= R < D) so that ceil(Q + R / D) is the first pixel whose center lies right of the edge.
+        struct ScanEdge {
+            int Bottom{ 0 };
+            int Winding{ 0 };
+
+            int64_t Q{ 0 };
+            int64_t R{ 0 };
+            int64_t StepQ{ 0 };
+            int64_t StepR{ 0 };
+            int64_t D{ 1 };
+
+
+            [[nodiscard]]
+            inline auto X() const -> int64_t {
+                return Q + (R > 0);
+            }
+
+
+            inline auto Start(
+                    int y,
+                    int x0,
+                    int y0,
+                    int x1,
+                    int y1) -> void {
+                const auto dx = static_cast<int64_t>(x1) - x0;
+                const auto dy = static_cast<int64_t>(y1) - y0;
+                const auto numerator = (2 * static_cast<int64_t>(x0) - 1) * dy + (2 * (static_cast<int64_t>(y) - y0) + 1) * dx;
+
+                D = 2 * dy;
+                Q = utility::FloorDiv(numerator, D);
+                R = numerator - Q * D;
+                StepQ = utility::FloorDiv(2 * dx, D);
+                StepR = 2 * dx - StepQ * D;
+            }
+
+
+            inline auto Advance() -> void {
+                Q += StepQ;
+                R += StepR;
+
+                if (R >= D) {
+                    R -= D;
+                    Q += 1;
+                }
+            }
+        };
+
+
+        // Edges as (top y, top x, bottom y, bottom x, winding); sorting orders them by where they enter the scan.
+        using EdgeTable = std::vector<std::tuple<int, int, int, int, int>>;
+
+
+        inline auto AddContourEdges(
+                EdgeTable & table,
+                const std::vector<std::pair<int, int>> & vertices) -> void {
+            for (auto i = size_t{ 0 }; i < vertices.size(); i += 1) {
+                const auto[x0, y0] = vertices[i];
+                const auto[x1, y1] = vertices[(i + 1) % vertices.size()];
+
+                if (y0 < y1) {
+                    table.emplace_back(y0, x0, y1, x1, 1);
+                }
+                else if (y1 < y0) {
+                    table.emplace_back(y1, x1, y0, x0, -1);
+                }
+            }
+        }
+
+
+        // Scanline fill with an active edge list. A pixel is covered when its center is inside under the fill rule;
+        // each covered run of a row is written exactly once.
+        template<typename Blend>
+        inline auto FillEdgeTable(
+                Canvas & canvas,
+                EdgeTable & table,
+                FillRule rule,
+                uint32_t color,
+                const Blend & blend) -> decltype(canvas) {
+            if (table.empty() or canvas.Empty) {
+                return canvas;
+            }
+
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::FillPolygon);
+
+            std::sort(table.begin(), table.end());
+
+            const auto clip = canvas.Bounds();
+
+            const auto start_y = std::max(std::get<0>(table.front()), clip.Top);
+            auto end_y = clip.Top;
+            for (const auto & edge : table) {
+                end_y = std::max(end_y, std::get<2>(edge));
+            }
+            end_y = std::min(end_y, clip.Bottom);
+
+            if constexpr (stats::ENABLED) {
+                auto left = clip.Right;
+                auto right = clip.Left;
+                for (const auto & edge : table) {
+                    left = std::min({ left, std::get<1>(edge), std::get<3>(edge) });
+                    right = std::max({ right, std::get<1>(edge), std::get<3>(edge) });
+                }
+                stats::Visit({ std::max(left, clip.Left), start_y, std::min(right, clip.Right), end_y });
+            }
+
+            canvas.CheckRect({ clip.Left, start_y, clip.Right, end_y });
+
+            thread_local auto active = std::vector<ScanEdge>();
+            active.clear();
+
+            auto next = size_t{ 0 };
+            auto dirty = utility::Rect{};
+
+            for (auto y = start_y; y < end_y; y += 1) {
+                active.erase(
+                        std::remove_if(active.begin(), active.end(), [&](const ScanEdge & edge) { return edge.Bottom <= y; }),
+                        active.end()
+                );
+
+                for (; next < table.size() and std::get<0>(table[next]) <= y; next += 1) {
+                    const auto[top, x0, bottom, x1, winding] = table[next];
+                    if (bottom <= y) {
+                        continue;
+                    }
+
+                    auto edge = ScanEdge{ bottom, winding };
+                    edge.Start(y, x0, top, x1, bottom);
+                    active.push_back(edge);
+                }
+
+                for (auto i = size_t{ 1 }; i < active.size(); i += 1) {
+                    for (auto j = i; j > 0 and active[j].X() < active[j - 1].X(); j -= 1) {
+                        std::swap(active[j], active[j - 1]);
+                    }
+                }
+
+                auto winding = 0;
+                auto span_begin = int64_t{ 0 };
+
+                for (const auto & edge : active) {
+                    const auto was_inside = FillRule::EvenOdd == rule ? (winding & 1) != 0 : winding != 0;
+                    winding += FillRule::EvenOdd == rule ? 1 : edge.Winding;
+                    const auto is_inside = FillRule::EvenOdd == rule ? (winding & 1) != 0 : winding != 0;
+
+                    if (is_inside and not was_inside) {
+                        span_begin = edge.X();
+                    }
+                    else if (was_inside and not is_inside) {
+                        const auto begin = static_cast<int>(std::clamp<int64_t>(span_begin, clip.Left, clip.Right));
+                        const auto end = static_cast<int>(std::clamp<int64_t>(edge.X(), clip.Left, clip.Right));
+
+                        if (begin < end) {
+                            color::FillSpan<Blend>(canvas.SpanUnchecked(begin, y), color, end - begin, blend);
+                            dirty = dirty.Union({ begin, y, end, y + 1 });
+                        }
+                    }
+                }
+
+                for (auto & edge : active) {
+                    edge.Advance();
+                }
+            }
+
+            canvas.MarkDirty(dirty);
+
+            return canvas;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto FillPolygon(
+                Canvas & canvas,
+                const std::vector<std::pair<int, int>> & vertices,
+                uint32_t color,
+                FillRule rule = FillRule::NonZero,
+                const Blend & blend = {}) -> decltype(canvas) {
+            thread_local auto table = EdgeTable();
+            table.clear();
+
+            AddContourEdges(table, vertices);
+
+            return FillEdgeTable<Blend>(canvas, table, rule, color, blend);
+        }
+
+
+        // Fills several contours as one shape, so holes can be cut with the even-odd rule or opposite winding.
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto FillPolygon(
+                Canvas & canvas,
+                const std::vector<std::vector<std::pair<int, int>>> & contours,
+                uint32_t color,
+                FillRule rule = FillRule::NonZero,
+                const Blend & blend = {}) -> decltype(canvas) {
+            thread_local auto table = EdgeTable();
+            table.clear();
+
+            for (const auto & contour : contours) {
+                AddContourEdges(table, contour);
+            }
+
+            return FillEdgeTable<Blend>(canvas, table, rule, color, blend);
+        }
+
+
+        constexpr auto RASTER_BLOCK = 8;
+
+
+        // Half-space test of one triangle edge at pixel centers: E(x, y) = A * x + B * y + C is non-negative exactly
+        // for covered pixels. C carries the top-left rule, so pixels on a shared edge belong to one triangle only.
+        struct RasterEdge {
+            int64_t A{ 0 };
+            int64_t B{ 0 };
+            int64_t C{ 0 };
+
+
+            RasterEdge(
+                    int ax,
+                    int ay,
+                    int bx,
+                    int by) {
+                const auto dx = static_cast<int64_t>(bx) - ax;
+                const auto dy = static_cast<int64_t>(by) - ay;
+
+                A = 2 * dy;
+                B = -2 * dx;
+                C = (1 - 2 * static_cast<int64_t>(ax)) * dy - (1 - 2 * static_cast<int64_t>(ay)) * dx;
+
+                const auto top_left = A > 0 or (0 == A and B > 0);
+                if (not top_left) {
+                    C -= 1;
+                }
+            }
+
+
+            [[nodiscard]]
+            inline auto At(
+                    int x,
+                    int y) const -> int64_t {
+                return A * x + B * y + C;
+            }
+        };
+
+
+        // Bit i is set when pixel (x + i, y) passes the edge, for i < count.
+        [[nodiscard]]
+        inline auto RasterEdgeMask(
+                const RasterEdge & edge,
+                int64_t value,
+                int count,
+                [[maybe_unused]] bool narrow) -> uint32_t {
+            auto mask = 0u;
+            auto i = 0;
+
+#if defined(CHERRY_SIMD_SSE2)
+            if (narrow) {
+                const auto a = static_cast<int32_t>(edge.A);
+                const auto base = _mm_set1_epi32(static_cast<int32_t>(value));
+                const auto minus_one = _mm_set1_epi32(-1);
+
+                const auto lo = _mm_add_epi32(base, _mm_set_epi32(3 * a, 2 * a, a, 0));
+                const auto hi = _mm_add_epi32(base, _mm_set_epi32(7 * a, 6 * a, 5 * a, 4 * a));
+
+                mask = static_cast<uint32_t>(
+                        _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(lo, minus_one)))
+                        | (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(hi, minus_one))) << 4));
+                i = RASTER_BLOCK;
+            }
+#elif defined(CHERRY_SIMD_NEON)
+            if (narrow) {
+                const auto a = static_cast<int32_t>(edge.A);
+                const auto base = vdupq_n_s32(static_cast<int32_t>(value));
+                const int32_t lo_steps[] = { 0, a, 2 * a, 3 * a };
+                const int32_t hi_steps[] = { 4 * a, 5 * a, 6 * a, 7 * a };
+                const uint32_t lo_bits[] = { 1, 2, 4, 8 };
+                const uint32_t hi_bits[] = { 16, 32, 64, 128 };
+
+                const auto bits = vorrq_u32(
+                        vandq_u32(vcgeq_s32(vaddq_s32(base, vld1q_s32(lo_steps)), vdupq_n_s32(0)), vld1q_u32(lo_bits)),
+                        vandq_u32(vcgeq_s32(vaddq_s32(base, vld1q_s32(hi_steps)), vdupq_n_s32(0)), vld1q_u32(hi_bits)));
+                const auto pairs = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+                mask = vget_lane_u32(vpadd_u32(pairs, pairs), 0);
+                i = RASTER_BLOCK;
+            }
+#endif
+            for (; i < count; i += 1) {
+                if (value + edge.A * i >= 0) {
+                    mask |= 1u << i;
+                }
+            }
+
+            return mask & ((1u << count) - 1);
+        }
+
+
+        // Edge-function rasterizer: walks RASTER_BLOCK-sized blocks of the clipped bounding box, skips blocks outside
+        // any edge, accepts blocks inside all edges whole and tests only the edges crossing the rest. A pixel is covered
+        // when its center is inside the triangle, with the top-left rule on edges. Vertices must lie within +-2^29.
+        // Calls span(y, begin, end) for every covered row within clip and returns their bounds.
+        template<typename SpanFn>
+        inline auto ScanTriangle(
+                const utility::Rect & clip,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                int x2,
+                int y2,
+                SpanFn && span) -> utility::Rect {
+            const auto cross =
+                    (static_cast<int64_t>(x1) - x0) * (static_cast<int64_t>(y2) - y0)
+                    - (static_cast<int64_t>(y1) - y0) * (static_cast<int64_t>(x2) - x0);
+            if (0 == cross) {
+                return {};
+            }
+
+            if (cross > 0) {
+                std::swap(x1, x2);
+                std::swap(y1, y2);
+            }
+
+            const RasterEdge edges[] = {
+                    { x0, y0, x1, y1 },
+                    { x1, y1, x2, y2 },
+                    { x2, y2, x0, y0 }
+            };
+
+            const auto start_x = std::max(std::min({ x0, x1, x2 }), clip.Left);
+            const auto end_x = std::min(std::max({ x0, x1, x2 }), clip.Right);
+            const auto start_y = std::max(std::min({ y0, y1, y2 }), clip.Top);
+            const auto end_y = std::min(std::max({ y0, y1, y2 }), clip.Bottom);
+
+            if (start_x >= end_x or start_y >= end_y) {
+                return {};
+            }
+
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::FillTriangle);
+            stats::Visit({ start_x, start_y, end_x, end_y });
+
+            constexpr auto narrow_limit = int64_t{ 1 } << 27;
+            const auto narrow = std::all_of(std::begin(edges), std::end(edges), [&](const RasterEdge & edge) {
+                return std::abs(edge.A) + std::abs(edge.B) < narrow_limit;
+            });
+
+            auto dirty = utility::Rect{};
+
+            for (auto block_y = start_y; block_y < end_y; block_y += RASTER_BLOCK) {
+                const auto rows = std::min(RASTER_BLOCK, end_y - block_y);
+
+                int span_start[RASTER_BLOCK];
+                int span_end[RASTER_BLOCK];
+                std::fill_n(span_start, rows, end_x);
+                std::fill_n(span_end, rows, start_x);
+
+                for (auto block_x = start_x; block_x < end_x; block_x += RASTER_BLOCK) {
+                    const auto columns = std::min(RASTER_BLOCK, end_x - block_x);
+
+                    int64_t corner[3];
+                    bool crossing[3];
+                    auto rejected = false;
+
+                    for (auto k = 0; k < 3; k += 1) {
+                        const auto & edge = edges[k];
+                        const auto step_x = edge.A * (columns - 1);
+                        const auto step_y = edge.B * (rows - 1);
+
+                        corner[k] = edge.At(block_x, block_y);
+                        const auto low = corner[k] + std::min<int64_t>(step_x, 0) + std::min<int64_t>(step_y, 0);
+                        const auto high = corner[k] + std::max<int64_t>(step_x, 0) + std::max<int64_t>(step_y, 0);
+
+                        rejected = rejected or high < 0;
+                        crossing[k] = low < 0;
+                    }
+
+                    if (rejected) {
+                        continue;
+                    }
+
+                    for (auto row = 0; row < rows; row += 1) {
+                        auto mask = (1u << columns) - 1;
+
+                        for (auto k = 0; k < 3 and mask; k += 1) {
+                            if (crossing[k]) {
+                                mask &= RasterEdgeMask(edges[k], corner[k] + edges[k].B * row, columns, narrow);
+                            }
+                        }
+
+                        if (not mask) {
+                            continue;
+                        }
+
+                        auto first = 0;
+                        while (not (mask & (1u << first))) {
+                            first += 1;
+                        }
+                        auto last = columns - 1;
+                        while (not (mask & (1u << last))) {
+                            last -= 1;
+                        }
+
+                        span_start[row] = std::min(span_start[row], block_x + first);
+                        span_end[row] = std::max(span_end[row], block_x + last + 1);
+                    }
+                }
+
+                for (auto row = 0; row < rows; row += 1) {
+                    if (span_start[row] < span_end[row]) {
+                        const auto y = block_y + row;
+                        span(y, span_start[row], span_end[row]);
+                        dirty = dirty.Union({ span_start[row], y, span_end[row], y + 1 });
+                    }
+                }
+            }
+
+            return dirty;
+        }
+
+
+        // Fills the triangle and returns the bounds of what it touched without marking them dirty.
+        template<typename Blend>
+        inline auto FillTriangleSpans(
+                Canvas & canvas,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                int x2,
+                int y2,
+                uint32_t color,
+                const Blend & blend) -> utility::Rect {
+            return ScanTriangle(canvas.Bounds(), x0, y0, x1, y1, x2, y2, [&](int y, int begin, int end) {
+                canvas.CheckSpan(begin, y, end - begin);
+                color::FillSpan<Blend>(canvas.SpanUnchecked(begin, y), color, end - begin, blend);
+            });
+        }
+
+
+        // As FillTriangleSpans, with each channel interpolated linearly between the vertex colors at pixel centers.
+        template<typename Blend>
+        inline auto ShadeTriangleSpans(
+                Canvas & canvas,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                int x2,
+                int y2,
+                uint32_t color0,
+                uint32_t color1,
+                uint32_t color2,
+                const Blend & blend) -> utility::Rect {
+            const auto cross =
+                    (static_cast<double>(x1) - x0) * (static_cast<double>(y2) - y0)
+                    - (static_cast<double>(y1) - y0) * (static_cast<double>(x2) - x0);
+            if (0.0 == cross) {
+                return {};
+            }
+
+            constexpr uint32_t shifts[] = { color::SHIFT_RED, color::SHIFT_GREEN, color::SHIFT_BLUE, color::SHIFT_ALPHA };
+            constexpr auto one = static_cast<double>(1 << 16);
+
+            // 16.16 planes relative to the first vertex, so the result does not depend on where the target starts.
+            int64_t base[4];
+            int64_t step_x[4];
+            int64_t step_y[4];
+
+            for (auto k = 0; k < 4; k += 1) {
+                const auto c0 = static_cast<double>((color0 >> shifts[k]) & 0xFF);
+                const auto d1 = static_cast<double>((color1 >> shifts[k]) & 0xFF) - c0;
+                const auto d2 = static_cast<double>((color2 >> shifts[k]) & 0xFF) - c0;
+
+                const auto dx = (d1 * (y2 - y0) - d2 * (y1 - y0)) / cross;
+                const auto dy = (d2 * (x1 - x0) - d1 * (x2 - x0)) / cross;
+
+                base[k] = std::llround(one * (c0 + 0.5 * dx + 0.5 * dy + 0.5));
+                step_x[k] = std::llround(one * dx);
+                step_y[k] = std::llround(one * dy);
+            }
+
+            return ScanTriangle(canvas.Bounds(), x0, y0, x1, y1, x2, y2, [&](int y, int begin, int end) {
+                int64_t value[4];
+                for (auto k = 0; k < 4; k += 1) {
+                    value[k] = base[k] + step_x[k] * (begin - x0) + step_y[k] * (y - y0);
+                }
+
+                canvas.CheckSpan(begin, y, end - begin);
+                color::BlendSampled<Blend>(canvas.SpanUnchecked(begin, y), end - begin, [&](int) {
+                    auto pixel = 0u;
+                    for (auto k = 0; k < 4; k += 1) {
+                        pixel |= static_cast<uint32_t>(std::clamp<int64_t>(value[k] >> 16, 0, 255)) << shifts[k];
+                        value[k] += step_x[k];
+                    }
+                    return pixel;
+                }, blend);
+            });
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto RasterizeTriangle(
+                Canvas & canvas,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                int x2,
+                int y2,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            canvas.MarkDirty(FillTriangleSpans<Blend>(canvas, x0, y0, x1, y1, x2, y2, color, blend));
+
+            return canvas;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto ShadeTriangle(
+                Canvas & canvas,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                int x2,
+                int y2,
+                uint32_t color0,
+                uint32_t color1,
+                uint32_t color2,
+                const Blend & blend = {}) -> decltype(canvas) {
+            canvas.MarkDirty(ShadeTriangleSpans<Blend>(canvas, x0, y0, x1, y1, x2, y2, color0, color1, color2, blend));
+
+            return canvas;
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto FillTriangle(
+                Canvas & canvas,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                int x2,
+                int y2,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            return RasterizeTriangle<Blend>(canvas, x0, y0, x1, y1, x2, y2, color, blend);
+        }
+
+
+        enum class MeshColoring : uint8_t {
+            PerTriangle,
+            PerVertex
+        };
+
+
+        // An indexed triangle list: every three Indices name the vertices of one triangle. Colors holds one entry per
+        // triangle or one per vertex, depending on Coloring.
+        struct Mesh {
+            std::vector<std::pair<int, int>> Vertices;
+            std::vector<int> Indices;
+            std::vector<uint32_t> Colors;
+            MeshColoring Coloring{ MeshColoring::PerTriangle };
+        };
+
+
+        [[nodiscard]]
+        [[maybe_unused]]
+        inline auto MeshBounds(
+                const Mesh & mesh,
+                int x0 = 0,
+                int y0 = 0) -> utility::Rect {
+            auto bounds = utility::Rect{};
+            for (const auto &[x, y] : mesh.Vertices) {
+                bounds = bounds.Union({ x0 + x, y0 + y, x0 + x + 1, y0 + y + 1 });
+            }
+
+            return bounds;
+        }
+
+
+        // Draws the mesh translated by (x0, y0). Vertices are translated and classified against the canvas once, so
+        // triangles that are degenerate or lie entirely beyond one canvas edge are dropped before any edge setup.
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto DrawMesh(
+                Canvas & canvas,
+                const Mesh & mesh,
+                int x0 = 0,
+                int y0 = 0,
+                const Blend & blend = {}) -> decltype(canvas) {
+            enum : uint8_t {
+                OUT_LEFT = 1,
+                OUT_RIGHT = 2,
+                OUT_TOP = 4,
+                OUT_BOTTOM = 8
+            };
+
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::Mesh);
+
+            thread_local auto points = std::vector<std::pair<int, int>>();
+            thread_local auto outcodes = std::vector<uint8_t>();
+
+            points.resize(mesh.Vertices.size());
+            outcodes.resize(mesh.Vertices.size());
+
+            const auto clip = canvas.Bounds();
+
+            for (auto i = size_t{ 0 }; i < mesh.Vertices.size(); i += 1) {
+                const auto x = x0 + mesh.Vertices[i].first;
+                const auto y = y0 + mesh.Vertices[i].second;
+
+                points[i] = { x, y };
+                outcodes[i] = static_cast<uint8_t>(
+                        (x <= clip.Left ? OUT_LEFT : 0)
+                        | (x >= clip.Right ? OUT_RIGHT : 0)
+                        | (y <= clip.Top ? OUT_TOP : 0)
+                        | (y >= clip.Bottom ? OUT_BOTTOM : 0));
+            }
+
+            const auto triangle_count = static_cast<int>(mesh.Indices.size() / 3);
+
+#ifdef CHERRY_CHECK_BOUNDS
+            const auto color_count = MeshColoring::PerVertex == mesh.Coloring ? mesh.Vertices.size() : triangle_count;
+            if (mesh.Colors.size() < static_cast<size_t>(color_count)) {
+                throw std::out_of_range("Mesh has " + std::to_string(mesh.Colors.size()) + " colors, needs "
+                                        + std::to_string(color_count));
+            }
+            for (const auto index : mesh.Indices) {
+                if (index < 0 or static_cast<size_t>(index) >= mesh.Vertices.size()) {
+                    throw std::out_of_range("Mesh index " + std::to_string(index) + " is out of range");
+                }
+            }
+#endif
+
+            auto dirty = utility::Rect{};
+
+            for (auto t = 0; t < triangle_count; t += 1) {
+                const auto a = mesh.Indices[3 * t];
+                const auto b = mesh.Indices[3 * t + 1];
+                const auto c = mesh.Indices[3 * t + 2];
+
+                if (outcodes[a] & outcodes[b] & outcodes[c]) {
+                    continue;
+                }
+
+                const auto &[ax, ay] = points[a];
+                const auto &[bx, by] = points[b];
+                const auto &[cx, cy] = points[c];
+
+                if (MeshColoring::PerTriangle == mesh.Coloring) {
+                    dirty = dirty.Union(FillTriangleSpans<Blend>(canvas, ax, ay, bx, by, cx, cy, mesh.Colors[t], blend));
+                    continue;
+                }
+
+                const auto & colors = mesh.Colors;
+                if (colors[a] == colors[b] and colors[b] == colors[c]) {
+                    dirty = dirty.Union(FillTriangleSpans<Blend>(canvas, ax, ay, bx, by, cx, cy, colors[a], blend));
+                    continue;
+                }
+
+                dirty = dirty.Union(
+                        ShadeTriangleSpans<Blend>(canvas, ax, ay, bx, by, cx, cy, colors[a], colors[b], colors[c], blend)
+                );
+            }
+
+            canvas.MarkDirty(dirty);
+
+            return canvas;
+        }
+
+
+        // The antialiased primitives rasterize on a fixed-point grid of 1 / SUBPIXEL_ONE pixel. Snapping happens once
+        // against the coordinates' own origin, so a command replayed at an integer offset or clipped to any tile sees
+        // the same geometry and rounds every pixel the same way.
+        constexpr auto SUBPIXEL_DIGITS = 8;
+        constexpr auto SUBPIXEL_ONE = int64_t{ 1 } << SUBPIXEL_DIGITS;
+
+        // Past this many pixels a float has no subpixel precision left, and the products below stay within 64 bits.
+        constexpr auto SUBPIXEL_LIMIT = 1 << 21;
+
+
+        [[nodiscard]]
+        inline auto ToSubpixel(
+                float value,
+                int origin = 0) -> int64_t {
+            constexpr auto limit = static_cast<float>(SUBPIXEL_LIMIT);
+            const auto clamped = value < limit ? (value > -limit ? value : -limit) : limit;
+
+            return std::llround(clamped * static_cast<float>(SUBPIXEL_ONE)) - SUBPIXEL_ONE * origin;
+        }
+
+
+        // Xiaolin Wu's antialiased line between endpoints in subpixels, with pixel centers at integer + 0.5 as in the
+        // coverage fills below. Each pixel's coverage scales the alpha of color before it is blended. The minor
+        // position of every step is derived exactly from its index, so the clip window never changes its rounding.
+        template<typename Blend = color::FastAlphaBlend>
+        [[maybe_unused]]
+        inline auto SubpixelLineAA(
+                Canvas & canvas,
+                int64_t x0,
+                int64_t y0,
+                int64_t x1,
+                int64_t y1,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::LineAA);
+
+            constexpr auto ONE = SUBPIXEL_ONE;
+            constexpr auto HALF = SUBPIXEL_ONE / 2;
+
+            x0 -= HALF;
+            y0 -= HALF;
+            x1 -= HALF;
+            y1 -= HALF;
+
+            const auto steep = std::abs(y1 - y0) > std::abs(x1 - x0);
+            if (steep) {
+                std::swap(x0, y0);
+                std::swap(x1, y1);
+            }
+            if (x0 > x1) {
+                std::swap(x0, x1);
+                std::swap(y0, y1);
+            }
+
+            const auto bounds = canvas.Bounds();
+            const auto major_low = steep ? bounds.Top : bounds.Left;
+            const auto major_limit = steep ? bounds.Bottom : bounds.Right;
+            const auto minor_low = steep ? bounds.Left : bounds.Top;
+            const auto minor_limit = steep ? bounds.Right : bounds.Bottom;
+
+            const auto dx = x1 - x0;
+            const auto dy = y1 - y0;
+
+            auto dirty = utility::Rect{};
+
+            // coverage is in units of ONE * ONE
+            const auto plot = [&](int64_t major, int64_t minor, int64_t coverage) {
+                if (major < major_low or major >= major_limit or minor < minor_low or minor >= minor_limit) {
+                    return;
+                }
+
+                const auto alpha = static_cast<uint32_t>((255 * coverage + ONE * ONE / 2) >> (2 * SUBPIXEL_DIGITS));
+                if (not alpha) {
+                    return;
+                }
+
+                const auto x = static_cast<int>(steep ? minor : major);
+                const auto y = static_cast<int>(steep ? major : minor);
+                auto & pixel = *canvas.SpanUnchecked(x, y);
+
+                stats::Write(1);
+                pixel = blend(color::ScaleAlpha(color, alpha), pixel);
+                dirty = dirty.Union({ x, y, x + 1, y + 1 });
+            };
+
+            // Splits weight, in [0, ONE], between the two pixels straddling the minor position.
+            const auto split = [&](int64_t major, int64_t minor, int64_t weight) {
+                const auto minor_floor = utility::FloorDiv(minor, ONE);
+                const auto fraction = minor - ONE * minor_floor;
+
+                plot(major, minor_floor, (ONE - fraction) * weight);
+                plot(major, minor_floor + 1, fraction * weight);
+            };
+
+            const auto minor_at = [&](int64_t major) {
+                return 0 == dx ? y0 : y0 + utility::FloorDiv((ONE * major - x0) * dy, dx);
+            };
+
+            // Endpoint caps are weighted by how much of their pixel column the segment actually spans.
+            const auto first = utility::FloorDiv(x0 + HALF, ONE);
+            const auto last = utility::FloorDiv(x1 + HALF, ONE);
+
+            split(first, minor_at(first), ONE - (x0 + HALF - ONE * first));
+            split(last, minor_at(last), x1 + HALF - ONE * last);
+
+            auto begin = std::max<int64_t>(first + 1, major_low);
+            auto end = std::min<int64_t>(last, major_limit);
+
+            // Restrict the interior to where the minor pixel can land in [minor_low - 1, minor_limit). This only
+            // bounds the loop, so it may be loose: each step below is still computed exactly.
+            if (begin < end and 0 != dy) {
+                const auto crossing = [&](int64_t minor) {
+                    return (static_cast<double>(x0)
+                            + static_cast<double>(ONE * minor - y0) * static_cast<double>(dx) / static_cast<double>(dy))
+                           / static_cast<double>(ONE);
+                };
+
+                const auto enter = crossing(minor_low - 1);
+                const auto leave = crossing(minor_limit);
+                const auto low = std::floor(std::min(enter, leave)) - 1.0;
+                const auto high = std::ceil(std::max(enter, leave)) + 1.0;
+
+                begin = static_cast<int64_t>(std::clamp(low, static_cast<double>(begin), static_cast<double>(end)));
+                end = static_cast<int64_t>(std::clamp(high, static_cast<double>(begin), static_cast<double>(end)));
+            }
+            else if (begin < end) {
+                const auto row = utility::FloorDiv(y0, ONE);
+                if (row < minor_low - 1 or row >= minor_limit) {
+                    end = begin;
+                }
+            }
+
+            stats::Visit(2 * (std::max<int64_t>(end - begin, 0) + 2));
+
+            if (begin < end) {
+                // minor = y0 + quotient, stepped exactly: remainder stays in [0, dx)
+                const auto numerator = (ONE * begin - x0) * dy;
+                auto quotient = utility::FloorDiv(numerator, dx);
+                auto remainder = numerator - quotient * dx;
+
+                const auto step_quotient = utility::FloorDiv(ONE * dy, dx);
+                const auto step_remainder = ONE * dy - step_quotient * dx;
+
+                for (auto major = begin; major < end; major += 1) {
+                    split(major, y0 + quotient, ONE);
+
+                    quotient += step_quotient;
+                    remainder += step_remainder;
+                    if (remainder >= dx) {
+                        remainder -= dx;
+                        quotient += 1;
+                    }
+                }
+            }
+
+            canvas.MarkDirty(dirty);
+
+            return canvas;
+        }
+
+
+        template<typename Blend = color::FastAlphaBlend>
+        [[maybe_unused]]
+        inline auto LineAA(
+                Canvas & canvas,
+                float x0,
+                float y0,
+                float x1,
+                float y1,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            return SubpixelLineAA<Blend>(
+                    canvas, ToSubpixel(x0), ToSubpixel(y0), ToSubpixel(x1), ToSubpixel(y1), color, blend
+            );
+        }
+
+
+        template<typename Blend = color::FastAlphaBlend>
+        [[maybe_unused]]
+        inline auto PolylineAA(
+                Canvas & canvas,
+                const std::vector<std::pair<float, float>> & vertices,
+                uint32_t color,
+                bool closed = false,
+                const Blend & blend = {}) -> decltype(canvas) {
+            const auto count = vertices.size();
+            const auto segments = closed and count > 2 ? count : (count > 0 ? count - 1 : 0);
+
+            for (auto i = decltype(count){ 0 }; i < segments; i += 1) {
+                const auto[x0, y0] = vertices[i];
+                const auto[x1, y1] = vertices[(i + 1) % count];
+
+                LineAA<Blend>(canvas, x0, y0, x1, y1, color, blend);
+            }
+
+            return canvas;
+        }
+
+
+        // Signed-area coverage accumulation in the style of font-rs: every edge deposits the area it sweeps in each
+        // cell, and a running sum along a row turns those deltas into exact coverage for any mix of closed contours.
+        // Areas are integers in units of 1 / FULL of a pixel, taken from trapezoids whose corners are derived from the
+        // unclipped edge, so a pixel's coverage does not depend on where the buffer starts or ends. Each row has two
+        // spare cells so edges touching the right border never spill into the next row. Coverage is exact wherever the
+        // winding keeps one sign within a pixel; pixels on a self-intersection are approximated.
+        class CoverageBuffer final {
+            static constexpr auto ONE = SUBPIXEL_ONE;
+            static constexpr auto FULL = 2 * SUBPIXEL_ONE * SUBPIXEL_ONE;
+
+            std::vector<int32_t> cells;
+            int width{ 0 };
+            int height{ 0 };
+        public:
+            CoverageBuffer() = default;
+
+
+            CoverageBuffer(
+                    int width,
+                    int height) {
+                Reset(width, height);
+            }
+
+
+            inline auto Reset(
+                    int new_width,
+                    int new_height) -> void {
+                width = std::max(0, new_width);
+                height = std::max(0, new_height);
+                cells.assign(static_cast<size_t>(Stride()) * height, 0);
+            }
+
+
+            [[nodiscard]]
+            inline auto Width() const -> int {
+                return width;
+            }
+
+
+            [[nodiscard]]
+            inline auto Height() const -> int {
+                return height;
+            }
+
+
+            // Adds one directed edge in buffer subpixels. The part above or below the buffer is dropped, and the part
+            // beyond either side is pushed onto that border, which leaves the winding inside unchanged.
+            inline auto AddLine(
+                    int64_t x0,
+                    int64_t y0,
+                    int64_t x1,
+                    int64_t y1) -> void {
+                if (y0 == y1 or 0 == width) {
+                    return;
+                }
+
+                const auto direction = y0 < y1 ? 1 : -1;
+                if (y0 > y1) {
+                    std::swap(x0, x1);
+                    std::swap(y0, y1);
+                }
+
+                if (y1 <= 0 or y0 >= ONE * height) {
+                    return;
+                }
+
+                const auto x_at = [&](int64_t y) {
+                    return x0 + utility::FloorDiv((y - y0) * (x1 - x0), y1 - y0);
+                };
+
+                const auto row_begin = std::max<int64_t>(utility::FloorDiv(y0, ONE), 0);
+                const auto row_end = std::min<int64_t>(utility::CeilDiv(y1, ONE), height);
+
+                auto top = std::max(y0, ONE * row_begin);
+                auto x = top == y0 ? x0 : x_at(top);
+
+                for (auto row = row_begin; row < row_end; row += 1) {
+                    const auto bottom = std::min(y1, ONE * (row + 1));
+                    const auto x_next = bottom == y1 ? x1 : x_at(bottom);
+
+                    Accumulate(static_cast<int>(row), x, top - ONE * row, x_next, bottom - ONE * row, direction);
+
+                    top = bottom;
+                    x = x_next;
+                }
+            }
+
+
+            // Converts the accumulated coverage into alpha-scaled copies of color and blends each row's covered extent
+            // into the canvas at (left, top), which must hold the whole buffer. The buffer is left zeroed for reuse.
+            template<typename Blend = color::FastAlphaBlend>
+            inline auto Resolve(
+                    Canvas & canvas,
+                    int left,
+                    int top,
+                    uint32_t color,
+                    FillRule rule = FillRule::NonZero,
+                    const Blend & blend = {}) -> utility::Rect {
+                canvas.CheckRect({ left, top, left + width, top + height });
+
+                thread_local auto span = std::vector<uint32_t>();
+                span.resize(static_cast<size_t>(width));
+
+                auto dirty = utility::Rect{};
+
+                for (auto y = 0; y < height; y += 1) {
+                    auto * row = cells.data() + static_cast<size_t>(Stride()) * y;
+                    auto sum = int64_t{ 0 };
+                    auto first = width;
+                    auto last = -1;
+
+                    for (auto x = 0; x < width; x += 1) {
+                        sum += row[x];
+                        row[x] = 0;
+
+                        auto coverage = std::abs(sum);
+                        if (FillRule::EvenOdd == rule) {
+                            coverage %= 2 * FULL;
+                            coverage = coverage > FULL ? 2 * FULL - coverage : coverage;
+                        }
+                        else {
+                            coverage = std::min(coverage, FULL);
+                        }
+
+                        const auto alpha = static_cast<uint32_t>((255 * coverage + FULL / 2) / FULL);
+                        span[x] = color::ScaleAlpha(color, alpha);
+
+                        if (alpha) {
+                            first = std::min(first, x);
+                            last = x;
+                        }
+                    }
+
+                    row[width] = 0;
+                    row[width + 1] = 0;
+
+                    if (first <= last) {
+                        color::BlendSpan<Blend>(
+                                canvas.SpanUnchecked(left + first, top + y), span.data() + first, last - first + 1, blend
+                        );
+                        dirty = dirty.Union({ left + first, top + y, left + last + 1, top + y + 1 });
+                    }
+                }
+
+                return dirty;
+            }
+
+
+        private:
+            [[nodiscard]]
+            inline auto Stride() const -> int {
+                return width + 2;
+            }
+
+
+            // One edge piece within a row, with 0 <= y0 < y1 <= ONE relative to the row's top. It is cut at every
+            // column boundary, and each cut deposits the exact area of its trapezoid; whatever lies left of the
+            // buffer lands whole in the first cell, and whatever lies right of it only reaches the spare cells.
+            inline auto Accumulate(
+                    int row_index,
+                    int64_t x0,
+                    int64_t y0,
+                    int64_t x1,
+                    int64_t y1,
+                    int direction) -> void {
+                auto * row = cells.data() + static_cast<size_t>(Stride()) * row_index;
+
+                if (x0 > x1) {
+                    std::swap(x0, x1);
+                    std::swap(y0, y1);
+                }
+
+                const auto first = utility::FloorDiv(x0, ONE);
+                const auto last = x0 == x1 ? first : utility::FloorDiv(x1 - 1, ONE);
+
+                const auto y_at = [&](int64_t column) {
+                    return y0 + utility::FloorDiv((ONE * column - x0) * (y1 - y0), x1 - x0);
+                };
+
+                auto column = first;
+                auto x = x0;
+                auto y = y0;
+
+                if (column < 0) {
+                    const auto y_next = last < 0 ? y1 : y_at(0);
+                    row[0] += static_cast<int32_t>(direction * 2 * ONE * std::abs(y_next - y));
+
+                    if (last < 0) {
+                        return;
+                    }
+
+                    column = 0;
+                    x = 0;
+                    y = y_next;
+                }
+
+                for (; column <= last and column < width; column += 1) {
+                    const auto x_next = column == last ? x1 : ONE * (column + 1);
+                    const auto y_next = column == last ? y1 : y_at(column + 1);
+                    const auto area = direction * std::abs(y_next - y);
+                    const auto middle = x + x_next - 2 * ONE * column;
+
+                    row[column] += static_cast<int32_t>(area * (2 * ONE - middle));
+                    row[column + 1] += static_cast<int32_t>(area * middle);
+
+                    x = x_next;
+                    y = y_next;
+                }
+            }
+        };
+
+
+        // Antialiased fill of several contours as one shape. Vertices are snapped to subpixels relative to
+        // (origin_x, origin_y), which lands on the canvas origin. Coverage is accumulated over the shape's bounds
+        // clipped to the canvas and resolved once, so shared edges between contours never double-blend.
+        template<typename Blend = color::FastAlphaBlend>
+        inline auto FillContoursAA(
+                Canvas & canvas,
+                const std::vector<std::pair<float, float>> * contours,
+                size_t contour_count,
+                int origin_x,
+                int origin_y,
+                uint32_t color,
+                FillRule rule,
+                const Blend & blend) -> decltype(canvas) {
+            auto min_x = std::numeric_limits<int64_t>::max();
+            auto min_y = std::numeric_limits<int64_t>::max();
+            auto max_x = std::numeric_limits<int64_t>::min();
+            auto max_y = std::numeric_limits<int64_t>::min();
+
+            for (auto c = size_t{ 0 }; c < contour_count; c += 1) {
+                for (const auto &[x, y] : contours[c]) {
+                    const auto sx = ToSubpixel(x, origin_x);
+                    const auto sy = ToSubpixel(y, origin_y);
+
+                    min_x = std::min(min_x, sx);
+                    min_y = std::min(min_y, sy);
+                    max_x = std::max(max_x, sx);
+                    max_y = std::max(max_y, sy);
+                }
+            }
+
+            if (min_x > max_x) {
+                return canvas;
+            }
+
+            const auto clip = canvas.Bounds();
+            const auto left = static_cast<int>(std::max<int64_t>(utility::FloorDiv(min_x, SUBPIXEL_ONE), clip.Left));
+            const auto top = static_cast<int>(std::max<int64_t>(utility::FloorDiv(min_y, SUBPIXEL_ONE), clip.Top));
+            const auto right = static_cast<int>(std::min<int64_t>(utility::CeilDiv(max_x, SUBPIXEL_ONE), clip.Right));
+            const auto bottom = static_cast<int>(std::min<int64_t>(utility::CeilDiv(max_y, SUBPIXEL_ONE), clip.Bottom));
+            if (left >= right or top >= bottom) {
+                return canvas;
+            }
+
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::FillPolygonAA);
+            stats::Visit({ left, top, right, bottom });
+
+            thread_local auto coverage = CoverageBuffer();
+            coverage.Reset(right - left, bottom - top);
+
+            for (auto c = size_t{ 0 }; c < contour_count; c += 1) {
+                const auto & contour = contours[c];
+
+                for (auto i = size_t{ 0 }; i < contour.size(); i += 1) {
+                    const auto &[x0, y0] = contour[i];
+                    const auto &[x1, y1] = contour[(i + 1) % contour.size()];
+
+                    coverage.AddLine(
+                            ToSubpixel(x0, origin_x + left),
+                            ToSubpixel(y0, origin_y + top),
+                            ToSubpixel(x1, origin_x + left),
+                            ToSubpixel(y1, origin_y + top)
+                    );
+                }
+            }
+
+            canvas.MarkDirty(coverage.Resolve<Blend>(canvas, left, top, color, rule, blend));
+
+            return canvas;
+        }
+
+
+        template<typename Blend = color::FastAlphaBlend>
+        [[maybe_unused]]
+        inline auto FillPolygonAA(
+                Canvas & canvas,
+                const std::vector<std::pair<float, float>> & vertices,
+                uint32_t color,
+                FillRule rule = FillRule::NonZero,
+                const Blend & blend = {}) -> decltype(canvas) {
+            return FillContoursAA<Blend>(canvas, &vertices, 1, 0, 0, color, rule, blend);
+        }
+
+
+        template<typename Blend = color::FastAlphaBlend>
+        [[maybe_unused]]
+        inline auto FillPolygonAA(
+                Canvas & canvas,
+                const std::vector<std::vector<std::pair<float, float>>> & contours,
+                uint32_t color,
+                FillRule rule = FillRule::NonZero,
+                const Blend & blend = {}) -> decltype(canvas) {
+            return FillContoursAA<Blend>(canvas, contours.data(), contours.size(), 0, 0, color, rule, blend);
+        }
+
+
+        template<typename Blend = color::FastAlphaBlend>
+        [[maybe_unused]]
+        inline auto FillTriangleAA(
+                Canvas & canvas,
+                float x0,
+                float y0,
+                float x1,
+                float y1,
+                float x2,
+                float y2,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            thread_local auto vertices = std::vector<std::pair<float, float>>(3);
+            vertices[0] = { x0, y0 };
+            vertices[1] = { x1, y1 };
+            vertices[2] = { x2, y2 };
+
+            return FillContoursAA<Blend>(canvas, &vertices, 1, 0, 0, color, FillRule::NonZero, blend);
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto FillRect(
+                Canvas & canvas,
+                const utility::Rect & rect,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::FillRect);
+
+            const auto clipped = rect.Intersection(canvas.Bounds());
+            if (clipped.IsEmpty()) {
+                return canvas;
+            }
+
+            stats::Visit(clipped);
+            canvas.CheckRect(clipped);
+
+            for (auto y = clipped.Top; y < clipped.Bottom; y += 1) {
+                color::FillSpan<Blend>(canvas.SpanUnchecked(clipped.Left, y), color, clipped.Width(), blend);
+            }
+            canvas.MarkDirty(clipped);
+
+            return canvas;
+        }
+
+
+        // A colour ramp sampled into SIZE entries, so a gradient fill costs one table lookup per pixel. Stops are
+        // (position in [0, 1], colour) pairs in increasing order; channels are interpolated linearly between them and
+        // held at the first and last stop outside.
+        class GradientRamp final {
+        public:
+            static constexpr auto SIZE = 256;
+
+
+        private:
+            std::array<uint32_t, SIZE> colors{};
+
+
+        public:
+            GradientRamp(
+                    const std::vector<std::pair<float, uint32_t>> & stops) {
+                if (stops.empty()) {
+                    return;
+                }
+
+                auto next = size_t{ 0 };
+                for (auto i = 0; i < SIZE; i += 1) {
+                    const auto position = static_cast<float>(i) / (SIZE - 1);
+                    while (next < stops.size() and stops[next].first <= position) {
+                        next += 1;
+                    }
+
+                    if (0 == next or stops.size() == next) {
+                        colors[i] = stops[std::min(next, stops.size() - 1)].second;
+                        continue;
+                    }
+
+                    const auto &[start, from] = stops[next - 1];
+                    const auto &[end, to] = stops[next];
+                    const auto weight = std::lround(255.0f * (position - start) / (end - start));
+
+                    const auto channel = [&](uint32_t shift) {
+                        const auto a = static_cast<long>((from >> shift) & 0xFF);
+                        const auto b = static_cast<long>((to >> shift) & 0xFF);
+                        return static_cast<uint32_t>(a + ((b - a) * weight + 127) / 255) << shift;
+                    };
+
+                    colors[i] = channel(color::SHIFT_RED)
+                                | channel(color::SHIFT_GREEN)
+                                | channel(color::SHIFT_BLUE)
+                                | channel(color::SHIFT_ALPHA);
+                }
+            }
+
+
+            GradientRamp(
+                    uint32_t from,
+                    uint32_t to)
+                    :
+                    GradientRamp({ { 0.0f, from }, { 1.0f, to } }) {}
+
+
+            [[nodiscard]]
+            inline auto operator[](
+                    int index) const -> uint32_t {
+                return colors[index];
+            }
+        };
+
+
+        // Ramp position 0 at (X0, Y0) and 1 at (X1, Y1), constant across the axis between them and clamped beyond its
+        // ends. Gradient coordinates are canvas pixels, with pixel centres at +0.5.
+        struct LinearGradient {
+            float X0{ 0.0f };
+            float Y0{ 0.0f };
+            float X1{ 0.0f };
+            float Y1{ 0.0f };
+            GradientRamp Ramp;
+
+
+            [[nodiscard]]
+            inline auto Translated(
+                    float dx,
+                    float dy) const -> LinearGradient {
+                return { X0 + dx, Y0 + dy, X1 + dx, Y1 + dy, Ramp };
+            }
+        };
+
+
+        // Ramp position 0 at the centre and 1 at Radius away from it, clamped beyond.
+        struct RadialGradient {
+            float CenterX{ 0.0f };
+            float CenterY{ 0.0f };
+            float Radius{ 0.0f };
+            GradientRamp Ramp;
+
+
+            [[nodiscard]]
+            inline auto Translated(
+                    float dx,
+                    float dy) const -> RadialGradient {
+                return { CenterX + dx, CenterY + dy, Radius, Ramp };
+            }
+        };
+
+
+        // Hands each row span of an already clipped rect to shade(y, colors) and blends the colours it writes.
+        // Policies that copy their source are shaded straight into the canvas.
+        template<typename Blend, typename ShadeFn>
+        inline auto ShadeRect(
+                Canvas & canvas,
+                const utility::Rect & rect,
+                const Blend & blend,
+                ShadeFn && shade) -> void {
+            const auto width = rect.Width();
+
+            if constexpr (Blend::COPIES_SOURCE) {
+                for (auto y = rect.Top; y < rect.Bottom; y += 1) {
+                    stats::Write(width);
+                    shade(y, canvas.SpanUnchecked(rect.Left, y));
+                }
+            }
+            else {
+                thread_local auto span = std::vector<uint32_t>();
+                span.resize(static_cast<size_t>(width));
+
+                for (auto y = rect.Top; y < rect.Bottom; y += 1) {
+                    shade(y, span.data());
+                    color::BlendSpan<Blend>(canvas.SpanUnchecked(rect.Left, y), span.data(), width, blend);
+                }
+            }
+        }
+
+
+        // Ramp positions advance by a constant 16.16 fixed-point step along each row. Rows that do not change along x,
+        // as in vertical gradients, are filled with a single colour.
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto FillRect(
+                Canvas & canvas,
+                const utility::Rect & rect,
+                const LinearGradient & gradient,
+                const Blend & blend = {}) -> decltype(canvas) {
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::FillRect);
+
+            const auto clipped = rect.Intersection(canvas.Bounds());
+            if (clipped.IsEmpty()) {
+                return canvas;
+            }
+
+            stats::Visit(clipped);
+            canvas.CheckRect(clipped);
+
+            constexpr auto ONE = 1 << 16;
+            constexpr auto LAST = GradientRamp::SIZE - 1;
+
+            const auto dx = static_cast<double>(gradient.X1) - gradient.X0;
+            const auto dy = static_cast<double>(gradient.Y1) - gradient.Y0;
+            const auto length2 = dx * dx + dy * dy;
+            const auto scale = length2 > 0.0 ? LAST * static_cast<double>(ONE) / length2 : 0.0;
+            const auto step = static_cast<int64_t>(std::llround(dx * scale));
+
+            // Rows are rounded at the column of X0, which moves with the gradient, so that a clipped or translated replay
+            // steps through the same positions.
+            const auto anchor = static_cast<int>(std::floor(gradient.X0));
+            const auto start = [&](int y) {
+                const auto x = anchor + 0.5 - gradient.X0;
+                const auto position = std::llround((x * dx + (y + 0.5 - gradient.Y0) * dy) * scale);
+                return static_cast<int64_t>(position) + ONE / 2 + step * (clipped.Left - anchor);
+            };
+            const auto index = [](int64_t position) {
+                return static_cast<int>(std::clamp<int64_t>(position >> 16, 0, LAST));
+            };
+
+            if (0 == step) {
+                for (auto y = clipped.Top; y < clipped.Bottom; y += 1) {
+                    const auto color = gradient.Ramp[index(start(y))];
+                    color::FillSpan<Blend>(canvas.SpanUnchecked(clipped.Left, y), color, clipped.Width(), blend);
+                }
+            }
+            else {
+                const auto width = clipped.Width();
+                constexpr auto END = int64_t{ GradientRamp::SIZE } << 16;
+
+                // Positions move monotonically along a row, so only the runs before and after the ramp are clamped.
+                ShadeRect(canvas, clipped, blend, [&](int y, uint32_t * colors) {
+                    auto position = start(y);
+                    auto x = 0;
+
+                    for (; x < width and (position < 0 or position >= END); x += 1, position += step) {
+                        colors[x] = gradient.Ramp[index(position)];
+                    }
+
+                    const auto inside = step > 0 ? (END - position + step - 1) / step : position / -step + 1;
+                    const auto inside_end = static_cast<int>(std::min<int64_t>(width, x + inside));
+                    for (; x < inside_end; x += 1, position += step) {
+                        colors[x] = gradient.Ramp[static_cast<int>(position >> 16)];
+                    }
+
+                    for (; x < width; x += 1, position += step) {
+                        colors[x] = gradient.Ramp[index(position)];
+                    }
+                });
+            }
+            canvas.MarkDirty(clipped);
+
+            return canvas;
+        }
+
+
+        // The squared distance to the centre is carried along each row by its forward difference; only the square
+        // root is taken per pixel.
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto FillRect(
+                Canvas & canvas,
+                const utility::Rect & rect,
+                const RadialGradient & gradient,
+                const Blend & blend = {}) -> decltype(canvas) {
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::FillRect);
+
+            const auto clipped = rect.Intersection(canvas.Bounds());
+            if (clipped.IsEmpty()) {
+                return canvas;
+            }
+
+            stats::Visit(clipped);
+            canvas.CheckRect(clipped);
+
+            constexpr auto LAST = GradientRamp::SIZE - 1;
+
+            if (gradient.Radius <= 0.0f) {
+                for (auto y = clipped.Top; y < clipped.Bottom; y += 1) {
+                    const auto row = canvas.SpanUnchecked(clipped.Left, y);
+                    color::FillSpan<Blend>(row, gradient.Ramp[LAST], clipped.Width(), blend);
+                }
+                canvas.MarkDirty(clipped);
+
+                return canvas;
+            }
+
+            const auto width = clipped.Width();
+            const auto scale = static_cast<float>(LAST) / gradient.Radius;
+
+            ShadeRect(canvas, clipped, blend, [&](int y, uint32_t * colors) {
+                const auto offset_y = y + 0.5 - gradient.CenterY;
+                auto offset_x = clipped.Left + 0.5 - gradient.CenterX;
+                auto distance2 = offset_x * offset_x + offset_y * offset_y;
+
+                for (auto x = 0; x < width; x += 1) {
+                    const auto distance = std::sqrt(static_cast<float>(distance2));
+                    const auto position = std::min(distance * scale + 0.5f, static_cast<float>(LAST));
+                    colors[x] = gradient.Ramp[static_cast<int>(position)];
+
+                    distance2 += 2.0 * offset_x + 1.0;
+                    offset_x += 1.0;
+                }
+            });
+            canvas.MarkDirty(clipped);
+
+            return canvas;
+        }
+
+
+        // Canvases at least this large are cleared with streaming stores: they would not stay cached anyway, and
+        // the stores skip reading every line in before overwriting it.
+        constexpr auto STREAMING_CLEAR_BYTES = size_t{ 1 } << 20u;
+
+
+        [[maybe_unused]]
+        inline auto Clear(
+                Canvas & canvas,
+                uint32_t color = 0) -> decltype(canvas) {
+            [[maybe_unused]] const auto scope = stats::Scope(stats::Primitive::Clear);
+
+            if (canvas.Empty) {
+                return canvas;
+            }
+
+            const auto bounds = canvas.Bounds();
+            const auto width = bounds.Width();
+            stats::Visit(bounds);
+
+            const auto streaming = sizeof(uint32_t) * width * bounds.Height() >= STREAMING_CLEAR_BYTES;
+
+            for (auto y = bounds.Top; y < bounds.Bottom; y += 1) {
+                stats::Write(width);
+                if (streaming) {
+                    color::simd::StreamFillSpan(canvas.SpanUnchecked(bounds.Left, y), color, width);
+                }
+                else {
+                    std::fill_n(canvas.SpanUnchecked(bounds.Left, y), width, color);
+                }
+            }
+
+            if (streaming) {
+                color::simd::StreamFence();
+            }
+            canvas.MarkDirty(bounds);
+
+            return canvas;
+        }
+
+    }
+
+
+    namespace parallel {
+        class WorkerPool final {
+            std::vector<std::thread> workers;
+
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::condition_variable done;
+
+            const std::function<void(int)> * task{ nullptr };
+            int task_count{ 0 };
+            std::atomic<int> next_task{ 0 };
+            int busy{ 0 };
+            uint64_t generation{ 0 };
+            bool stopping{ false };
+            std::exception_ptr error;
+        public:
+            explicit WorkerPool(
+                    int thread_count = static_cast<int>(std::thread::hardware_concurrency())) {
+                for (auto i = 1; i < thread_count; i += 1) {
+                    workers.emplace_back([this] { Work(); });
+                }
+            }
+
+
+            WorkerPool(const WorkerPool &) = delete;
+
+            auto operator=(const WorkerPool &) -> WorkerPool & = delete;
+
+
+            ~WorkerPool() {
+                {
+                    const auto lock = std::lock_guard(mutex);
+                    stopping = true;
+                }
+                wake.notify_all();
+
+                for (auto & worker : workers) {
+                    worker.join();
+                }
+            }
+
+
+            [[nodiscard]]
+            inline auto ThreadCount() const -> int {
+                return static_cast<int>(workers.size()) + 1;
+            }
+
+
+            // Runs fn(0) ... fn(count - 1) on the workers and the calling thread and returns once all of them
+            // have finished. The first exception thrown by fn is rethrown here. Not reentrant.
+            inline auto Run(
+                    int count,
+                    const std::function<void(int)> & fn) -> void {
+                if (count <= 0) {
+                    return;
+                }
+
+                {
+                    const auto lock = std::lock_guard(mutex);
+                    task = &fn;
+                    task_count = count;
+                    next_task = 0;
+                    busy = static_cast<int>(workers.size());
+                    error = nullptr;
+                    generation += 1;
+                }
+                wake.notify_all();
+
+                Drain();
+
+                auto lock = std::unique_lock(mutex);
+                done.wait(lock, [this] { return 0 == busy; });
+                task = nullptr;
+
+                if (error) {
+                    std::rethrow_exception(std::exchange(error, nullptr));
+                }
+            }
+
+
+        private:
+            inline auto Drain() -> void {
+                for (auto i = next_task++; i < task_count; i = next_task++) {
+                    try {
+                        (*task)(i);
+                    }
+                    catch (...) {
+                        const auto lock = std::lock_guard(mutex);
+                        if (not error) {
+                            error = std::current_exception();
+                        }
+                    }
+                }
+            }
+
+
+            inline auto Work() -> void {
+                auto seen = uint64_t{ 0 };
+
+                while (true) {
+                    {
+                        auto lock = std::unique_lock(mutex);
+                        wake.wait(lock, [&] { return stopping or generation != seen; });
+                        if (stopping) {
+                            return;
+                        }
+                        seen = generation;
+                    }
+
+                    Drain();
+
+                    {
+                        const auto lock = std::lock_guard(mutex);
+                        busy -= 1;
+                    }
+                    done.notify_one();
+                }
+            }
+        };
+
+
+        [[nodiscard]]
+        inline auto BandHeight(
+                const WorkerPool & pool,
+                const Canvas & canvas) -> int {
+            constexpr auto bands_per_thread = 4;
+            constexpr auto min_band_height = 16;
+
+            const auto bands = pool.ThreadCount() * bands_per_thread;
+            return std::max(min_band_height, (canvas.Height + bands - 1) / bands);
+        }
+
+
+        // Splits the canvas into horizontal bands and calls draw(band, top) for each of them in parallel, where
+        // band is a view of rows [top, top + band.Height). Everything drawn into one band happens on one thread in
+        // the order draw issues it, so overlapping draws within a call compose exactly as they would serially.
+        // Primitives must clip to the band they are given; coordinates are shifted by -top.
+        template<typename DrawFn>
+        [[maybe_unused]]
+        inline auto ForEachBand(
+                WorkerPool & pool,
+                Canvas & canvas,
+                int band_height,
+                DrawFn && draw) -> decltype(canvas) {
+            if (canvas.Empty) {
+                return canvas;
+            }
+
+            band_height = std::max(band_height, 1);
+            const auto band_count = (canvas.Height + band_height - 1) / band_height;
+
+            pool.Run(band_count, [&](int band_index) {
+                const auto top = band_index * band_height;
+                auto band = canvas.View(0, top, canvas.Width, std::min(band_height, canvas.Height - top));
+                draw(band, top);
+            });
+
+            return canvas;
+        }
+
+
+        template<typename DrawFn>
+        [[maybe_unused]]
+        inline auto ForEachBand(
+                WorkerPool & pool,
+                Canvas & canvas,
+                DrawFn && draw) -> decltype(canvas) {
+            return ForEachBand(pool, canvas, BandHeight(pool, canvas), std::forward<DrawFn>(draw));
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto Copy(
+                WorkerPool & pool,
+                const ConstCanvas & src,
+                Canvas & dst,
+                int x0 = 0,
+                int y0 = 0,
+                const transform::Transform & tf = {},
+                const Blend & blend = {}) -> decltype(dst) {
+            return ForEachBand(pool, dst, [&](Canvas & band, int top) {
+                transform::Copy<Blend>(src, band, x0, y0 - top, tf, blend);
+            });
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto CopyBatch(
+                WorkerPool & pool,
+                const ConstCanvas & atlas,
+                Canvas & dst,
+                const std::vector<transform::Instance> & instances,
+                const Blend & blend = {}) -> decltype(dst) {
+            if (dst.Empty or atlas.Empty) {
+                return dst;
+            }
+
+            const auto band_height = BandHeight(pool, dst);
+            const auto prepared = transform::PrepareBatch(atlas, dst, instances);
+            const auto bins = transform::BinBatch(prepared, dst.Height, band_height);
+
+            return ForEachBand(pool, dst, band_height, [&](Canvas & band, int top) {
+                for (const auto i : bins[top / band_height]) {
+                    transform::DrawPrepared<Blend>(prepared[i], band, top, blend);
+                }
+            });
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto DrawMesh(
+                WorkerPool & pool,
+                Canvas & canvas,
+                const drawing::Mesh & mesh,
+                int x0 = 0,
+                int y0 = 0,
+                const Blend & blend = {}) -> decltype(canvas) {
+            return ForEachBand(pool, canvas, [&](Canvas & band, int top) {
+                drawing::DrawMesh<Blend>(band, mesh, x0, y0 - top, blend);
+            });
+        }
+
+
+        template<typename Blend>
+        [[maybe_unused]]
+        inline auto FillTriangle(
+                WorkerPool & pool,
+                Canvas & canvas,
+                int x0,
+                int y0,
+                int x1,
+                int y1,
+                int x2,
+                int y2,
+                uint32_t color,
+                const Blend & blend = {}) -> decltype(canvas) {
+            return ForEachBand(pool, canvas, [&](Canvas & band, int top) {
+                drawing::FillTriangle<Blend>(band, x0, y0 - top, x1, y1 - top, x2, y2 - top, color, blend);
+            });
+        }
+
+
+        // How FramePipeline hands frames from the producer to the consumer. Queue presents every frame in order and
+        // makes the producer wait while all frames are queued or on screen; Latest never blocks the producer and
+        // drops a published frame the consumer has not picked up yet when a newer one replaces it.
+        enum class Handoff {
+            Queue,
+            Latest
+        };
+
+
+        // A ring of frames passed between exactly one render thread and one present thread without locks, so
+        // rendering frame N + 1 overlaps presenting frame N. The producer takes a frame with AcquireRender, draws
+        // and calls ReleaseRender; the consumer mirrors that with AcquirePresent and ReleasePresent. Either side may
+        // hold at most one frame at a time.
+        class FramePipeline final {
+        public:
+            // Dirty collects what is drawn into Pixels: restore it from the background before drawing the next
+            // frame into the same slot, and upload its union with the previously presented frame's region. A new
+            // frame starts with the whole canvas dirty.
+            class Frame final {
+                utility::AlignedPixelBuffer buffer;
+            public:
+                Canvas Pixels;
+                utility::DirtyRegion Dirty;
+                uint64_t Number{ 0 };
+
+
+                Frame(
+                        int width,
+                        int height)
+                        :
+                        buffer(width, height),
+                        Pixels(buffer) {
+                    Pixels.TrackDirty(&Dirty);
+                    Pixels.MarkDirty({ 0, 0, width, height });
+                }
+
+
+                Frame(const Frame &) = delete;
+
+                auto operator=(const Frame &) -> Frame & = delete;
+            };
+        private:
+            static constexpr auto FRESH = size_t{ 1 } << 8u;
+
+            std::vector<std::unique_ptr<Frame>> frames;
+            const Handoff handoff;
+
+            std::atomic<bool> closed{ false };
+            std::atomic<uint64_t> dropped{ 0 };
+
+            // Queue: frames published and released so far, each written by one side only
+            alignas(utility::BUFFER_ALIGNMENT) std::atomic<size_t> published{ 0 };
+            alignas(utility::BUFFER_ALIGNMENT) std::atomic<size_t> consumed{ 0 };
+
+            // Latest: the producer owns back, the consumer owns front, and the third frame sits in the mailbox
+            alignas(utility::BUFFER_ALIGNMENT) std::atomic<size_t> mailbox{ 2 };
+            size_t back{ 0 };
+            uint64_t rendered{ 0 };
+            alignas(utility::BUFFER_ALIGNMENT) size_t front{ 1 };
+
+            // Slow path for a side that has spun for SPIN_ATTEMPTS without getting a frame
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::atomic<int> waiters{ 0 };
+        public:
+            static constexpr auto DEFAULT_DEPTH = 3;
+            static constexpr auto SPIN_ATTEMPTS = 64;
+
+
+            // Queue keeps depth frames, at least two; Latest always uses three.
+            FramePipeline(
+                    int width,
+                    int height,
+                    Handoff handoff = Handoff::Queue,
+                    int depth = DEFAULT_DEPTH)
+                    :
+                    handoff(handoff) {
+                const auto count = Handoff::Latest == handoff ? 3 : std::max(depth, 2);
+                for (auto i = 0; i < count; i += 1) {
+                    frames.push_back(std::make_unique<Frame>(width, height));
+                }
+            }
+
+
+            [[nodiscard]]
+            inline auto Depth() const -> int {
+                return static_cast<int>(frames.size());
+            }
+
+
+            // Frames published under Handoff::Latest that were replaced before the consumer took them.
+            [[nodiscard]]
+            inline auto Dropped() const -> uint64_t {
+                return dropped.load(std::memory_order_relaxed);
+            }
+
+
+            // Wakes both sides for good: AcquireRender returns nullptr from now on, and AcquirePresent does once
+            // every published frame has been taken.
+            inline auto Close() -> void {
+                closed.store(true, std::memory_order_release);
+
+                {
+                    const auto lock = std::lock_guard(mutex);
+                }
+                wake.notify_all();
+            }
+
+
+            [[nodiscard]]
+            inline auto IsClosed() const -> bool {
+                return closed.load(std::memory_order_acquire);
+            }
+
+
+            [[nodiscard]]
+            inline auto TryAcquireRender() -> Frame * {
+                if (Handoff::Latest == handoff) {
+                    return frames[back].get();
+                }
+
+                const auto queued = published.load(std::memory_order_relaxed);
+                if (queued - consumed.load(std::memory_order_acquire) >= frames.size()) {
+                    return nullptr;
+                }
+
+                return frames[queued % frames.size()].get();
+            }
+
+
+            // Waits for a free frame; nullptr once the pipeline is closed.
+            [[nodiscard]]
+            inline auto AcquireRender() -> Frame * {
+                return Wait([this] { return IsClosed() ? nullptr : TryAcquireRender(); });
+            }
+
+
+            inline auto ReleaseRender() -> void {
+                rendered += 1;
+
+                if (Handoff::Latest == handoff) {
+                    frames[back]->Number = rendered;
+
+                    const auto previous = mailbox.exchange(back | FRESH, std::memory_order_acq_rel);
+                    if (previous & FRESH) {
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    back = previous & ~FRESH;
+                }
+                else {
+                    const auto queued = published.load(std::memory_order_relaxed);
+                    frames[queued % frames.size()]->Number = rendered;
+                    published.store(queued + 1, std::memory_order_release);
+                }
+
+                Signal();
+            }
+
+
+            [[nodiscard]]
+            inline auto TryAcquirePresent() -> Frame * {
+                if (Handoff::Latest == handoff) {
+                    if (not (mailbox.load(std::memory_order_relaxed) & FRESH)) {
+                        return nullptr;
+                    }
+
+                    front = mailbox.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+                    return frames[front].get();
+                }
+
+                const auto taken = consumed.load(std::memory_order_relaxed);
+                if (taken == published.load(std::memory_order_acquire)) {
+                    return nullptr;
+                }
+
+                return frames[taken % frames.size()].get();
+            }
+
+
+            // Waits for a published frame; nullptr once the pipeline is closed and drained.
+            [[nodiscard]]
+            inline auto AcquirePresent() -> Frame * {
+                return Wait([this] { return TryAcquirePresent(); });
+            }
+
+
+            inline auto ReleasePresent() -> void {
+                // Under Latest the consumer keeps its frame until it swaps it for a fresh one
+                if (Handoff::Queue == handoff) {
+                    consumed.store(consumed.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                    Signal();
+                }
+            }
+
+
+        private:
+            // Spins briefly on attempt, then sleeps until the other side releases a frame or the pipeline closes.
+            template<typename TryFn>
+            inline auto Wait(
+                    TryFn && attempt) -> Frame * {
+                auto frame = static_cast<Frame *>(nullptr);
+                auto done = false;
+                const auto ready = [&] {
+                    done = IsClosed();
+                    frame = attempt();
+                    return frame or done;
+                };
+
+                for (auto i = 0; i < SPIN_ATTEMPTS; i += 1) {
+                    if (ready()) {
+                        return frame;
+                    }
+                    std::this_thread::yield();
+                }
+
+                auto lock = std::unique_lock(mutex);
+                // Pairs with the read-modify-write in Signal: whichever comes second in waiters' modification order
+                // either sees the other's frame or the waiter, so a release is never missed
+                waiters.fetch_add(1, std::memory_order_acq_rel);
+                wake.wait(lock, ready);
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+
+                return frame;
+            }
+
+
+            inline auto Signal() -> void {
+                if (not waiters.fetch_add(0, std::memory_order_acq_rel)) {
+                    return;
+                }
+
+                {
+                    const auto lock = std::lock_guard(mutex);
+                }
+                wake.notify_all();
+            }
+        };
+    }
+
+
+    namespace render {
+        [[nodiscard]]
+        inline auto NextRevision() -> uint64_t {
+            static auto counter = std::atomic<uint64_t>{ 0 };
+            return ++counter;
+        }
+
+
+        // Records draw calls for later replay. Source canvases are captured as views and must outlive the list.
+        class CommandList final {
+        public:
+            struct Command {
+                utility::Rect Bounds;
+                std::function<void(Canvas &, int, int)> Draw;
+            };
+
+
+        private:
+            std::vector<Command> commands;
+            uint64_t revision{ NextRevision() };
+
+
+        public:
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto Copy(
+                    const ConstCanvas & src,
+                    int x0 = 0,
+                    int y0 = 0,
+                    const transform::Transform & tf = {},
+                    const Blend & blend = {}) -> CommandList & {
+                return Record(
+                        transform::Bounds(src, x0, y0, tf),
+                        [src, x0, y0, tf, blend](Canvas & target, int left, int top) {
+                            transform::Copy<Blend>(src, target, x0 - left, y0 - top, tf, blend);
+                        }
+                );
+            }
+
+
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto Line(
+                    int x0,
+                    int y0,
+                    int x1,
+                    int y1,
+                    uint32_t color,
+                    const Blend & blend = {}) -> CommandList & {
+                return Record(
+                        { std::min(x0, x1), std::min(y0, y1), std::max(x0, x1) + 1, std::max(y0, y1) + 1 },
+                        [=](Canvas & target, int left, int top) {
+                            drawing::Line<Blend>(target, x0 - left, y0 - top, x1 - left, y1 - top, color, blend);
+                        }
+                );
+            }
+
+
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto Polygon(
+                    std::vector<std::pair<int, int>> vertices,
+                    uint32_t color,
+                    const Blend & blend = {}) -> CommandList & {
+                auto bounds = utility::Rect{};
+                for (const auto &[x, y] : vertices) {
+                    bounds = bounds.Union({ x, y, x + 1, y + 1 });
+                }
+
+                return Record(
+                        bounds,
+                        [vertices = std::move(vertices), color, blend](Canvas & target, int left, int top) {
+                            thread_local auto shifted = std::vector<std::pair<int, int>>();
+                            shifted.clear();
+                            for (const auto &[x, y] : vertices) {
+                                shifted.emplace_back(x - left, y - top);
+                            }
+
+                            drawing::Polygon<Blend>(target, shifted, color, blend);
+                        }
+                );
+            }
+
+
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto Polyline(
+                    std::vector<std::pair<int, int>> vertices,
+                    uint32_t color,
+                    bool closed = false,
+                    const Blend & blend = {}) -> CommandList & {
+                auto bounds = utility::Rect{};
+                for (const auto &[x, y] : vertices) {
+                    bounds = bounds.Union({ x, y, x + 1, y + 1 });
+                }
+
+                return Record(
+                        bounds,
+                        [vertices = std::move(vertices), color, closed, blend](Canvas & target, int left, int top) {
+                            thread_local auto shifted = std::vector<std::pair<int, int>>();
+                            shifted.clear();
+                            for (const auto &[x, y] : vertices) {
+                                shifted.emplace_back(x - left, y - top);
+                            }
+
+                            drawing::Polyline<Blend>(target, shifted, color, closed, blend);
+                        }
+                );
+            }
+
+
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto FillPolygon(
+                    std::vector<std::pair<int, int>> vertices,
+                    uint32_t color,
+                    drawing::FillRule rule = drawing::FillRule::NonZero,
+                    const Blend & blend = {}) -> CommandList & {
+                auto bounds = utility::Rect{};
+                for (const auto &[x, y] : vertices) {
+                    bounds = bounds.Union({ x, y, x + 1, y + 1 });
+                }
+
+                return Record(
+                        bounds,
+                        [vertices = std::move(vertices), color, rule, blend](Canvas & target, int left, int top) {
+                            thread_local auto shifted = std::vector<std::pair<int, int>>();
+                            shifted.clear();
+                            for (const auto &[x, y] : vertices) {
+                                shifted.emplace_back(x - left, y - top);
+                            }
+
+                            drawing::FillPolygon<Blend>(target, shifted, color, rule, blend);
+                        }
+                );
+            }
+
+
+            template<typename Blend = color::FastAlphaBlend>
+            [[maybe_unused]]
+            inline auto LineAA(
+                    float x0,
+                    float y0,
+                    float x1,
+                    float y1,
+                    uint32_t color,
+                    const Blend & blend = {}) -> CommandList & {
+                return Record(
+                        {
+                                static_cast<int>(std::floor(std::min(x0, x1))) - 1,
+                                static_cast<int>(std::floor(std::min(y0, y1))) - 1,
+                                static_cast<int>(std::ceil(std::max(x0, x1))) + 1,
+                                static_cast<int>(std::ceil(std::max(y0, y1))) + 1
+                        },
+                        [=](Canvas & target, int left, int top) {
+                            drawing::SubpixelLineAA<Blend>(
+                                    target,
+                                    drawing::ToSubpixel(x0, left),
+                                    drawing::ToSubpixel(y0, top),
+                                    drawing::ToSubpixel(x1, left),
+                                    drawing::ToSubpixel(y1, top),
+                                    color,
+                                    blend
+                            );
+                        }
+                );
+            }
+
+
+            template<typename Blend = color::FastAlphaBlend>
+            [[maybe_unused]]
+            inline auto FillPolygonAA(
+                    std::vector<std::pair<float, float>> vertices,
+                    uint32_t color,
+                    drawing::FillRule rule = drawing::FillRule::NonZero,
+                    const Blend & blend = {}) -> CommandList & {
+                auto bounds = utility::Rect{};
+                for (const auto &[x, y] : vertices) {
+                    const auto left = static_cast<int>(std::floor(x));
+                    const auto top = static_cast<int>(std::floor(y));
+                    bounds = bounds.Union({ left, top, left + 1, top + 1 });
+                }
+
+                return Record(
+                        bounds,
+                        [vertices = std::move(vertices), color, rule, blend](Canvas & target, int left, int top) {
+                            drawing::FillContoursAA<Blend>(target, &vertices, 1, left, top, color, rule, blend);
+                        }
+                );
+            }
+
+
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto FillTriangle(
+                    int x0,
+                    int y0,
+                    int x1,
+                    int y1,
+                    int x2,
+                    int y2,
+                    uint32_t color,
+                    const Blend & blend = {}) -> CommandList & {
+                return Record(
+                        {
+                                std::min({ x0, x1, x2 }),
+                                std::min({ y0, y1, y2 }),
+                                std::max({ x0, x1, x2 }) + 1,
+                                std::max({ y0, y1, y2 }) + 1
+                        },
+                        [=](Canvas & target, int left, int top) {
+                            drawing::FillTriangle<Blend>(
+                                    target,
+                                    x0 - left, y0 - top,
+                                    x1 - left, y1 - top,
+                                    x2 - left, y2 - top,
+                                    color,
+                                    blend
+                            );
+                        }
+                );
+            }
+
+
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto FillRect(
+                    const utility::Rect & rect,
+                    uint32_t color,
+                    const Blend & blend = {}) -> CommandList & {
+                return Record(
+                        rect,
+                        [=](Canvas & target, int left, int top) {
+                            const auto shifted = utility::Rect{
+                                    rect.Left - left, rect.Top - top, rect.Right - left, rect.Bottom - top
+                            };
+                            drawing::FillRect<Blend>(target, shifted, color, blend);
+                        }
+                );
+            }
+
+
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto FillRect(
+                    const utility::Rect & rect,
+                    const drawing::LinearGradient & gradient,
+                    const Blend & blend = {}) -> CommandList & {
+                return FillGradientRect<Blend>(rect, gradient, blend);
+            }
+
+
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto FillRect(
+                    const utility::Rect & rect,
+                    const drawing::RadialGradient & gradient,
+                    const Blend & blend = {}) -> CommandList & {
+                return FillGradientRect<Blend>(rect, gradient, blend);
+            }
+
+
+            template<typename Blend, typename Gradient>
+            inline auto FillGradientRect(
+                    const utility::Rect & rect,
+                    const Gradient & gradient,
+                    const Blend & blend) -> CommandList & {
+                return Record(
+                        rect,
+                        [=](Canvas & target, int left, int top) {
+                            const auto shifted = utility::Rect{
+                                    rect.Left - left, rect.Top - top, rect.Right - left, rect.Bottom - top
+                            };
+                            const auto dx = static_cast<float>(-left);
+                            const auto dy = static_cast<float>(-top);
+                            drawing::FillRect<Blend>(target, shifted, gradient.Translated(dx, dy), blend);
+                        }
+                );
+            }
+
+
+            // The mesh is captured by reference and must outlive the list.
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto Mesh(
+                    const drawing::Mesh & mesh,
+                    int x0 = 0,
+                    int y0 = 0,
+                    const Blend & blend = {}) -> CommandList & {
+                return Record(
+                        drawing::MeshBounds(mesh, x0, y0),
+                        [&mesh, x0, y0, blend](Canvas & target, int left, int top) {
+                            drawing::DrawMesh<Blend>(target, mesh, x0 - left, y0 - top, blend);
+                        }
+                );
+            }
+
+
+            inline auto Record(
+                    const utility::Rect & bounds,
+                    std::function<void(Canvas &, int, int)> draw) -> CommandList & {
+                commands.push_back({ bounds, std::move(draw) });
+                revision = NextRevision();
+
+                return *this;
+            }
+
+
+            inline auto Clear() -> CommandList & {
+                commands.clear();
+                revision = NextRevision();
+
+                return *this;
+            }
+
+
+            [[nodiscard]]
+            inline auto Commands() const -> const std::vector<Command> & {
+                return commands;
+            }
+
+
+            [[nodiscard]]
+            inline auto Revision() const -> uint64_t {
+                return revision;
+            }
+
+
+            inline auto Execute(
+                    Canvas & canvas) const -> decltype(canvas) {
+                for (const auto & command : commands) {
+                    command.Draw(canvas, 0, 0);
+                }
+
+                return canvas;
+            }
+        };
+
+
+        // Bins the commands of a list into square tiles by their bounds and replays, per tile, only the commands that
+        // touch it, in recording order. Bins are kept for as long as the list and canvas size stay the same.
+        class TiledRenderer final {
+            int tile_size;
+
+            std::vector<std::vector<int>> bins;
+            int tiles_x{ 0 };
+            int tiles_y{ 0 };
+
+            uint64_t binned_revision{ 0 };
+            int binned_width{ 0 };
+            int binned_height{ 0 };
+        public:
+            static constexpr auto DEFAULT_TILE_SIZE = 64;
+
+
+            explicit TiledRenderer(
+                    int tile_size = DEFAULT_TILE_SIZE)
+                    :
+                    tile_size(std::max(tile_size, 1)) {}
+
+
+            [[maybe_unused]]
+            inline auto Render(
+                    const CommandList & list,
+                    Canvas & canvas) -> decltype(canvas) {
+                Bin(list, canvas);
+
+                for (auto tile = 0; tile < tiles_x * tiles_y; tile += 1) {
+                    RenderTile(list, canvas, tile);
+                }
+
+                return canvas;
+            }
+
+
+            [[maybe_unused]]
+            inline auto Render(
+                    parallel::WorkerPool & pool,
+                    const CommandList & list,
+                    Canvas & canvas) -> decltype(canvas) {
+                Bin(list, canvas);
+
+                pool.Run(tiles_x * tiles_y, [&](int tile) {
+                    RenderTile(list, canvas, tile);
+                });
+
+                return canvas;
+            }
+
+
+        private:
+            inline auto Bin(
+                    const CommandList & list,
+                    const Canvas & canvas) -> void {
+                if (list.Revision() == binned_revision
+                    and canvas.Width == binned_width
+                    and canvas.Height == binned_height) {
+                    return;
+                }
+
+                tiles_x = (canvas.Width + tile_size - 1) / tile_size;
+                tiles_y = (canvas.Height + tile_size - 1) / tile_size;
+
+                bins.resize(tiles_x * tiles_y);
+                for (auto & bin : bins) {
+                    bin.clear();
+                }
+
+                const auto canvas_bounds = utility::Rect{ 0, 0, canvas.Width, canvas.Height };
+                const auto & commands = list.Commands();
+
+                for (auto i = 0; i < static_cast<int>(commands.size()); i += 1) {
+                    const auto bounds = commands[i].Bounds.Intersection(canvas_bounds);
+                    if (bounds.IsEmpty()) {
+                        continue;
+                    }
+
+                    for (auto ty = bounds.Top / tile_size; ty <= (bounds.Bottom - 1) / tile_size; ty += 1) {
+                        for (auto tx = bounds.Left / tile_size; tx <= (bounds.Right - 1) / tile_size; tx += 1) {
+                            bins[ty * tiles_x + tx].push_back(i);
+                        }
+                    }
+                }
+
+                binned_revision = list.Revision();
+                binned_width = canvas.Width;
+                binned_height = canvas.Height;
+            }
+
+
+            inline auto RenderTile(
+                    const CommandList & list,
+                    Canvas & canvas,
+                    int tile) const -> void {
+                if (bins[tile].empty()) {
+                    return;
+                }
+
+                const auto left = tile % tiles_x * tile_size;
+                const auto top = tile / tiles_x * tile_size;
+
+                auto view = canvas.View(
+                        left,
+                        top,
+                        std::min(tile_size, canvas.Width - left),
+                        std::min(tile_size, canvas.Height - top)
+                );
+
+                const auto & commands = list.Commands();
+                for (const auto i : bins[tile]) {
+                    commands[i].Draw(view, left, top);
+                }
+            }
+        };
+
+
+        // Renders a list into an image of the given size one horizontal band at a time, reusing a single band buffer,
+        // and calls sink(band, top) with each finished band: a view of image rows [top, top + band.Height), handed
+        // over top to bottom on the calling thread. Only one band is ever held, so peak memory follows the band
+        // height rather than the image size. The view is overwritten by the next band once sink returns.
+        class BandedRenderer final {
+            int band_height;
+            utility::AlignedPixelBuffer buffer;
+
+            std::vector<std::vector<int>> bins;
+            int band_count{ 0 };
+
+            uint64_t binned_revision{ 0 };
+            int binned_width{ 0 };
+            int binned_height{ 0 };
+        public:
+            static constexpr auto DEFAULT_BAND_HEIGHT = 64;
+
+
+            explicit BandedRenderer(
+                    int band_height = DEFAULT_BAND_HEIGHT)
+                    :
+                    band_height(std::max(band_height, 1)) {}
+
+
+            template<typename Sink>
+            [[maybe_unused]]
+            inline auto Render(
+                    const CommandList & list,
+                    int width,
+                    int height,
+                    uint32_t background,
+                    Sink && sink) -> void {
+                Bin(list, width, height);
+
+                for (auto band_index = 0; band_index < band_count; band_index += 1) {
+                    const auto top = band_index * band_height;
+                    auto band = Band(width, std::min(band_height, height - top), background);
+
+                    const auto & commands = list.Commands();
+                    for (const auto i : bins[band_index]) {
+                        commands[i].Draw(band, 0, top);
+                    }
+
+                    sink(ConstCanvas(band), top);
+                }
+            }
+
+
+            // Each band is split into strips replayed in parallel; sink is still called on the calling thread, in
+            // order, once the whole band is done.
+            template<typename Sink>
+            [[maybe_unused]]
+            inline auto Render(
+                    parallel::WorkerPool & pool,
+                    const CommandList & list,
+                    int width,
+                    int height,
+                    uint32_t background,
+                    Sink && sink) -> void {
+                Bin(list, width, height);
+
+                for (auto band_index = 0; band_index < band_count; band_index += 1) {
+                    const auto top = band_index * band_height;
+                    auto band = Band(width, std::min(band_height, height - top), background);
+
+                    const auto strip_height = parallel::BandHeight(pool, band);
+                    const auto strip_count = (band.Height + strip_height - 1) / strip_height;
+
+                    pool.Run(strip_count, [&](int strip_index) {
+                        const auto strip_top = strip_index * strip_height;
+                        auto strip = band.View(0, strip_top, width, std::min(strip_height, band.Height - strip_top));
+                        const auto strip_bounds = utility::Rect{ 0, top + strip_top, width, top + strip_top + strip.Height };
+
+                        const auto & commands = list.Commands();
+                        for (const auto i : bins[band_index]) {
+                            if (not commands[i].Bounds.Intersection(strip_bounds).IsEmpty()) {
+                                commands[i].Draw(strip, 0, top + strip_top);
+                            }
+                        }
+                    });
+
+                    sink(ConstCanvas(band), top);
+                }
+            }
+
+
+        private:
+            inline auto Bin(
+                    const CommandList & list,
+                    int width,
+                    int height) -> void {
+                if (list.Revision() == binned_revision and width == binned_width and height == binned_height) {
+                    return;
+                }
+
+                band_count = width > 0 and height > 0 ? (height + band_height - 1) / band_height : 0;
+
+                bins.resize(band_count);
+                for (auto & bin : bins) {
+                    bin.clear();
+                }
+
+                const auto image_bounds = utility::Rect{ 0, 0, width, height };
+                const auto & commands = list.Commands();
+
+                for (auto i = 0; i < static_cast<int>(commands.size()); i += 1) {
+                    const auto bounds = commands[i].Bounds.Intersection(image_bounds);
+                    if (bounds.IsEmpty()) {
+                        continue;
+                    }
+
+                    for (auto band = bounds.Top / band_height; band <= (bounds.Bottom - 1) / band_height; band += 1) {
+                        bins[band].push_back(i);
+                    }
+                }
+
+                binned_revision = list.Revision();
+                binned_width = width;
+                binned_height = height;
+            }
+
+
+            // Returns the first rows of the band buffer, cleared to background, growing the buffer if needed.
+            inline auto Band(
+                    int width,
+                    int rows,
+                    uint32_t background) -> Canvas {
+                if (buffer.Width() != width or buffer.Height() < band_height) {
+                    buffer = utility::AlignedPixelBuffer(width, band_height, utility::Initialization::Uninitialized);
+                }
+
+                auto band = Canvas(buffer.Data(), width, rows, buffer.Stride());
+                for (auto y = 0; y < rows; y += 1) {
+                    std::fill_n(band.RowUnchecked(y), width, background);
+                }
+
+                return band;
+            }
+        };
+
+
+        class Compositor;
+
+
+        // An offscreen canvas in a Compositor's stack, placed with its own transform, opacity and blend policy. Call
+        // Touch after drawing into Pixels(); moving, fading or hiding the layer needs no call, since the compositor
+        // compares those itself.
+        class Layer final {
+            friend class Compositor;
+
+
+            using ComposeFn = void (*)(const Layer &, Canvas &, int);
+
+
+            utility::AlignedPixelBuffer buffer;
+            ComposeFn compose;
+            uint64_t revision{ NextRevision() };
+
+
+            Layer(
+                    int width,
+                    int height,
+                    ComposeFn compose)
+                    :
+                    buffer(width, height),
+                    compose(compose) {}
+
+
+            template<typename Blend>
+            [[nodiscard]]
+            static auto Create(
+                    int width,
+                    int height) -> std::unique_ptr<Layer> {
+                return std::unique_ptr<Layer>(new Layer(width, height, &Compose<Blend>));
+            }
+
+
+            template<typename Blend>
+            static auto Compose(
+                    const Layer & layer,
+                    Canvas & band,
+                    int top) -> void {
+                if (not layer.Visible or not layer.Opacity) {
+                    return;
+                }
+
+                const auto pixels = ConstCanvas(layer.buffer);
+                const auto y = layer.Y - top;
+
+                if (layer.Opacity >= 0xFF) {
+                    transform::Copy<Blend>(pixels, band, layer.X, y, layer.Transform);
+                }
+                else {
+                    const auto blend = color::WithOpacity<Blend>(layer.Opacity);
+                    transform::Copy<color::WithOpacity<Blend>>(pixels, band, layer.X, y, layer.Transform, blend);
+                }
+            }
+
+
+        public:
+            int X{ 0 };
+            int Y{ 0 };
+            transform::Transform Transform{};
+            uint32_t Opacity{ 0xFF };
+            bool Visible{ true };
+
+
+            [[nodiscard]]
+            inline auto Pixels() -> Canvas {
+                return Canvas(buffer);
+            }
+
+
+            inline auto Touch() -> Layer & {
+                revision = NextRevision();
+
+                return *this;
+            }
+        };
+
+
+        // Flattens a stack of layers, bottom first, over a background colour. The bottom layers that are unchanged
+        // since the previous Flatten stay flattened in a cache, so a static backdrop costs one copy per frame. The
+        // rest is fused: the destination is composited one band at a time, every layer blended into a band while it
+        // is still in cache, so each destination pixel goes to memory once rather than once per layer.
+        class Compositor final {
+            struct State {
+                uint64_t Revision{ 0 };
+                int X{ 0 };
+                int Y{ 0 };
+                transform::Transform Transform{};
+                uint32_t Opacity{ 0 };
+                bool Visible{ false };
+
+
+                [[nodiscard]]
+                inline auto Matches(
+                        const Layer & layer) const -> bool {
+                    const auto & tf = layer.Transform;
+                    return Revision == layer.revision and X == layer.X and Y == layer.Y
+                           and Transform.RotationRadians == tf.RotationRadians
+                           and Transform.OriginX == tf.OriginX and Transform.OriginY == tf.OriginY
+                           and Transform.ScaleX == tf.ScaleX and Transform.ScaleY == tf.ScaleY
+                           and Transform.Filter == tf.Filter
+                           and Opacity == layer.Opacity and Visible == layer.Visible;
+                }
+            };
+
+
+            std::vector<std::unique_ptr<Layer>> layers;
+            std::vector<State> states;
+
+            utility::AlignedPixelBuffer cache;
+            int cached_count{ 0 };
+            uint32_t cached_background{ 0 };
+        public:
+            static constexpr auto BAND_BYTES = 64 * 1024;
+
+
+            // Layers stack in the order they are added; the reference stays valid for the compositor's lifetime.
+            template<typename Blend>
+            [[maybe_unused]]
+            inline auto AddLayer(
+                    int width,
+                    int height) -> Layer & {
+                layers.push_back(Layer::Create<Blend>(width, height));
+
+                return *layers.back();
+            }
+
+
+            [[nodiscard]]
+            inline auto LayerCount() const -> int {
+                return static_cast<int>(layers.size());
+            }
+
+
+            [[nodiscard]]
+            inline auto operator[](
+                    int index) -> Layer & {
+                return *layers[index];
+            }
+
+
+            // Drops the cache, e.g. after drawing into a layer's pixels without calling Touch.
+            inline auto Invalidate() -> Compositor & {
+                cached_count = 0;
+
+                return *this;
+            }
+
+
+            [[maybe_unused]]
+            inline auto Flatten(
+                    Canvas & dst,
+                    uint32_t background = 0) -> decltype(dst) {
+                const auto plan = Plan(dst, background);
+                const auto band_height = BandHeight(dst);
+
+                for (auto top = 0; top < dst.Height; top += band_height) {
+                    FlattenBand(dst, background, plan, top, std::min(band_height, dst.Height - top));
+                }
+
+                return Finish(dst, background, plan);
+            }
+
+
+            [[maybe_unused]]
+            inline auto Flatten(
+                    parallel::WorkerPool & pool,
+                    Canvas & dst,
+                    uint32_t background = 0) -> decltype(dst) {
+                const auto plan = Plan(dst, background);
+                const auto band_height = BandHeight(dst);
+
+                pool.Run((dst.Height + band_height - 1) / band_height, [&](int band) {
+                    const auto top = band * band_height;
+                    FlattenBand(dst, background, plan, top, std::min(band_height, dst.Height - top));
+                });
+
+                return Finish(dst, background, plan);
+            }
+
+
+        private:
+            // Layers [First, Cached) are flattened into the cache on top of what it holds, or over the background
+            // when First is negative; layers [Cached, count) go straight into the destination.
+            struct Work {
+                int First{ 0 };
+                int Cached{ 0 };
+            };
+
+
+            [[nodiscard]]
+            static auto BandHeight(
+                    const Canvas & dst) -> int {
+                return std::max(1, BAND_BYTES / std::max(1, static_cast<int>(sizeof(uint32_t)) * dst.Width));
+            }
+
+
+            [[nodiscard]]
+            inline auto Plan(
+                    const Canvas & dst,
+                    uint32_t background) -> Work {
+                const auto count = LayerCount();
+
+                auto unchanged = 0;
+                while (unchanged < count
+                       and unchanged < static_cast<int>(states.size())
+                       and states[unchanged].Matches(*layers[unchanged])) {
+                    unchanged += 1;
+                }
+
+                // An empty cache holds nothing to extend, so it is rebuilt from the background
+                const auto valid = cached_count > 0 and cached_count <= unchanged
+                                   and cache.Width() == dst.Width and cache.Height() == dst.Height
+                                   and cached_background == background;
+
+                if (unchanged and (cache.Width() != dst.Width or cache.Height() != dst.Height)) {
+                    cache = utility::AlignedPixelBuffer(dst.Width, dst.Height, utility::Initialization::Uninitialized);
+                }
+
+                return { valid ? cached_count : -1, unchanged };
+            }
+
+
+            inline auto FlattenBand(
+                    Canvas & dst,
+                    uint32_t background,
+                    const Work & work,
+                    int top,
+                    int rows) const -> void {
+                // Under CHERRY_CLIP_BOUNDS only the visible part of the band is written, while the cache is rebuilt whole
+                auto out = dst.View(0, top, dst.Width, rows);
+                const auto area = out.Bounds();
+
+                if (work.Cached) {
+                    auto cached = Canvas(cache.Data() + cache.Stride() * top, dst.Width, rows, cache.Stride());
+
+                    if (work.First < 0) {
+                        Fill(cached, background);
+                    }
+                    for (auto i = std::max(work.First, 0); i < work.Cached; i += 1) {
+                        layers[i]->compose(*layers[i], cached, top);
+                    }
+
+                    for (auto y = area.Top; y < area.Bottom; y += 1) {
+                        color::BlendSpan<color::Overwrite>(
+                                out.SpanUnchecked(area.Left, y),
+                                cached.RowUnchecked(y) + area.Left,
+                                area.Width()
+                        );
+                    }
+                }
+                else {
+                    Fill(out, background);
+                }
+
+                for (auto i = work.Cached; i < LayerCount(); i += 1) {
+                    layers[i]->compose(*layers[i], out, top);
+                }
+            }
+
+
+            static auto Fill(
+                    Canvas & band,
+                    uint32_t color) -> void {
+                const auto area = band.Bounds();
+                for (auto y = area.Top; y < area.Bottom; y += 1) {
+                    std::fill_n(band.SpanUnchecked(area.Left, y), area.Width(), color);
+                }
+            }
+
+
+            inline auto Finish(
+                    Canvas & dst,
+                    uint32_t background,
+                    const Work & work) -> decltype(dst) {
+                cached_count = work.Cached;
+                cached_background = background;
+
+                states.resize(layers.size());
+                for (auto i = size_t{ 0 }; i < layers.size(); i += 1) {
+                    const auto & layer = *layers[i];
+                    states[i] = { layer.revision, layer.X, layer.Y, layer.Transform, layer.Opacity, layer.Visible };
+                }
+
+                dst.MarkDirty(dst.Bounds());
+
+                return dst;
+            }
+        };
+    }
+
+
+    namespace io {
+#ifdef CHERRY_HAS_MMAP
+
+
+        // Maps a file of raw 32-bit pixels read-only, rows of stride pixels starting offset bytes in. The pixels are
+        // used in place: nothing is copied and pages are only read when drawn from.
+        class MappedPixels final {
+            void * address{ MAP_FAILED };
+            size_t length{ 0 };
+
+            const uint32_t * data{ nullptr };
+            int width{ 0 };
+            int height{ 0 };
+            int stride{ 0 };
+        public:
+            MappedPixels(
+                    const std::string & path,
+                    int width,
+                    int height,
+                    size_t offset = 0,
+                    int stride = 0)
+                    :
+                    width(width),
+                    height(height),
+                    stride(stride ? stride : width) {
+                const auto fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    throw std::system_error(errno, std::generic_category(), path);
+                }
+
+                struct stat info{};
+                if (::fstat(fd, &info) < 0) {
+                    const auto error = errno;
+                    ::close(fd);
+                    throw std::system_error(error, std::generic_category(), path);
+                }
+
+                length = static_cast<size_t>(info.st_size);
+                const auto required = offset + sizeof(uint32_t) * static_cast<size_t>(this->stride) * height;
+                if (width < 0 or height < 0 or this->stride < width or offset % sizeof(uint32_t) or required > length) {
+                    ::close(fd);
+                    throw std::invalid_argument(path + " does not fit the requested pixel layout");
+                }
+
+                if (length) {
+                    address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                }
+                const auto error = errno;
+                ::close(fd);
+
+                if (length and MAP_FAILED == address) {
+                    throw std::system_error(error, std::generic_category(), path);
+                }
+
+                if (length) {
+                    data = reinterpret_cast<const uint32_t *>(static_cast<const uint8_t *>(address) + offset);
+                }
+            }
+
+
+            MappedPixels(const MappedPixels &) = delete;
+
+            auto operator=(const MappedPixels &) -> MappedPixels & = delete;
+
+
+            ~MappedPixels() {
+                if (MAP_FAILED != address) {
+                    ::munmap(address, length);
+                }
+            }
+
+
+            [[nodiscard]]
+            inline auto View() const -> ConstCanvas {
+                return { data, width, height, stride };
+            }
+        };
+
+
+#endif // CHERRY_HAS_MMAP
+
+
+        enum class Format {
+            Raw,
+            Bmp,
+            Qoi
+        };
+
+
+        [[nodiscard]]
+        inline auto LoadLittle16(
+                const uint8_t * bytes) -> uint32_t {
+            return bytes[0] | (bytes[1] << 8u);
+        }
+
+
+        [[nodiscard]]
+        inline auto LoadLittle32(
+                const uint8_t * bytes) -> uint32_t {
+            return bytes[0] | (bytes[1] << 8u) | (bytes[2] << 16u) | (static_cast<uint32_t>(bytes[3]) << 24u);
+        }
+
+
+        [[nodiscard]]
+        inline auto LoadBig32(
+                const uint8_t * bytes) -> uint32_t {
+            return (static_cast<uint32_t>(bytes[0]) << 24u) | (bytes[1] << 16u) | (bytes[2] << 8u) | bytes[3];
+        }
+
+
+        inline auto StoreLittle16(
+                uint8_t * bytes,
+                uint32_t value) -> uint8_t * {
+            bytes[0] = value & 0xFF;
+            bytes[1] = (value >> 8u) & 0xFF;
+
+            return bytes + 2;
+        }
+
+
+        inline auto StoreLittle32(
+                uint8_t * bytes,
+                uint32_t value) -> uint8_t * {
+            StoreLittle16(bytes, value);
+            StoreLittle16(bytes + 2, value >> 16u);
+
+            return bytes + 4;
+        }
+
+
+        inline auto StoreBig32(
+                uint8_t * bytes,
+                uint32_t value) -> uint8_t * {
+            bytes[0] = (value >> 24u) & 0xFF;
+            bytes[1] = (value >> 16u) & 0xFF;
+            bytes[2] = (value >> 8u) & 0xFF;
+            bytes[3] = value & 0xFF;
+
+            return bytes + 4;
+        }
+
+
+        inline auto ReadBytes(
+                std::istream & stream,
+                void * data,
+                size_t count,
+                const char * what) -> void {
+            stream.read(static_cast<char *>(data), static_cast<std::streamsize>(count));
+            if (static_cast<size_t>(stream.gcount()) != count) {
+                throw std::runtime_error(std::string("Truncated ") + what);
+            }
+        }
 
-        template<color::BlendType BlendFn>
+
+        inline auto WriteBytes(
+                std::ostream & stream,
+                const void * data,
+                size_t count) -> void {
+            if (not stream.write(static_cast<const char *>(data), static_cast<std::streamsize>(count))) {
+                throw std::runtime_error("Failed to write image data");
+            }
+        }
+
+
+        // Images are decoded from the canvas origin, so under CHERRY_CLIP_BOUNDS a view hanging off the top or left
+        // edge cannot take one.
+        inline auto CheckDestination(
+                const Canvas & dst,
+                int width,
+                int height) -> void {
+            const auto bounds = dst.Bounds();
+            if (bounds.Left > 0 or bounds.Top > 0) {
+                throw std::invalid_argument("Cannot read an image into a canvas view clipped at its top or left edge");
+            }
+            if (dst.Width < width or dst.Height < height) {
+                throw std::invalid_argument(
+                        "Image of size (" + std::to_string(width) + ", " + std::to_string(height)
+                        + ") does not fit a canvas of size (" + std::to_string(dst.Width) + ", "
+                        + std::to_string(dst.Height) + ")"
+                );
+            }
+        }
+
+
+        // Reads dst.Height rows of dst.Width native 32-bit pixels, as written by WriteRaw or mapped by MappedPixels,
+        // straight into the rows of dst.
         [[maybe_unused]]
-        inline auto Copy(
-                const Canvas & src,
-                Canvas & dst,
-                int x0,
-                int y0,
-                int u0,
-                int v0,
-                float rotation,
-                FixedPoint scale_x,
-                FixedPoint scale_y) -> decltype(dst) {
-            const auto sin = std::sin(rotation);
-            const auto cos = std::cos(rotation);
+        inline auto ReadRaw(
+                std::istream & stream,
+                Canvas & dst) -> decltype(dst) {
+            CheckDestination(dst, dst.Width, dst.Height);
+
+            for (auto y = 0; y < dst.Height; y += 1) {
+                ReadBytes(stream, dst.RowUnchecked(y), sizeof(uint32_t) * dst.Width, "raw pixel data");
+            }
+
+            return dst;
+        }
 
-            const auto src_left = -u0 * scale_x;
-            const auto src_top = -v0 * scale_y;
-            const auto src_right = src_left + src.Width * scale_x;
-            const auto src_bottom = src_top + src.Height * scale_y;
 
-            const auto[ax, ay] = ApplyRotation(src_left, src_top, sin, cos);
-            const auto[bx, by] = ApplyRotation(src_right, src_top, sin, cos);
-            const auto[cx, cy] = ApplyRotation(src_right, src_bottom, sin, cos);
-            const auto[dx, dy] = ApplyRotation(src_left, src_bottom, sin, cos);
+        [[maybe_unused]]
+        inline auto WriteRaw(
+                std::ostream & stream,
+                const ConstCanvas & src) -> void {
+            for (auto y = 0; y < src.Height; y += 1) {
+                WriteBytes(stream, src.RowUnchecked(y), sizeof(uint32_t) * src.Width);
+            }
+        }
 
-            auto[min_x, max_x] = std::minmax({ ax, bx, cx, dx });
-            min_x += x0;
-            max_x += x0;
 
-            auto[min_y, max_y] = std::minmax({ ay, by, cy, dy });
-            min_y += y0;
-            max_y += y0;
+        // Parses the headers of an uncompressed 24- or 32-bit BMP on construction; Read then decodes the pixels in
+        // place in the rows of dst, which must be at least Width() x Height(). 32-bit images honour their channel
+        // masks, so alpha survives when the file declares one and reads as opaque otherwise.
+        class BmpReader final {
+            struct Channel {
+                uint32_t Mask{ 0 };
+                uint32_t Shift{ 0 };
+                uint32_t Max{ 0 };
 
-            const auto start_y = std::max(min_y, 0);
-            const auto end_y = std::min(max_y, dst.Height);
 
-            const auto start_x = std::max(min_x, 0);
-            const auto end_x = std::min(max_x, dst.Width);
+                [[nodiscard]]
+                inline auto operator()(
+                        uint32_t value) const -> uint32_t {
+                    if (not Mask) {
+                        return 0xFF;
+                    }
 
-            constexpr auto transparent = color::FromRGBA(0xFF, 0xFF, 0xFF, 0x00);
+                    const auto channel = (value & Mask) >> Shift;
+                    return 0xFF == Max ? channel : (channel * 0xFF + Max / 2) / Max;
+                }
+            };
 
-            for (auto y = start_y; y < end_y; y += 1) {
-                for (auto x = start_x; x < end_x; x += 1) {
-                    auto[u, v] = ApplyRotation(x - x0, y - y0, -sin, cos);
 
-                    u = u0 + u / scale_x;
-                    v = v0 + v / scale_y;
+            std::istream & stream;
+            int width{ 0 };
+            int height{ 0 };
+            int bits{ 0 };
+            bool bottom_up{ true };
+            std::array<Channel, 4> channels{};
+        public:
+            explicit BmpReader(
+                    std::istream & stream)
+                    :
+                    stream(stream) {
+                constexpr auto file_header_size = 14u;
+                constexpr auto max_info_size = 124u;
+
+                auto header = std::array<uint8_t, file_header_size + max_info_size + 16>{};
+                ReadBytes(stream, header.data(), file_header_size + 4, "BMP header");
+
+                if ('B' != header[0] or 'M' != header[1]) {
+                    throw std::invalid_argument("Not a BMP image");
+                }
+
+                const auto pixel_offset = LoadLittle32(&header[10]);
+                const auto info_size = LoadLittle32(&header[14]);
+                if (40 != info_size and 52 != info_size and 56 != info_size and 108 != info_size and 124 != info_size) {
+                    throw std::invalid_argument("Unsupported BMP header size " + std::to_string(info_size));
+                }
+
+                auto consumed = file_header_size + info_size;
+                ReadBytes(stream, &header[file_header_size + 4], info_size - 4, "BMP header");
+
+                auto * info = &header[file_header_size];
+                const auto signed_height = static_cast<int32_t>(LoadLittle32(info + 8));
+                const auto compression = LoadLittle32(info + 16);
+
+                // Negated in 64 bits, since a malformed height of INT32_MIN has no positive int32 counterpart
+                const auto abs_height = std::abs(static_cast<int64_t>(signed_height));
+
+                width = static_cast<int32_t>(LoadLittle32(info + 4));
+                bits = static_cast<int>(LoadLittle16(info + 14));
+                bottom_up = signed_height > 0;
+
+                if (width <= 0 or 0 == abs_height or width * abs_height > std::numeric_limits<int>::max()) {
+                    throw std::invalid_argument("Invalid BMP size");
+                }
+                height = static_cast<int>(abs_height);
+                if (24 != bits and 32 != bits) {
+                    throw std::invalid_argument("Unsupported BMP bit depth " + std::to_string(bits));
+                }
+
+                auto masks = std::array<uint32_t, 4>{ 0x00FF0000u, 0x0000FF00u, 0x000000FFu, 0 };
+
+                constexpr auto BI_RGB = 0u;
+                constexpr auto BI_BITFIELDS = 3u;
+                constexpr auto BI_ALPHABITFIELDS = 6u;
+
+                if ((BI_BITFIELDS == compression or BI_ALPHABITFIELDS == compression) and 32 == bits) {
+                    const auto mask_count = BI_ALPHABITFIELDS == compression or info_size >= 56 ? 4u : 3u;
+                    if (40 == info_size) {
+                        ReadBytes(stream, info + info_size, 4 * mask_count, "BMP channel masks");
+                        consumed += 4 * mask_count;
+                    }
+
+                    for (auto i = 0u; i < mask_count; i += 1) {
+                        masks[i] = LoadLittle32(info + 40 + 4 * i);
+                    }
+                }
+                else if (BI_RGB != compression) {
+                    throw std::invalid_argument("Unsupported BMP compression " + std::to_string(compression));
+                }
+
+                for (auto i = 0u; i < masks.size(); i += 1) {
+                    auto & channel = channels[i];
+                    channel.Mask = masks[i];
+                    if (not channel.Mask) {
+                        continue;
+                    }
+
+                    while (not ((channel.Mask >> channel.Shift) & 1u)) {
+                        channel.Shift += 1;
+                    }
+                    channel.Max = channel.Mask >> channel.Shift;
+                }
 
-                    dst.BlendPixel<BlendFn>(x, y, src.IsWithinBounds(u, v) ? src.Pixel(u, v) : transparent);
+                if (pixel_offset < consumed) {
+                    throw std::invalid_argument("Invalid BMP pixel data offset");
                 }
+                stream.ignore(pixel_offset - consumed);
             }
 
-            return dst;
-        }
 
+            [[nodiscard]]
+            inline auto Width() const -> int {
+                return width;
+            }
 
-        struct Transform {
-            float RotationRadians{ 0.0f };
 
-            int OriginX{ 0 };
-            int OriginY{ 0 };
+            [[nodiscard]]
+            inline auto Height() const -> int {
+                return height;
+            }
 
-            float ScaleX{ 1.0f };
-            float ScaleY{ 1.0f };
+
+            inline auto Read(
+                    Canvas & dst) const -> decltype(dst) {
+                CheckDestination(dst, width, height);
+
+                const auto pixel_bytes = static_cast<size_t>(bits / 8) * width;
+                const auto padding = static_cast<std::streamsize>((4 - pixel_bytes % 4) % 4);
+
+                for (auto i = 0; i < height; i += 1) {
+                    auto * row = dst.RowUnchecked(bottom_up ? height - 1 - i : i);
+                    const auto * bytes = reinterpret_cast<const uint8_t *>(row);
+
+                    ReadBytes(stream, row, pixel_bytes, "BMP pixel data");
+                    stream.ignore(padding);
+
+                    // The file row is read into the front of the canvas row and widened in place, so 24-bit rows are
+                    // expanded from the back to never overwrite bytes that are still to be read.
+                    if (24 == bits) {
+                        for (auto x = width - 1; x >= 0; x -= 1) {
+                            const auto * pixel = bytes + 3 * x;
+                            row[x] = color::FromRGBA(pixel[2], pixel[1], pixel[0]);
+                        }
+                    }
+                    else {
+                        for (auto x = 0; x < width; x += 1) {
+                            const auto value = LoadLittle32(bytes + 4 * x);
+                            row[x] = color::FromRGBA(
+                                    channels[0](value),
+                                    channels[1](value),
+                                    channels[2](value),
+                                    channels[3](value)
+                            );
+                        }
+                    }
+                }
+
+                return dst;
+            }
         };
 
 
-        template<color::BlendType BlendFn>
-        [[maybe_unused]]
-        inline auto Copy(
-                const Canvas & src,
-                Canvas & dst,
-                int x0 = 0,
-                int y0 = 0,
-                const Transform & tf = {}) -> decltype(dst) {
-            if (0.0f == tf.RotationRadians) {
-                const auto scale_x = FixedPoint{ tf.ScaleX };
-                const auto scale_y = FixedPoint{ tf.ScaleY };
+        // Streams a top-down 32-bit BMP with an alpha mask: the headers go out on construction and every Write appends
+        // the rows of a canvas of the declared width, so a banded renderer can hand its bands straight over.
+        class BmpWriter final {
+            std::ostream & stream;
+            int width;
+            int rows_left;
+            std::vector<uint8_t> row_bytes;
+        public:
+            BmpWriter(
+                    std::ostream & stream,
+                    int width,
+                    int height)
+                    :
+                    stream(stream),
+                    width(width),
+                    rows_left(height),
+                    row_bytes(sizeof(uint32_t) * std::max(width, 0)) {
+                if (width <= 0 or height <= 0) {
+                    throw std::invalid_argument("Invalid BMP size");
+                }
 
-                return Copy<BlendFn>(
-                        src,
-                        dst,
-                        x0 - tf.OriginX * scale_x,
-                        y0 - tf.OriginY * scale_y,
-                        x0 + (src.Width - tf.OriginX) * scale_x,
-                        y0 + (src.Height - tf.OriginY) * scale_y
-                );
+                constexpr auto file_header_size = 14u;
+                constexpr auto info_size = 108u;
+                constexpr auto BI_BITFIELDS = 3u;
+                constexpr auto LCS_SRGB = 0x73524742u;
+
+                const auto image_size = static_cast<uint64_t>(row_bytes.size()) * height;
+                if (file_header_size + info_size + image_size > std::numeric_limits<uint32_t>::max()) {
+                    throw std::invalid_argument("Image is too large for a BMP file");
+                }
+
+                auto header = std::array<uint8_t, file_header_size + info_size>{};
+                header[0] = 'B';
+                header[1] = 'M';
+                StoreLittle32(&header[2], static_cast<uint32_t>(file_header_size + info_size + image_size));
+                StoreLittle32(&header[10], file_header_size + info_size);
+
+                auto * info = &header[file_header_size];
+                StoreLittle32(info, info_size);
+                StoreLittle32(info + 4, static_cast<uint32_t>(width));
+                StoreLittle32(info + 8, static_cast<uint32_t>(-height));
+                StoreLittle16(info + 12, 1);
+                StoreLittle16(info + 14, 32);
+                StoreLittle32(info + 16, BI_BITFIELDS);
+                StoreLittle32(info + 20, static_cast<uint32_t>(image_size));
+                StoreLittle32(info + 40, 0x00FF0000u);
+                StoreLittle32(info + 44, 0x0000FF00u);
+                StoreLittle32(info + 48, 0x000000FFu);
+                StoreLittle32(info + 52, 0xFF000000u);
+                StoreLittle32(info + 56, LCS_SRGB);
+
+                WriteBytes(stream, header.data(), header.size());
             }
 
-            if (1.0f == tf.ScaleX and 1.0f == tf.ScaleY) {
-                return Copy<BlendFn>(
-                        src,
-                        dst,
-                        x0, y0,
-                        tf.OriginX, tf.OriginY,
-                        tf.RotationRadians
-                );
+
+            inline auto Write(
+                    const ConstCanvas & rows) -> BmpWriter & {
+                if (rows.Width != width or rows.Height > rows_left) {
+                    throw std::invalid_argument("Rows do not fit the BMP being written");
+                }
+
+                for (auto y = 0; y < rows.Height; y += 1) {
+                    const auto * row = rows.RowUnchecked(y);
+                    for (auto x = 0; x < width; x += 1) {
+                        const auto [red, green, blue, alpha] = color::ToRGBA(row[x]);
+                        StoreLittle32(&row_bytes[4 * x], (static_cast<uint32_t>(alpha) << 24u) | (red << 16u) | (green << 8u) | blue);
+                    }
+
+                    WriteBytes(stream, row_bytes.data(), row_bytes.size());
+                }
+                rows_left -= rows.Height;
+
+                return *this;
             }
+        };
 
-            return Copy<BlendFn>(
-                    src,
-                    dst,
-                    x0, y0,
-                    tf.OriginX, tf.OriginY,
-                    tf.RotationRadians,
-                    FixedPoint{ tf.ScaleX },
-                    FixedPoint{ tf.ScaleY }
-            );
+
+        [[maybe_unused]]
+        inline auto WriteBmp(
+                std::ostream & stream,
+                const ConstCanvas & src) -> void {
+            BmpWriter(stream, src.Width, src.Height).Write(src);
         }
-    }
 
 
-    namespace drawing {
-        template<color::BlendType BlendFn>
-        inline auto LineLow(
-                Canvas & canvas,
-                int x0,
-                int y0,
-                int x1,
-                int y1,
-                uint32_t color) -> void {
-            const auto dx = x1 - x0;
-            const auto[dy, yi] = ((y1 - y0) >= 0) ? std::pair(y1 - y0, 1) : std::pair(y0 - y1, -1);
+        // QOI, the "Quite OK Image" format: lossless, byte oriented, and encodes and decodes in a single pass.
+        namespace qoi {
+            constexpr auto HEADER_SIZE = 14u;
+            constexpr auto INDEX_SIZE = 64u;
+            constexpr auto MAX_RUN = 62u;
+
+            constexpr auto OP_INDEX = 0x00u;
+            constexpr auto OP_DIFF = 0x40u;
+            constexpr auto OP_LUMA = 0x80u;
+            constexpr auto OP_RUN = 0xC0u;
+            constexpr auto OP_RGB = 0xFEu;
+            constexpr auto OP_RGBA = 0xFFu;
+            constexpr auto MASK_OP = 0xC0u;
+
+            constexpr auto END_MARKER = std::array<uint8_t, 8>{ 0, 0, 0, 0, 0, 0, 0, 1 };
+
 
-            auto D = 2 * dy - dx;
-            auto y = y0;
+            [[nodiscard]]
+            constexpr inline auto Hash(
+                    uint32_t red,
+                    uint32_t green,
+                    uint32_t blue,
+                    uint32_t alpha) -> uint32_t {
+                return (red * 3 + green * 5 + blue * 7 + alpha * 11) % INDEX_SIZE;
+            }
+        }
 
-            for (auto x = x0; x <= x1; x += 1) {
-                canvas.BlendPixel<BlendFn>(x, y, color);
 
-                if (D > 0) {
-                    y += yi;
-                    D += 2 * (dy - dx);
+        // Parses a QOI header on construction; Read then decodes the pixel stream straight into the rows of dst,
+        // which must be at least Width() x Height().
+        class QoiReader final {
+            std::istream & stream;
+            int width{ 0 };
+            int height{ 0 };
+        public:
+            explicit QoiReader(
+                    std::istream & stream)
+                    :
+                    stream(stream) {
+                auto header = std::array<uint8_t, qoi::HEADER_SIZE>{};
+                ReadBytes(stream, header.data(), header.size(), "QOI header");
+
+                if (0 != std::memcmp(header.data(), "qoif", 4)) {
+                    throw std::invalid_argument("Not a QOI image");
                 }
-                else {
-                    D += 2 * dy;
+
+                const auto image_width = LoadBig32(&header[4]);
+                const auto image_height = LoadBig32(&header[8]);
+                if (not image_width or not image_height
+                    or static_cast<uint64_t>(image_width) * image_height > std::numeric_limits<int>::max()
+                    or (3 != header[12] and 4 != header[12]) or header[13] > 1) {
+                    throw std::invalid_argument("Invalid QOI header");
                 }
+
+                width = static_cast<int>(image_width);
+                height = static_cast<int>(image_height);
             }
-        }
 
 
-        template<color::BlendType BlendFn>
-        inline auto LineHigh(
-                Canvas & canvas,
-                int x0,
-                int y0,
-                int x1,
-                int y1,
-                uint32_t color) -> void {
-            const auto[dx, xi] = ((x1 - x0) >= 0) ? std::pair(x1 - x0, 1) : std::pair(x0 - x1, -1);
-            const auto dy = y1 - y0;
+            [[nodiscard]]
+            inline auto Width() const -> int {
+                return width;
+            }
+
+
+            [[nodiscard]]
+            inline auto Height() const -> int {
+                return height;
+            }
 
-            auto D = 2 * dx - dy;
-            auto x = x0;
 
-            for (auto y = y0; y <= y1; y += 1) {
-                canvas.BlendPixel<BlendFn>(x, y, color);
+            inline auto Read(
+                    Canvas & dst) const -> decltype(dst) {
+                CheckDestination(dst, width, height);
 
-                if (D > 0) {
-                    x += xi;
-                    D += 2 * (dx - dy);
+                auto & buffer = *stream.rdbuf();
+                const auto next = [&]() -> uint32_t {
+                    const auto byte = buffer.sbumpc();
+                    if (std::char_traits<char>::eof() == byte) {
+                        throw std::runtime_error("Truncated QOI pixel data");
+                    }
+
+                    return static_cast<uint8_t>(byte);
+                };
+
+                auto index = std::array<uint32_t, qoi::INDEX_SIZE>{};
+                auto red = 0u;
+                auto green = 0u;
+                auto blue = 0u;
+                auto alpha = 0xFFu;
+                auto run = 0u;
+
+                for (auto y = 0; y < height; y += 1) {
+                    auto * row = dst.RowUnchecked(y);
+
+                    for (auto x = 0; x < width; x += 1) {
+                        if (run) {
+                            run -= 1;
+                            row[x] = color::FromRGBA(red, green, blue, alpha);
+                            continue;
+                        }
+
+                        const auto op = next();
+                        if (qoi::OP_RGB == op) {
+                            red = next();
+                            green = next();
+                            blue = next();
+                        }
+                        else if (qoi::OP_RGBA == op) {
+                            red = next();
+                            green = next();
+                            blue = next();
+                            alpha = next();
+                        }
+                        else if (qoi::OP_INDEX == (op & qoi::MASK_OP)) {
+                            std::tie(red, green, blue, alpha) = color::ToRGBA(index[op]);
+                        }
+                        else if (qoi::OP_DIFF == (op & qoi::MASK_OP)) {
+                            red = (red + ((op >> 4u) & 3u) - 2) & 0xFF;
+                            green = (green + ((op >> 2u) & 3u) - 2) & 0xFF;
+                            blue = (blue + (op & 3u) - 2) & 0xFF;
+                        }
+                        else if (qoi::OP_LUMA == (op & qoi::MASK_OP)) {
+                            const auto second = next();
+                            const auto green_delta = (op & 0x3Fu) - 32;
+                            red = (red + green_delta - 8 + ((second >> 4u) & 0x0F)) & 0xFF;
+                            green = (green + green_delta) & 0xFF;
+                            blue = (blue + green_delta - 8 + (second & 0x0F)) & 0xFF;
+                        }
+                        else {
+                            run = op & 0x3Fu;
+                        }
+
+                        const auto pixel = color::FromRGBA(red, green, blue, alpha);
+                        index[qoi::Hash(red, green, blue, alpha)] = pixel;
+                        row[x] = pixel;
+                    }
                 }
-                else {
-                    D += 2 * dx;
+
+                stream.ignore(qoi::END_MARKER.size());
+
+                return dst;
+            }
+        };
+
+
+        // Streams a QOI image: the header goes out on construction, every Write encodes the rows of a canvas of the
+        // declared width, continuing runs and the colour index across calls, and Finish writes the end marker once
+        // all rows are in.
+        class QoiWriter final {
+            static constexpr auto CHUNK_SIZE = 4096u;
+            static constexpr auto MAX_OP_SIZE = 5u;
+
+
+            std::ostream & stream;
+            int width;
+            int rows_left;
+
+            std::array<uint32_t, qoi::INDEX_SIZE> index{};
+            uint32_t previous{ color::FromRGBA(0, 0, 0, 0xFF) };
+            uint32_t run{ 0 };
+
+            std::array<uint8_t, CHUNK_SIZE> chunk{};
+            uint8_t * out{ chunk.data() };
+        public:
+            QoiWriter(
+                    std::ostream & stream,
+                    int width,
+                    int height)
+                    :
+                    stream(stream),
+                    width(width),
+                    rows_left(height) {
+                if (width <= 0 or height <= 0) {
+                    throw std::invalid_argument("Invalid QOI size");
                 }
+
+                constexpr auto channels = 4u;
+                constexpr auto colorspace_srgb = 0u;
+
+                auto header = std::array<uint8_t, qoi::HEADER_SIZE>{ 'q', 'o', 'i', 'f' };
+                StoreBig32(&header[4], static_cast<uint32_t>(width));
+                StoreBig32(&header[8], static_cast<uint32_t>(height));
+                header[12] = channels;
+                header[13] = colorspace_srgb;
+
+                WriteBytes(stream, header.data(), header.size());
             }
-        }
 
 
-        template<color::BlendType BlendFn>
-        [[maybe_unused]]
-        inline auto Line(
-                Canvas & canvas,
-                int x0,
-                int y0,
-                int x1,
-                int y1,
-                uint32_t color) -> decltype(canvas) {
-            if (std::abs(y1 - y0) < std::abs(x1 - x0)) {
-                if (x0 > x1) {
-                    LineLow<BlendFn>(canvas, x1, y1, x0, y0, color);
+            QoiWriter(const QoiWriter &) = delete;
+
+            auto operator=(const QoiWriter &) -> QoiWriter & = delete;
+
+
+            inline auto Write(
+                    const ConstCanvas & rows) -> QoiWriter & {
+                if (rows.Width != width or rows.Height > rows_left) {
+                    throw std::invalid_argument("Rows do not fit the QOI image being written");
                 }
-                else {
-                    LineLow<BlendFn>(canvas, x0, y0, x1, y1, color);
+
+                for (auto y = 0; y < rows.Height; y += 1) {
+                    const auto * row = rows.RowUnchecked(y);
+
+                    for (auto x = 0; x < width; x += 1) {
+                        const auto pixel = row[x];
+                        if (pixel == previous) {
+                            run += 1;
+                            if (qoi::MAX_RUN == run) {
+                                FlushRun();
+                            }
+                            continue;
+                        }
+
+                        FlushRun();
+                        Encode(pixel);
+                        previous = pixel;
+                    }
                 }
+                rows_left -= rows.Height;
+
+                return *this;
             }
-            else {
-                if (y0 > y1) {
-                    LineHigh<BlendFn>(canvas, x1, y1, x0, y0, color);
+
+
+            inline auto Finish() -> void {
+                if (rows_left) {
+                    throw std::logic_error("QOI image finished before all rows were written");
+                }
+
+                FlushRun();
+                Flush();
+                WriteBytes(stream, qoi::END_MARKER.data(), qoi::END_MARKER.size());
+            }
+
+
+        private:
+            inline auto Encode(
+                    uint32_t pixel) -> void {
+                if (out + MAX_OP_SIZE > chunk.data() + chunk.size()) {
+                    Flush();
+                }
+
+                const auto [red, green, blue, alpha] = color::ToRGBA(pixel);
+                const auto hash = qoi::Hash(red, green, blue, alpha);
+
+                if (index[hash] == pixel) {
+                    *out++ = qoi::OP_INDEX | hash;
+                    return;
+                }
+                index[hash] = pixel;
+
+                const auto [previous_red, previous_green, previous_blue, previous_alpha] = color::ToRGBA(previous);
+                if (alpha != previous_alpha) {
+                    *out++ = qoi::OP_RGBA;
+                    *out++ = red;
+                    *out++ = green;
+                    *out++ = blue;
+                    *out++ = alpha;
+                    return;
+                }
+
+                const auto red_delta = static_cast<int8_t>(red - previous_red);
+                const auto green_delta = static_cast<int8_t>(green - previous_green);
+                const auto blue_delta = static_cast<int8_t>(blue - previous_blue);
+                const auto red_green = red_delta - green_delta;
+                const auto blue_green = blue_delta - green_delta;
+
+                if (red_delta >= -2 and red_delta <= 1
+                    and green_delta >= -2 and green_delta <= 1
+                    and blue_delta >= -2 and blue_delta <= 1) {
+                    *out++ = qoi::OP_DIFF | ((red_delta + 2) << 4u) | ((green_delta + 2) << 2u) | (blue_delta + 2);
+                }
+                else if (red_green >= -8 and red_green <= 7
+                         and green_delta >= -32 and green_delta <= 31
+                         and blue_green >= -8 and blue_green <= 7) {
+                    *out++ = qoi::OP_LUMA | (green_delta + 32);
+                    *out++ = ((red_green + 8) << 4u) | (blue_green + 8);
                 }
                 else {
-                    LineHigh<BlendFn>(canvas, x0, y0, x1, y1, color);
+                    *out++ = qoi::OP_RGB;
+                    *out++ = red;
+                    *out++ = green;
+                    *out++ = blue;
                 }
             }
 
 
-            return canvas;
-        }
+            inline auto FlushRun() -> void {
+                if (not run) {
+                    return;
+                }
 
+                if (out + 1 > chunk.data() + chunk.size()) {
+                    Flush();
+                }
 
-        template<color::BlendType BlendFn>
-        [[maybe_unused]]
-        inline auto Polygon(
-                Canvas & canvas,
-                const std::vector<std::pair<int, int>> & vertices,
-                uint32_t color) -> decltype(canvas) {
-            if (vertices.empty()) {
-                return canvas;
+                *out++ = qoi::OP_RUN | (run - 1);
+                run = 0;
             }
 
-            for (auto i = decltype(vertices.size()){ 0 }; i < vertices.size(); i += 1) {
-                const auto[x0, y0] = vertices[i % vertices.size()];
-                const auto[x1, y1] = vertices[(i + 1) % vertices.size()];
 
-                Line<BlendFn>(canvas, x0, y0, x1, y1, color);
+            inline auto Flush() -> void {
+                WriteBytes(stream, chunk.data(), out - chunk.data());
+                out = chunk.data();
             }
+        };
 
-            return canvas;
+
+        [[maybe_unused]]
+        inline auto WriteQoi(
+                std::ostream & stream,
+                const ConstCanvas & src) -> void {
+            auto writer = QoiWriter(stream, src.Width, src.Height);
+            writer.Write(src);
+            writer.Finish();
         }
 
 
-        template<color::BlendType BlendFn>
-        inline auto FillFlatTriangle(
-                Canvas & canvas,
-                int x0,
-                int y0,
-                int x1,
-                int y1,
-                int x2,
-                uint32_t color) -> decltype(canvas) {
-            if (y1 == y0) {
-                return canvas;
-            }
+        template<typename Reader>
+        [[nodiscard]]
+        inline auto Decode(
+                std::istream & stream) -> utility::AlignedPixelBuffer {
+            const auto reader = Reader(stream);
+
+            auto buffer = utility::AlignedPixelBuffer(reader.Width(), reader.Height(), utility::Initialization::Uninitialized);
+            auto canvas = Canvas(buffer);
+            reader.Read(canvas);
+
+            return buffer;
+        }
 
-            const auto dy = y1 > y0 ? 1 : -1;
 
-            if (x2 < x1) {
-                std::swap(x2, x1);
+        // Loads a BMP or QOI file, told apart by their signatures, into a new buffer.
+        [[maybe_unused]]
+        [[nodiscard]]
+        inline auto Load(
+                const std::string & path) -> utility::AlignedPixelBuffer {
+            auto file = std::ifstream(path, std::ios::binary);
+            if (not file) {
+                throw std::runtime_error("Cannot open " + path);
             }
 
-            for (
-                    auto y = std::clamp(y0, 0, canvas.Height - 1);
-                    y != std::clamp(y1 + dy, 0, canvas.Height - 1);
-                    y += dy) {
-                const auto x_left = x0 + (y - y0) * (x1 - x0) / (y1 - y0);
-                const auto x_right = x0 + (y - y0) * (x2 - x0) / (y1 - y0);
+            auto signature = std::array<char, 4>{};
+            file.read(signature.data(), signature.size());
+            file.seekg(0);
 
-                for (auto x = std::max<int>(0, x_left); x < std::min<int>(canvas.Width, x_right + 1); x += 1) {
-                    canvas.BlendPixel<BlendFn>(x, y, color);
-                }
+            if ('B' == signature[0] and 'M' == signature[1]) {
+                return Decode<BmpReader>(file);
             }
-            return canvas;
+            if (0 == std::memcmp(signature.data(), "qoif", 4)) {
+                return Decode<QoiReader>(file);
+            }
+
+            throw std::invalid_argument(path + " is neither a BMP nor a QOI image");
         }
 
 
-        template<color::BlendType BlendFn>
         [[maybe_unused]]
-        inline auto FillTriangle(
-                Canvas & canvas,
-                int x0,
-                int y0,
-                int x1,
-                int y1,
-                int x2,
-                int y2,
-                uint32_t color) -> decltype(canvas) {
-            if (y0 > y1) {
-                std::swap(x0, x1);
-                std::swap(y0, y1);
+        inline auto Save(
+                const std::string & path,
+                const ConstCanvas & src,
+                Format format) -> void {
+            auto file = std::ofstream(path, std::ios::binary);
+            if (not file) {
+                throw std::runtime_error("Cannot open " + path);
             }
 
-            if (y0 > y2) {
-                std::swap(x0, x2);
-                std::swap(y0, y2);
+            switch (format) {
+                case Format::Raw:
+                    WriteRaw(file, src);
+                    break;
+                case Format::Bmp:
+                    WriteBmp(file, src);
+                    break;
+                case Format::Qoi:
+                    WriteQoi(file, src);
+                    break;
             }
 
-            if (y1 > y2) {
-                std::swap(x1, x2);
-                std::swap(y1, y2);
-            }
-
-            if (y1 == y2) {
-                return FillFlatTriangle<BlendFn>(canvas, x0, y0, x1, y1, x2, color);
+            if (not file.flush()) {
+                throw std::runtime_error("Failed to write " + path);
             }
-
-            const auto x_intermediate = x0 + (y1 - y0) * (x2 - x0) / (y2 - y0);
-
-            FillFlatTriangle<BlendFn>(canvas, x0, y0, x1, y1, x_intermediate, color);
-            FillFlatTriangle<BlendFn>(canvas, x2, y2, x1, y1 + 1, x_intermediate, color);
-
-            return canvas;
         }
     }
 }
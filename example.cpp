@@ -4,6 +4,8 @@
 #include <iostream>
 #include <chrono>
 #include <iomanip>
+#include <thread>
+#include <type_traits>
 
 #include "SFML/Graphics.hpp"
 
@@ -13,9 +15,16 @@
 #include "cherry.hpp"
 
 
+// Frames are handed to sf::Texture::update as they are, and SFML reads them as RGBA bytes
+static_assert(
+        std::is_same_v<cherry::color::PixelLayout, cherry::color::RGBA>,
+        "simple_example uploads canvases to SFML as is, so it must be built with CHERRY_PIXEL_LAYOUT=RGBA"
+);
+
+
 auto FunkyTree(
         cherry::Canvas & canvas,
-        const cherry::Canvas & tree,
+        const cherry::transform::MipChain & tree,
         float time_s) -> void {
     const auto left = canvas.Width / 2;
     const auto top = canvas.Height / 2;
@@ -34,22 +43,33 @@ auto FunkyTree(
 
 
 auto Gradient(cherry::Canvas & canvas) -> void {
-    for (auto y = decltype(canvas.Height){ 0 }; y < canvas.Height; y += 1) {
-        for (auto x = decltype(canvas.Width){ 0 }; x < canvas.Width; x += 1) {
-            const auto t = static_cast<uint8_t>((255.0 * (x + y)) / (canvas.Width + canvas.Height));
-            canvas.BlendPixel<cherry::color::FastAlphaBlend>(x, y, cherry::color::FromRGBA(t, 128 - t / 2, 192, 192));
-        }
-    }
+    const auto extent = static_cast<float>(canvas.Width + canvas.Height) / 2.0f;
+
+    cherry::drawing::FillRect<cherry::color::FastAlphaBlend>(
+            canvas,
+            { 0, 0, canvas.Width, canvas.Height },
+            cherry::drawing::LinearGradient{
+                    .X1 = extent,
+                    .Y1 = extent,
+                    .Ramp = { cherry::color::FromRGBA(0, 128, 192, 192), cherry::color::FromRGBA(255, 0, 192, 192) }
+            }
+    );
 }
 
 
 auto CheckeredBackground(cherry::Canvas & canvas) -> void {
+    constexpr auto square = 25;
+
     const auto white = cherry::color::FromRGBA(255, 255, 255, 128);
     const auto gray = cherry::color::FromRGBA(192, 192, 192, 128);
 
-    for (auto y = decltype(canvas.Height){ 0 }; y < canvas.Height; y += 1) {
-        for (auto x = decltype(canvas.Width){ 0 }; x < canvas.Width; x += 1) {
-            canvas.BlendPixel<cherry::color::Overwrite>(x, y, (x / 25 + y / 25) % 2 ? white : gray);
+    for (auto y = 0; y < canvas.Height; y += square) {
+        for (auto x = 0; x < canvas.Width; x += square) {
+            cherry::drawing::FillRect<cherry::color::Overwrite>(
+                    canvas,
+                    { x, y, x + square, y + square },
+                    (x / square + y / square) % 2 ? white : gray
+            );
         }
     }
 }
@@ -75,145 +95,170 @@ auto TreeBenchmark(std::chrono::seconds benchmark_duration) -> void {
     CheckeredBackground(background);
     Gradient(background);
 
-    auto canvas_data = cherry::utility::PixelBuffer(width, height);
-    auto canvas = cherry::Canvas(canvas_data.data(), width, height);
-
-    auto img = sf::Image();
-    img.loadFromFile(std::string("../blue_tree.bmp"));
-    auto blue_tree_data = cherry::utility::PixelBuffer(
-            img.getPixelsPtr(),
-            static_cast<int>(img.getSize().x),
-            static_cast<int>(img.getSize().y)
-    );
-    const auto blue_tree = cherry::Canvas(
-            reinterpret_cast<uint32_t *>(blue_tree_data.data()),
-            static_cast<int>(img.getSize().x),
-            static_cast<int>(img.getSize().y)
-    );
+    auto blue_tree_image = cherry::io::Load("../blue_tree.bmp");
+    const auto blue_tree = cherry::ConstCanvas(blue_tree_image);
 
-    img.loadFromFile(std::string("../red_tree.bmp"));
-    auto red_tree_data = cherry::utility::PixelBuffer(
-            img.getPixelsPtr(),
-            static_cast<int>(img.getSize().x),
-            static_cast<int>(img.getSize().y)
-    );
-    const auto red_tree = cherry::Canvas(
-            reinterpret_cast<uint32_t *>(red_tree_data.data()),
-            static_cast<int>(img.getSize().x),
-            static_cast<int>(img.getSize().y)
-    );
+    auto red_tree_image = cherry::io::Load("../red_tree.bmp");
+    const auto red_tree = cherry::ConstCanvas(red_tree_image);
+    const auto red_tree_mips = cherry::transform::MipChain(red_tree);
 
 
     auto texture = sf::Texture();
-    texture.create(canvas.Width, canvas.Height);
+    texture.create(width, height);
 
     auto sprite = sf::Sprite();
     sprite.setTexture(texture);
 
+    // Frames are rendered on their own thread while this one uploads and displays the previous one
+    auto pipeline = cherry::parallel::FramePipeline(width, height);
+
     const auto benchmark_start = std::chrono::steady_clock::now();
     auto frames_rendered = 0;
+    auto frames_presented = 0;
 
     auto render_time_ms = std::chrono::milliseconds{ 0 };
 
+    auto renderer = std::thread([&] {
+        while (const auto frame = pipeline.AcquireRender()) {
+            const auto render_begin = std::chrono::steady_clock::now();
+
+            auto & canvas = frame->Pixels;
+            auto changed = frame->Dirty;
+            frame->Dirty.Clear();
+            cherry::transform::Restore(background, canvas, changed);
+
+            const auto t = Elapsed<std::chrono::milliseconds, float>(benchmark_start) / 1000.0f;
+            cherry::transform::Copy<cherry::color::FastAlphaBlend>(
+                    blue_tree,
+                    canvas,
+                    canvas.Width / 2,
+                    canvas.Height / 2,
+                    {
+                            .RotationRadians = t,
+                            .OriginX = blue_tree.Width / 2,
+                            .OriginY = blue_tree.Height * 7 / 8,
+                            .ScaleX = 0.75f + 0.4f * std::sin(t),
+                            .ScaleY = 0.75f + 0.4f * std::sin(t)
+                    }
+            );
+            FunkyTree(canvas, red_tree_mips, t * 2);
+
+            const auto origin_x = canvas.Width / 2;
+            const auto origin_y = canvas.Height / 2;
+            constexpr auto r = 70;
+            constexpr auto Pi = 3.14159265358979323846;
+
+            cherry::drawing::Polygon<cherry::color::Overwrite>(
+                    canvas,
+                    {
+                            { origin_x + r * std::cos(t + 0 * Pi / 2), origin_y - r * std::sin(t + 0 * Pi / 2) },
+                            { origin_x + r * std::cos(t + 1 * Pi / 2), origin_y - r * std::sin(t + 1 * Pi / 2) },
+                            { origin_x + r * std::cos(t + 2 * Pi / 2), origin_y - r * std::sin(t + 2 * Pi / 2) },
+                            { origin_x + r * std::cos(t + 3 * Pi / 2), origin_y - r * std::sin(t + 3 * Pi / 2) },
+                    },
+                    cherry::color::FromRGBA(0, 0, 0)
+            );
+
+            cherry::drawing::Polygon<cherry::color::Overwrite>(
+                    canvas,
+                    {
+                            {
+                                    origin_x + 2 * r * std::cos(2 * t + 0 * Pi / 2),
+                                    origin_y + 2 * r * std::sin(2 * t + 0 * Pi / 2)
+                            },
+                            {
+                                    origin_x + 2 * r * std::cos(2 * t + 1 * Pi / 2),
+                                    origin_y + 2 * r * std::sin(2 * t + 1 * Pi / 2)
+                            },
+                            {
+                                    origin_x + 2 * r * std::cos(2 * t + 2 * Pi / 2),
+                                    origin_y + 2 * r * std::sin(2 * t + 2 * Pi / 2)
+                            },
+                            {
+                                    origin_x + 2 * r * std::cos(2 * t + 3 * Pi / 2),
+                                    origin_y + 2 * r * std::sin(2 * t + 3 * Pi / 2)
+                            },
+                    },
+                    cherry::color::FromRGBA(0, 0, 0)
+            );
+
+            cherry::drawing::FillTriangle<cherry::color::FastAlphaBlend>(
+                    canvas,
+                    50, 50,
+                    150 + std::lround(400 * std::sin(t * 2)), 180 + std::lround(400 * std::cos(t * 2)),
+                    400, 30,
+                    cherry::color::FromRGBA(192, 164, 255, 128)
+            );
+
+            render_time_ms += Elapsed<std::chrono::milliseconds>(render_begin);
+            frames_rendered += 1;
+
+            pipeline.ReleaseRender();
+        }
+    });
+
+    // The texture starts out undefined, so the first frame is uploaded whole; after that only what this frame or the
+    // previously presented one drew can differ from the texture
+    auto presented = cherry::utility::DirtyRegion();
+    presented.Add({ 0, 0, width, height });
+
     while (window.isOpen()) {
         auto event = sf::Event{};
         while (window.pollEvent(event)) {
             if (sf::Event::Closed == event.type) {
                 window.close();
-                return;
             }
         }
 
         if (Elapsed<decltype(benchmark_duration)>(benchmark_start) > benchmark_duration) {
             window.close();
+        }
+        if (not window.isOpen()) {
             break;
         }
 
-        const auto render_begin = std::chrono::steady_clock::now();
-
-        cherry::transform::Copy<cherry::color::Overwrite>(background, canvas);
-
-        const auto t = Elapsed<std::chrono::milliseconds, float>(benchmark_start) / 1000.0f;
-        cherry::transform::Copy<cherry::color::FastAlphaBlend>(
-                blue_tree,
-                canvas,
-                canvas.Width / 2,
-                canvas.Height / 2,
-                {
-                        .RotationRadians = t,
-                        .OriginX = blue_tree.Width / 2,
-                        .OriginY = blue_tree.Height * 7 / 8,
-                        .ScaleX = 0.75f + 0.4f * std::sin(t),
-                        .ScaleY = 0.75f + 0.4f * std::sin(t)
-                }
-        );
-        FunkyTree(canvas, red_tree, t * 2);
-
-        const auto origin_x = canvas.Width / 2;
-        const auto origin_y = canvas.Height / 2;
-        constexpr auto r = 70;
-        constexpr auto Pi = 3.14159265358979323846;
-
-        cherry::drawing::Polygon<cherry::color::Overwrite>(
-                canvas,
-                {
-                        { origin_x + r * std::cos(t + 0 * Pi / 2), origin_y - r * std::sin(t + 0 * Pi / 2) },
-                        { origin_x + r * std::cos(t + 1 * Pi / 2), origin_y - r * std::sin(t + 1 * Pi / 2) },
-                        { origin_x + r * std::cos(t + 2 * Pi / 2), origin_y - r * std::sin(t + 2 * Pi / 2) },
-                        { origin_x + r * std::cos(t + 3 * Pi / 2), origin_y - r * std::sin(t + 3 * Pi / 2) },
-                },
-                cherry::color::FromRGBA(0, 0, 0)
-        );
-
-        cherry::drawing::Polygon<cherry::color::Overwrite>(
-                canvas,
-                {
-                        {
-                                origin_x + 2 * r * std::cos(2 * t + 0 * Pi / 2),
-                                origin_y + 2 * r * std::sin(2 * t + 0 * Pi / 2)
-                        },
-                        {
-                                origin_x + 2 * r * std::cos(2 * t + 1 * Pi / 2),
-                                origin_y + 2 * r * std::sin(2 * t + 1 * Pi / 2)
-                        },
-                        {
-                                origin_x + 2 * r * std::cos(2 * t + 2 * Pi / 2),
-                                origin_y + 2 * r * std::sin(2 * t + 2 * Pi / 2)
-                        },
-                        {
-                                origin_x + 2 * r * std::cos(2 * t + 3 * Pi / 2),
-                                origin_y + 2 * r * std::sin(2 * t + 3 * Pi / 2)
-                        },
-                },
-                cherry::color::FromRGBA(0, 0, 0)
-        );
-
-        cherry::drawing::FillTriangle<cherry::color::FastAlphaBlend>(
-                canvas,
-                50, 50,
-                150 + std::lround(400 * std::sin(t * 2)), 180 + std::lround(400 * std::cos(t * 2)),
-                400, 30,
-                cherry::color::FromRGBA(192, 164, 255, 128)
-        );
-
-        render_time_ms += Elapsed<std::chrono::milliseconds>(render_begin);
-
-        texture.update(canvas.DataUint8);
+        const auto frame = pipeline.AcquirePresent();
+
+        auto changed = presented;
+        changed.Merge(frame->Dirty);
+        presented = frame->Dirty;
+
+        // sf::Texture::update takes tightly packed rows, while pipeline frames pad each row to the buffer alignment
+        const auto & canvas = frame->Pixels;
+        const auto packed = canvas.Stride == canvas.Width;
+        for (const auto & rect : changed.Rects()) {
+            const auto rows = packed ? rect.Height() : 1;
+            for (auto y = rect.Top; y < rect.Bottom; y += rows) {
+                texture.update(
+                        canvas.DataUint8 + sizeof(uint32_t) * canvas.Stride * y,
+                        static_cast<unsigned>(canvas.Width),
+                        static_cast<unsigned>(rows),
+                        0,
+                        static_cast<unsigned>(y)
+                );
+            }
+        }
+
+        pipeline.ReleasePresent();
 
         window.draw(sprite);
 
         window.display();
-        frames_rendered += 1;
+        frames_presented += 1;
     }
+
+    pipeline.Close();
+    renderer.join();
+
     const auto elapsed_ms_total = Elapsed<std::chrono::milliseconds, double>(benchmark_start);
 
     std::cout << std::fixed << std::setprecision(1);
 
     std::cout << "FPS: "
-              << frames_rendered / elapsed_ms_total * 1000
+              << frames_presented / elapsed_ms_total * 1000
               << std::endl;
     std::cout << "Frame time: "
-              << static_cast<double >(render_time_ms.count()) / frames_rendered
+              << static_cast<double >(render_time_ms.count()) / std::max(frames_rendered, 1)
               << "ms" << std::endl;
 }
 
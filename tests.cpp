@@ -0,0 +1,1823 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cherry.hpp"
+
+
+// Headless checks run by ctest. Each test compares a fast path against the plainest way of drawing the same thing:
+// renderers against a serial Execute, the compositor against one Copy per layer, codecs against their input. Built
+// once per bounds mode; the clipped-view tests only exist under CHERRY_CLIP_BOUNDS, the one mode that allows views
+// hanging off a canvas edge.
+
+
+struct Test {
+    std::string Name;
+    std::function<void()> Run;
+};
+
+
+auto Expect(
+        bool condition,
+        const std::string & what) -> void {
+    if (not condition) {
+        throw std::runtime_error(what);
+    }
+}
+
+
+auto Hex(uint32_t value) -> std::string {
+    auto stream = std::ostringstream();
+    stream << "0x" << std::hex << std::setw(8) << std::setfill('0') << value;
+    return stream.str();
+}
+
+
+auto ExpectSame(
+        const cherry::ConstCanvas & actual,
+        const cherry::ConstCanvas & expected,
+        const std::string & what) -> void {
+    Expect(
+            actual.Width == expected.Width and actual.Height == expected.Height,
+            what + ": size differs"
+    );
+
+    for (auto y = 0; y < actual.Height; y += 1) {
+        for (auto x = 0; x < actual.Width; x += 1) {
+            const auto a = actual.RowUnchecked(y)[x];
+            const auto e = expected.RowUnchecked(y)[x];
+            Expect(
+                    a == e,
+                    what + ": pixel (" + std::to_string(x) + ", " + std::to_string(y) + ") is " + Hex(a)
+                    + ", expected " + Hex(e)
+            );
+        }
+    }
+}
+
+
+// Any pixel of an unbounded plane, so a canvas and a view of a bigger one can be filled with the same content.
+auto Pattern(
+        int x,
+        int y) -> uint32_t {
+    auto hash = static_cast<uint32_t>(x) * 0x9E3779B1u ^ static_cast<uint32_t>(y) * 0x85EBCA77u;
+    hash ^= hash >> 15u;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12u;
+
+    return hash;
+}
+
+
+auto FillPattern(
+        cherry::Canvas & canvas,
+        int left = 0,
+        int top = 0) -> void {
+    for (auto y = 0; y < canvas.Height; y += 1) {
+        for (auto x = 0; x < canvas.Width; x += 1) {
+            canvas.RowUnchecked(y)[x] = Pattern(left + x, top + y);
+        }
+    }
+}
+
+
+// Soft blobs over a transparent fringe, with opaque, translucent and fully transparent pixels.
+auto MakeImage(
+        int width,
+        int height) -> cherry::utility::AlignedPixelBuffer {
+    auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto canvas = cherry::Canvas(buffer);
+
+    for (auto y = 0; y < height; y += 1) {
+        for (auto x = 0; x < width; x += 1) {
+            const auto dx = 2.0f * static_cast<float>(x) / static_cast<float>(width) - 1.0f;
+            const auto dy = 2.0f * static_cast<float>(y) / static_cast<float>(height) - 1.0f;
+            const auto alpha = std::clamp(1.2f - std::hypot(dx, dy), 0.0f, 1.0f);
+
+            canvas.RowUnchecked(y)[x] = cherry::color::FromRGBA(
+                    x * 255 / width,
+                    y * 255 / height,
+                    (x ^ y) * 16,
+                    static_cast<uint32_t>(alpha * 255.0f)
+            );
+        }
+    }
+
+    return buffer;
+}
+
+
+auto Pool() -> cherry::parallel::WorkerPool & {
+    static auto pool = cherry::parallel::WorkerPool(4);
+    return pool;
+}
+
+
+// A mix of every kind of command, each placed so that some hang off the canvas edges.
+auto RandomCommands(
+        uint32_t seed,
+        int width,
+        int height,
+        const cherry::ConstCanvas & sprite,
+        int count) -> cherry::render::CommandList {
+    using namespace cherry::color;
+
+    auto random = std::mt19937(seed);
+    const auto x = [&] { return std::uniform_int_distribution(-width / 4, width + width / 4)(random); };
+    const auto y = [&] { return std::uniform_int_distribution(-height / 4, height + height / 4)(random); };
+    const auto fx = [&] { return std::uniform_real_distribution(-width / 4.0f, width * 1.25f)(random); };
+    const auto fy = [&] { return std::uniform_real_distribution(-height / 4.0f, height * 1.25f)(random); };
+    const auto color = [&] { return FromRGBA(random() & 0xFFu, random() & 0xFFu, random() & 0xFFu, random() & 0xFFu); };
+    const auto rect = [&] {
+        const auto [left, right] = std::minmax({ x(), x() });
+        const auto [top, bottom] = std::minmax({ y(), y() });
+        return cherry::utility::Rect{ left, top, right, bottom };
+    };
+
+    auto list = cherry::render::CommandList();
+    for (auto i = 0; i < count; i += 1) {
+        switch (random() % 11) {
+            case 0:
+                list.FillRect<Overwrite>(rect(), color());
+                break;
+            case 1:
+                list.FillRect<AlphaBlend>(rect(), color());
+                break;
+            case 2:
+                list.Line<Overwrite>(x(), y(), x(), y(), color());
+                break;
+            case 3:
+                list.Polygon<FastAlphaBlend>({ { x(), y() }, { x(), y() }, { x(), y() }, { x(), y() } }, color());
+                break;
+            case 4:
+                list.FillTriangle<FastAlphaBlend>(x(), y(), x(), y(), x(), y(), color());
+                break;
+            case 5:
+                list.LineAA(fx(), fy(), fx(), fy(), color());
+                break;
+            case 6:
+                list.FillPolygonAA({ { fx(), fy() }, { fx(), fy() }, { fx(), fy() }, { fx(), fy() } }, color());
+                break;
+            case 7:
+                list.Copy<FastAlphaBlend>(sprite, x(), y(), {
+                        .RotationRadians = std::uniform_real_distribution(-3.0f, 3.0f)(random),
+                        .OriginX = sprite.Width / 2,
+                        .OriginY = sprite.Height / 2,
+                        .ScaleX = std::uniform_real_distribution(0.3f, 2.5f)(random),
+                        .ScaleY = std::uniform_real_distribution(0.3f, 2.5f)(random),
+                        .Filter = random() % 2 ? cherry::transform::Sampling::Bilinear : cherry::transform::Sampling::Nearest
+                });
+                break;
+            case 8:
+                list.Copy<AlphaBlend>(sprite, x(), y());
+                break;
+            case 9:
+                list.FillRect<FastAlphaBlend>(rect(), cherry::drawing::LinearGradient{
+                        .X0 = fx(), .Y0 = fy(), .X1 = fx(), .Y1 = fy(), .Ramp = { color(), color() }
+                });
+                break;
+            default:
+                list.FillRect<AlphaBlend>(rect(), cherry::drawing::RadialGradient{
+                        .CenterX = fx(), .CenterY = fy(), .Radius = fx(), .Ramp = { color(), color() }
+                });
+                break;
+        }
+    }
+
+    return list;
+}
+
+
+auto Serial(
+        const cherry::render::CommandList & list,
+        int width,
+        int height) -> cherry::utility::AlignedPixelBuffer {
+    auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto canvas = cherry::Canvas(buffer);
+    FillPattern(canvas);
+    list.Execute(canvas);
+
+    return buffer;
+}
+
+
+// Random pixels whose alpha is as often 0 or 255 as anything in between, so each kernel's shortcuts are exercised.
+// Premultiplied pixels keep every channel at or below their alpha.
+auto RandomPixel(
+        std::mt19937 & random,
+        bool premultiplied = false) -> uint32_t {
+    const auto pixel = static_cast<uint32_t>(random());
+    const auto alpha = std::array<uint32_t, 3>{ 0, 255, pixel >> 24u }[random() % 3];
+    const auto straight = cherry::color::FromRGBA(pixel & 0xFFu, (pixel >> 8u) & 0xFFu, (pixel >> 16u) & 0xFFu, alpha);
+
+    return premultiplied ? cherry::color::Premultiply(straight) : straight;
+}
+
+
+// Every length up to a few SIMD widths, with the source and destination misaligned independently, against one scalar
+// blend per pixel. The pixels either side of the span must be left alone.
+template<typename Blend>
+auto ExpectSpansMatchScalar(
+        const std::string & name,
+        const Blend & blend = {}) -> void {
+    constexpr auto guard = 16;
+    auto random = std::mt19937(0xC0FFEE);
+
+    for (auto count : { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255, 256, 257, 1000 }) {
+        for (auto offset = 0; offset < 8; offset += 1) {
+            const auto dst_begin = guard + offset;
+            const auto src_begin = guard + offset * 3 % 8;
+
+            auto src = std::vector<uint32_t>(static_cast<size_t>(guard + count + guard));
+            auto dst = std::vector<uint32_t>(src.size());
+            for (auto i = size_t{ 0 }; i < src.size(); i += 1) {
+                src[i] = RandomPixel(random, Blend::PREMULTIPLIED);
+                dst[i] = RandomPixel(random, Blend::PREMULTIPLIED);
+            }
+
+            auto expected = dst;
+            for (auto i = 0; i < count; i += 1) {
+                expected[dst_begin + i] = blend(src[src_begin + i], dst[dst_begin + i]);
+            }
+
+            cherry::color::BlendSpan<Blend>(dst.data() + dst_begin, src.data() + src_begin, count, blend);
+
+            for (auto i = size_t{ 0 }; i < dst.size(); i += 1) {
+                Expect(
+                        dst[i] == expected[i],
+                        name + ": " + std::to_string(count) + " pixels at offset " + std::to_string(offset)
+                        + ", pixel " + std::to_string(static_cast<int>(i) - dst_begin) + " is " + Hex(dst[i])
+                        + ", expected " + Hex(expected[i])
+                );
+            }
+        }
+    }
+}
+
+
+// The vectorized span kernels must agree with their policy's scalar operator bit for bit, and PremultiplySpan with
+// Premultiply.
+auto SpansMatchScalar() -> void {
+    using namespace cherry::color;
+
+    ExpectSpansMatchScalar<Overwrite>("Overwrite");
+    ExpectSpansMatchScalar<AlphaBlend>("AlphaBlend");
+    ExpectSpansMatchScalar<FastAlphaBlend>("FastAlphaBlend");
+    ExpectSpansMatchScalar<PremultipliedOver>("PremultipliedOver");
+
+    for (auto opacity : { 0u, 1u, 128u, 254u, 255u }) {
+        const auto suffix = "(" + std::to_string(opacity) + ")";
+        ExpectSpansMatchScalar("WithOpacity<AlphaBlend>" + suffix, WithOpacity<AlphaBlend>(opacity));
+        ExpectSpansMatchScalar("WithOpacity<FastAlphaBlend>" + suffix, WithOpacity<FastAlphaBlend>(opacity));
+        ExpectSpansMatchScalar("WithOpacity<PremultipliedOver>" + suffix, WithOpacity<PremultipliedOver>(opacity));
+    }
+
+    auto random = std::mt19937(0xBEEF);
+    for (auto count : { 1, 3, 4, 7, 8, 9, 33, 1000 }) {
+        auto straight = std::vector<uint32_t>(static_cast<size_t>(count));
+        std::generate(straight.begin(), straight.end(), [&] { return RandomPixel(random); });
+
+        auto premultiplied = std::vector<uint32_t>(straight.size());
+        PremultiplySpan(premultiplied.data(), straight.data(), count);
+
+        for (auto i = 0; i < count; i += 1) {
+            Expect(
+                    premultiplied[i] == Premultiply(straight[i]),
+                    "PremultiplySpan: " + std::to_string(count) + " pixels, pixel " + std::to_string(i) + " is "
+                    + Hex(premultiplied[i]) + ", expected " + Hex(Premultiply(straight[i]))
+            );
+        }
+    }
+}
+
+
+// As ExpectSpansMatchScalar, for one colour blended over every pixel of the span.
+template<typename Blend>
+auto ExpectFillsMatchScalar(
+        const std::string & name,
+        const Blend & blend = {}) -> void {
+    constexpr auto guard = 16;
+    auto random = std::mt19937(0xF111);
+
+    for (auto count : { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000 }) {
+        for (auto offset = 0; offset < 8; offset += 1) {
+            const auto begin = guard + offset;
+            const auto color = RandomPixel(random, Blend::PREMULTIPLIED);
+
+            auto dst = std::vector<uint32_t>(static_cast<size_t>(guard + count + guard));
+            std::generate(dst.begin(), dst.end(), [&] { return RandomPixel(random, Blend::PREMULTIPLIED); });
+
+            auto expected = dst;
+            for (auto i = 0; i < count; i += 1) {
+                expected[begin + i] = blend(color, dst[begin + i]);
+            }
+
+            cherry::color::FillSpan<Blend>(dst.data() + begin, color, count, blend);
+
+            for (auto i = size_t{ 0 }; i < dst.size(); i += 1) {
+                Expect(
+                        dst[i] == expected[i],
+                        name + ": " + Hex(color) + " over " + std::to_string(count) + " pixels at offset "
+                        + std::to_string(offset) + ", pixel " + std::to_string(static_cast<int>(i) - begin) + " is "
+                        + Hex(dst[i]) + ", expected " + Hex(expected[i])
+                );
+            }
+        }
+    }
+}
+
+
+// Solid fills must agree with their policy's scalar operator, a gradient blended in one pass with the same gradient
+// drawn opaque and blended pixel by pixel, and a clear large enough to stream with a plain fill.
+auto FillsMatchScalar() -> void {
+    using namespace cherry::color;
+
+    ExpectFillsMatchScalar<Overwrite>("Overwrite");
+    ExpectFillsMatchScalar<AlphaBlend>("AlphaBlend");
+    ExpectFillsMatchScalar<FastAlphaBlend>("FastAlphaBlend");
+    ExpectFillsMatchScalar<PremultipliedOver>("PremultipliedOver");
+    for (auto opacity : { 0u, 128u, 255u }) {
+        const auto suffix = "(" + std::to_string(opacity) + ")";
+        ExpectFillsMatchScalar("WithOpacity<FastAlphaBlend>" + suffix, WithOpacity<FastAlphaBlend>(opacity));
+        ExpectFillsMatchScalar("WithOpacity<PremultipliedOver>" + suffix, WithOpacity<PremultipliedOver>(opacity));
+    }
+
+    constexpr auto width = 77;
+    constexpr auto height = 41;
+    const auto rect = cherry::utility::Rect{ -5, 3, 70, 50 };
+
+    auto shaded_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto shaded = cherry::Canvas(shaded_buffer);
+    auto blended_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto blended = cherry::Canvas(blended_buffer);
+    auto colors_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto colors = cherry::Canvas(colors_buffer);
+
+    const auto ramp = cherry::drawing::GradientRamp({
+            { 0.0f, FromRGBA(255, 0, 0, 0) },
+            { 0.4f, FromRGBA(0, 255, 64, 128) },
+            { 1.0f, FromRGBA(0, 32, 255, 255) }
+    });
+    const auto linear = std::array{
+            cherry::drawing::LinearGradient{ 3.5f, 2.0f, 60.25f, 30.0f, ramp },
+            cherry::drawing::LinearGradient{ 40.0f, 0.0f, 40.0f, 35.0f, ramp },
+            cherry::drawing::LinearGradient{ 70.0f, 10.0f, 12.0f, 10.0f, ramp }
+    };
+    const auto radial = cherry::drawing::RadialGradient{ 30.5f, 20.0f, 26.0f, ramp };
+
+    const auto check = [&](const std::string & what, auto && fill) {
+        FillPattern(shaded);
+        FillPattern(blended);
+        FillPattern(colors);
+
+        fill(shaded, FastAlphaBlend{});
+        fill(colors, Overwrite{});
+
+        const auto inside = rect.Intersection(blended.Bounds());
+        for (auto y = inside.Top; y < inside.Bottom; y += 1) {
+            for (auto x = inside.Left; x < inside.Right; x += 1) {
+                auto & pixel = blended.RowUnchecked(y)[x];
+                pixel = FastAlphaBlend{}(colors.RowUnchecked(y)[x], pixel);
+            }
+        }
+
+        ExpectSame(shaded, blended, what);
+    };
+
+    for (auto i = size_t{ 0 }; i < linear.size(); i += 1) {
+        check("linear gradient " + std::to_string(i), [&](cherry::Canvas & canvas, auto blend) {
+            cherry::drawing::FillRect<decltype(blend)>(canvas, rect, linear[i], blend);
+        });
+    }
+    check("radial gradient", [&](cherry::Canvas & canvas, auto blend) {
+        cherry::drawing::FillRect<decltype(blend)>(canvas, rect, radial, blend);
+    });
+
+    // Big enough for Clear to take the streaming stores, and oddly sized so rows start misaligned
+    auto clear_buffer = cherry::utility::PixelBuffer(601, 509);
+    auto clear_canvas = cherry::Canvas(clear_buffer.data(), 601, 509);
+    const auto color = FromRGBA(12, 34, 56, 78);
+    cherry::drawing::Clear(clear_canvas, color);
+    Expect(
+            std::all_of(clear_buffer.begin(), clear_buffer.end(), [&](uint32_t pixel) { return pixel == color; }),
+            "streaming Clear left a pixel unset"
+    );
+}
+
+
+// The scaled rect Copy steps its source columns and rows incrementally; each must be the one a division per pixel
+// picks, mirrored when the corners are swapped, with the rect hanging off any side of the canvas.
+auto ScaledCopiesMatchDivision() -> void {
+    using namespace cherry::color;
+
+    constexpr auto width = 97;
+    constexpr auto height = 71;
+
+    const auto sprite_image = MakeImage(23, 17);
+    const auto sprite = cherry::ConstCanvas(sprite_image);
+
+    auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto canvas = cherry::Canvas(buffer);
+    auto expected_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto expected = cherry::Canvas(expected_buffer);
+
+    auto random = std::mt19937(0x5CA1E);
+    const auto coordinate = [&](int size) { return std::uniform_int_distribution(-size / 2, size + size / 2)(random); };
+
+    const auto check = [&](int x0, int y0, int x1, int y1, auto blend) {
+        using Blend = decltype(blend);
+
+        FillPattern(canvas);
+        FillPattern(expected);
+        cherry::transform::Copy<Blend>(sprite, canvas, x0, y0, x1, y1, blend);
+
+        const auto left = std::min(x0, x1);
+        const auto top = std::min(y0, y1);
+        const auto target_width = int64_t{ std::abs(x1 - x0) };
+        const auto target_height = int64_t{ std::abs(y1 - y0) };
+
+        for (auto y = std::max(top, 0); y < std::min(top + static_cast<int>(target_height), height); y += 1) {
+            for (auto x = std::max(left, 0); x < std::min(left + static_cast<int>(target_width), width); x += 1) {
+                const auto column = static_cast<int>((x - left) * sprite.Width / target_width);
+                const auto row = static_cast<int>((y - top) * sprite.Height / target_height);
+                const auto u = x0 > x1 ? sprite.Width - 1 - column : column;
+                const auto v = y0 > y1 ? sprite.Height - 1 - row : row;
+
+                auto & pixel = expected.RowUnchecked(y)[x];
+                pixel = blend(sprite.RowUnchecked(v)[u], pixel);
+            }
+        }
+
+        ExpectSame(
+                canvas,
+                expected,
+                "Copy to (" + std::to_string(x0) + ", " + std::to_string(y0) + ", " + std::to_string(x1) + ", "
+                + std::to_string(y1) + ")"
+        );
+    };
+
+    // Exact integer ratios, one-pixel targets and the unscaled but mirrored case, then anything at all
+    check(10, 10, 56, 44, Overwrite{});
+    check(10, 10, 21, 18, Overwrite{});
+    check(40, 30, 41, 31, FastAlphaBlend{});
+    check(33, 12, 10, 29, FastAlphaBlend{});
+    check(-30, -20, 130, 90, AlphaBlend{});
+
+    for (auto i = 0; i < 300; i += 1) {
+        const auto x0 = coordinate(width);
+        const auto y0 = coordinate(height);
+        const auto x1 = coordinate(width);
+        const auto y1 = coordinate(height);
+
+        switch (i % 3) {
+            case 0:
+                check(x0, y0, x1, y1, Overwrite{});
+                break;
+            case 1:
+                check(x0, y0, x1, y1, FastAlphaBlend{});
+                break;
+            default:
+                check(x0, y0, x1, y1, WithOpacity<AlphaBlend>(100));
+                break;
+        }
+    }
+}
+
+
+// A mip level must cover the destination pixels the source itself would, whichever level the scale picks. The
+// sprite is solid, so every covered pixel takes its colour under either filter, and is checked against the exact
+// footprint. Pixels whose centre lies within a hair of the sprite's edge are skipped: both paths step in fixed point
+// and may round such a tie either way.
+auto MipCopiesMatchCopy() -> void {
+    using cherry::transform::Sampling;
+
+    constexpr auto width = 400;
+    constexpr auto height = 400;
+    constexpr auto x0 = 200;
+    constexpr auto y0 = 190;
+    constexpr auto tie = 1e-3;
+
+    const auto white = cherry::color::FromRGBA(255, 255, 255);
+    const auto sprite_image = cherry::utility::AlignedPixelBuffer(251, 173, white);
+    const auto sprite = cherry::ConstCanvas(sprite_image);
+    const auto mips = cherry::transform::MipChain(sprite);
+
+    auto mip_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto mip_canvas = cherry::Canvas(mip_buffer);
+    auto plain_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto plain_canvas = cherry::Canvas(plain_buffer);
+
+    for (auto step = 0; step < 160; step += 1) {
+        const auto tf = cherry::transform::Transform{
+                .RotationRadians = 0.37f * static_cast<float>(step % 9) + 0.05f,
+                .OriginX = 125 - step % 5 * 31,
+                .OriginY = 86 + step % 3 * 29,
+                .ScaleX = 0.12f + 0.0061f * static_cast<float>(step),
+                .ScaleY = 0.1f + 0.0049f * static_cast<float>(step),
+                .Filter = step % 2 ? Sampling::Bilinear : Sampling::Nearest
+        };
+
+        std::fill_n(mip_buffer.Data(), mip_buffer.Size(), 0u);
+        std::fill_n(plain_buffer.Data(), plain_buffer.Size(), 0u);
+        cherry::transform::Copy<cherry::color::Overwrite>(mips, mip_canvas, x0, y0, tf);
+        cherry::transform::Copy<cherry::color::Overwrite>(sprite, plain_canvas, x0, y0, tf);
+
+        // The scale is quantized to FixedPoint before either path uses it
+        const auto scale_x = static_cast<double>(static_cast<float>(cherry::transform::FixedPoint{ tf.ScaleX }));
+        const auto scale_y = static_cast<double>(static_cast<float>(cherry::transform::FixedPoint{ tf.ScaleY }));
+        const auto sin = static_cast<double>(std::sin(tf.RotationRadians));
+        const auto cos = static_cast<double>(std::cos(tf.RotationRadians));
+
+        for (auto y = 0; y < height; y += 1) {
+            for (auto x = 0; x < width; x += 1) {
+                const auto u = tf.OriginX + 0.5 + (cos * (x - x0) - sin * (y - y0)) / scale_x;
+                const auto v = tf.OriginY + 0.5 + (sin * (x - x0) + cos * (y - y0)) / scale_y;
+                if (std::min({ std::abs(u), std::abs(u - sprite.Width), std::abs(v), std::abs(v - sprite.Height) }) < tie) {
+                    continue;
+                }
+
+                const auto inside = u >= 0 and v >= 0 and u < sprite.Width and v < sprite.Height;
+                const auto expected = inside ? white : 0u;
+                const auto at = "step " + std::to_string(step) + ", level "
+                                + std::to_string(mips.LevelFor(tf.ScaleX, tf.ScaleY)) + ", pixel ("
+                                + std::to_string(x) + ", " + std::to_string(y) + ")";
+
+                Expect(plain_canvas.RowUnchecked(y)[x] == expected, "Copy: " + at);
+                Expect(mip_canvas.RowUnchecked(y)[x] == expected, "mip Copy: " + at);
+            }
+        }
+    }
+}
+
+
+// A batch is rasterized band by band but must compose exactly like one Copy per instance in submission order, for
+// every kind of transform and for whole-atlas as well as sub-rect sources.
+auto BatchesMatchCopies() -> void {
+    using namespace cherry::color;
+    using cherry::transform::Sampling;
+
+    constexpr auto width = 301;
+    constexpr auto height = 233;
+
+    const auto atlas_image = MakeImage(96, 64);
+    const auto atlas = cherry::ConstCanvas(atlas_image);
+
+    auto random = std::mt19937(0xBA7C4);
+    const auto integer = [&](int low, int high) { return std::uniform_int_distribution(low, high)(random); };
+    const auto real = [&](float low, float high) { return std::uniform_real_distribution(low, high)(random); };
+
+    auto instances = std::vector<cherry::transform::Instance>();
+    for (auto i = 0; i < 400; i += 1) {
+        auto tf = cherry::transform::Transform{};
+        switch (i % 4) {
+            case 0:
+                break;
+            case 1:
+                tf.ScaleX = real(-2.5f, 2.5f);
+                tf.ScaleY = real(0.2f, 2.5f);
+                break;
+            case 2:
+                tf.RotationRadians = real(-3.2f, 3.2f);
+                break;
+            default:
+                tf.RotationRadians = real(-3.2f, 3.2f);
+                tf.ScaleX = real(0.2f, 2.5f);
+                tf.ScaleY = real(0.2f, 2.5f);
+                break;
+        }
+        tf.Filter = i % 7 ? Sampling::Nearest : Sampling::Bilinear;
+
+        auto source = cherry::utility::Rect{};
+        if (i % 3) {
+            const auto left = integer(0, atlas.Width - 1);
+            const auto top = integer(0, atlas.Height - 1);
+            source = { left, top, integer(left + 1, atlas.Width), integer(top + 1, atlas.Height) };
+        }
+
+        tf.OriginX = integer(0, source.IsEmpty() ? atlas.Width : source.Width());
+        tf.OriginY = integer(0, source.IsEmpty() ? atlas.Height : source.Height());
+
+        instances.push_back({ integer(-40, width + 40), integer(-40, height + 40), tf, source });
+    }
+
+    auto batch_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto batch = cherry::Canvas(batch_buffer);
+    auto expected_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto expected = cherry::Canvas(expected_buffer);
+
+    const auto check = [&](const std::string & what, auto blend, auto && draw) {
+        using Blend = decltype(blend);
+
+        FillPattern(batch);
+        FillPattern(expected);
+        draw(batch, blend);
+
+        for (const auto & instance : instances) {
+            const auto source = instance.Source.IsEmpty() ? atlas.Bounds() : instance.Source;
+            cherry::transform::Copy<Blend>(atlas, source, expected, instance.X, instance.Y, instance.Tf, blend);
+        }
+
+        ExpectSame(batch, expected, what);
+    };
+
+    const auto serial = [&](cherry::Canvas & canvas, auto blend) {
+        cherry::transform::CopyBatch<decltype(blend)>(atlas, canvas, instances, blend);
+    };
+    const auto parallel = [&](cherry::Canvas & canvas, auto blend) {
+        cherry::parallel::CopyBatch<decltype(blend)>(Pool(), atlas, canvas, instances, blend);
+    };
+
+    check("CopyBatch, Overwrite", Overwrite{}, serial);
+    check("CopyBatch, FastAlphaBlend", FastAlphaBlend{}, serial);
+    check("parallel CopyBatch, Overwrite", Overwrite{}, parallel);
+    check("parallel CopyBatch, AlphaBlend", AlphaBlend{}, parallel);
+}
+
+
+// Counts how many times each pixel is drawn.
+auto CountDraws(
+        uint32_t,
+        uint32_t background) -> uint32_t {
+    return background + 1;
+}
+
+
+// Whether the pixel center (x + 0.5, y + 0.5) is covered by the triangle, worked out on doubled coordinates so that it
+// stays exact. Centers on an edge are covered only on left edges, those with the inside to their right, and on top
+// edges, horizontal ones with the inside below.
+auto TriangleCovers(
+        const std::array<std::pair<int64_t, int64_t>, 3> & vertices,
+        int64_t x,
+        int64_t y) -> bool {
+    const auto cross = [](auto a, auto b, int64_t px, int64_t py) {
+        return (2 * b.first - 2 * a.first) * (py - 2 * a.second) - (2 * b.second - 2 * a.second) * (px - 2 * a.first);
+    };
+
+    const auto &[a, b, c] = vertices;
+    const auto orientation = cross(a, b, 2 * c.first, 2 * c.second);
+    if (0 == orientation) {
+        return false;
+    }
+
+    for (auto k = 0; k < 3; k += 1) {
+        auto from = vertices[k];
+        auto to = vertices[(k + 1) % 3];
+        if (orientation < 0) {
+            std::swap(from, to);
+        }
+
+        // The inside lies where cross is positive, so to the right of the edge when it runs upwards
+        const auto side = cross(from, to, 2 * x + 1, 2 * y + 1);
+        const auto dx = to.first - from.first;
+        const auto dy = to.second - from.second;
+        const auto top_left = dy < 0 or (0 == dy and dx > 0);
+
+        if (side < 0 or (0 == side and not top_left)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Every pixel of random triangles, small and close enough for centers to land on edges often, against a per-pixel
+// edge test. A fan sharing its edges must then draw each pixel at most once and leave no gaps inside it.
+auto TrianglesMatchEdgeFunctions() -> void {
+    using namespace cherry::color;
+
+    constexpr auto width = 83;
+    constexpr auto height = 67;
+
+    auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto canvas = cherry::Canvas(buffer);
+    auto expected_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto expected = cherry::Canvas(expected_buffer);
+
+    auto random = std::mt19937(0x7121A);
+    const auto coordinate = [&](int size) { return std::uniform_int_distribution(-size / 3, size + size / 3)(random); };
+    const auto red = FromRGBA(255, 0, 0);
+
+    const auto check = [&](const std::array<std::pair<int64_t, int64_t>, 3> & vertices, bool parallel) {
+        const auto &[a, b, c] = vertices;
+        const auto at = [](auto vertex) {
+            return "(" + std::to_string(vertex.first) + ", " + std::to_string(vertex.second) + ")";
+        };
+
+        FillPattern(canvas);
+        FillPattern(expected);
+        if (parallel) {
+            cherry::parallel::FillTriangle<Overwrite>(
+                    Pool(), canvas, a.first, a.second, b.first, b.second, c.first, c.second, red);
+        }
+        else {
+            cherry::drawing::FillTriangle<Overwrite>(
+                    canvas, a.first, a.second, b.first, b.second, c.first, c.second, red);
+        }
+
+        for (auto y = 0; y < height; y += 1) {
+            for (auto x = 0; x < width; x += 1) {
+                if (TriangleCovers(vertices, x, y)) {
+                    expected.RowUnchecked(y)[x] = red;
+                }
+            }
+        }
+
+        ExpectSame(canvas, expected, (parallel ? "parallel " : "") + ("triangle " + at(a) + at(b) + at(c)));
+    };
+
+    for (auto i = 0; i < 400; i += 1) {
+        check({ { { coordinate(width), coordinate(height) },
+                  { coordinate(width), coordinate(height) },
+                  { coordinate(width), coordinate(height) } } }, i % 4 == 0);
+    }
+
+    // Far enough out for the edge tests to leave the narrow SIMD path
+    for (auto i = 0; i < 20; i += 1) {
+        const auto far = std::uniform_int_distribution(1 << 26, 1 << 29)(random);
+        check({ { { -far, coordinate(height) },
+                  { coordinate(width), far },
+                  { far, coordinate(height) - far / 2 } } }, false);
+    }
+
+    std::fill_n(buffer.Data(), buffer.Size(), 0u);
+    const auto center = std::pair{ 41, 30 };
+    auto fan = std::vector<std::pair<int, int>>();
+    for (auto k = 0; k < 16; k += 1) {
+        const auto angle = static_cast<float>(k) * 0.3926991f;
+        const auto radius = std::uniform_real_distribution(20.0f, 40.0f)(random);
+        fan.emplace_back(center.first + std::lround(radius * std::cos(angle)),
+                         center.second + std::lround(radius * std::sin(angle)));
+    }
+
+    for (auto k = size_t{ 0 }; k < fan.size(); k += 1) {
+        const auto &[x1, y1] = fan[k];
+        const auto &[x2, y2] = fan[(k + 1) % fan.size()];
+        cherry::drawing::FillTriangle<Function<CountDraws>>(canvas, center.first, center.second, x1, y1, x2, y2, 0);
+    }
+
+    for (auto y = 0; y < height; y += 1) {
+        for (auto x = 0; x < width; x += 1) {
+            const auto draws = canvas.RowUnchecked(y)[x];
+            Expect(draws <= 1, "fan draws pixel (" + std::to_string(x) + ", " + std::to_string(y) + ") twice");
+
+            const auto dx = x + 0.5f - static_cast<float>(center.first);
+            const auto dy = y + 0.5f - static_cast<float>(center.second);
+            Expect(
+                    draws == 1 or std::hypot(dx, dy) > 19.0f,
+                    "fan leaves pixel (" + std::to_string(x) + ", " + std::to_string(y) + ") out"
+            );
+        }
+    }
+}
+
+
+// The winding number of the pixel center (x + 0.5, y + 0.5), counting the edges that cross its row at or left of it.
+// Centers exactly on an edge count as right of it, as the scanline fill has them.
+auto WindingAt(
+        const std::vector<std::vector<std::pair<int, int>>> & contours,
+        int64_t x,
+        int64_t y) -> int {
+    auto winding = 0;
+
+    for (const auto & contour : contours) {
+        for (auto i = size_t{ 0 }; i < contour.size(); i += 1) {
+            auto[x0, y0] = contour[i];
+            auto[x1, y1] = contour[(i + 1) % contour.size()];
+            const auto direction = y0 < y1 ? 1 : -1;
+            if (y0 > y1) {
+                std::swap(x0, x1);
+                std::swap(y0, y1);
+            }
+
+            if (y < y0 or y >= y1) {
+                continue;
+            }
+
+            // The edge crosses the center's row at x0 + (y + 0.5 - y0) * dx / dy, with dy positive
+            const auto dx = int64_t{ x1 } - x0;
+            const auto dy = int64_t{ y1 } - y0;
+            if (2 * x0 * dy + (2 * (y - y0) + 1) * dx <= (2 * x + 1) * dy) {
+                winding += direction;
+            }
+        }
+    }
+
+    return winding;
+}
+
+
+// Random self-intersecting polygons, and shapes of several contours with holes cut by either rule, against the
+// winding number of every pixel center.
+auto PolygonsMatchWinding() -> void {
+    using namespace cherry::color;
+    using cherry::drawing::FillRule;
+
+    constexpr auto width = 91;
+    constexpr auto height = 73;
+
+    auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto canvas = cherry::Canvas(buffer);
+    auto expected_buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto expected = cherry::Canvas(expected_buffer);
+
+    auto random = std::mt19937(0x9017);
+    const auto coordinate = [&](int size) { return std::uniform_int_distribution(-size / 3, size + size / 3)(random); };
+    const auto contour = [&](int count) {
+        auto vertices = std::vector<std::pair<int, int>>();
+        for (auto i = 0; i < count; i += 1) {
+            vertices.emplace_back(coordinate(width), coordinate(height));
+        }
+        return vertices;
+    };
+
+    const auto green = FromRGBA(0, 255, 0, 160);
+
+    for (auto i = 0; i < 300; i += 1) {
+        auto contours = std::vector<std::vector<std::pair<int, int>>>();
+        contours.push_back(contour(3 + i % 9));
+        if (i % 3 == 0) {
+            contours.push_back(contour(3 + i % 5));
+            contours.push_back(contour(4));
+        }
+
+        for (const auto rule : { FillRule::EvenOdd, FillRule::NonZero }) {
+            FillPattern(canvas);
+            FillPattern(expected);
+
+            if (1 == contours.size()) {
+                cherry::drawing::FillPolygon<FastAlphaBlend>(canvas, contours.front(), green, rule);
+            }
+            else {
+                cherry::drawing::FillPolygon<FastAlphaBlend>(canvas, contours, green, rule);
+            }
+
+            for (auto y = 0; y < height; y += 1) {
+                for (auto x = 0; x < width; x += 1) {
+                    const auto winding = WindingAt(contours, x, y);
+                    const auto inside = FillRule::EvenOdd == rule ? (winding & 1) != 0 : winding != 0;
+                    if (inside) {
+                        auto & pixel = expected.RowUnchecked(y)[x];
+                        pixel = FastAlphaBlend{}(green, pixel);
+                    }
+                }
+            }
+
+            ExpectSame(
+                    canvas,
+                    expected,
+                    "polygon " + std::to_string(i) + (FillRule::EvenOdd == rule ? ", even-odd" : ", nonzero")
+            );
+        }
+    }
+}
+
+
+// Plain Bresenham over the whole line, stepped from the endpoint with the smaller major coordinate and returned from
+// (x0, y0) to (x1, y1), with no clipping at all.
+auto BresenhamSteps(
+        int64_t x0,
+        int64_t y0,
+        int64_t x1,
+        int64_t y1) -> std::vector<std::pair<int64_t, int64_t>> {
+    const auto x_major = std::abs(y1 - y0) < std::abs(x1 - x0);
+    const auto reversed = x_major ? x0 > x1 : y0 > y1;
+    if (reversed) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+
+    const auto dx = std::abs(x1 - x0);
+    const auto dy = std::abs(y1 - y0);
+    const auto major = x_major ? dx : dy;
+    const auto minor = x_major ? dy : dx;
+    const auto xi = x1 >= x0 ? 1 : -1;
+    const auto yi = y1 >= y0 ? 1 : -1;
+
+    auto steps = std::vector<std::pair<int64_t, int64_t>>();
+    auto x = x0;
+    auto y = y0;
+    auto D = 2 * minor - major;
+    for (auto k = int64_t{ 0 }; k <= major; k += 1) {
+        steps.emplace_back(x, y);
+
+        (x_major ? x : y) += x_major ? xi : yi;
+        if (D > 0) {
+            (x_major ? y : x) += x_major ? yi : xi;
+            D -= 2 * major;
+        }
+        D += 2 * minor;
+    }
+
+    if (reversed) {
+        std::reverse(steps.begin(), steps.end());
+    }
+
+    return steps;
+}
+
+
+template<typename Blend>
+auto Plot(
+        cherry::Canvas & canvas,
+        const std::vector<std::pair<int64_t, int64_t>> & steps,
+        uint32_t color,
+        const Blend & blend = {}) -> void {
+    for (const auto &[x, y] : steps) {
+        if (x >= 0 and y >= 0 and x < canvas.Width and y < canvas.Height) {
+            auto & pixel = canvas.RowUnchecked(static_cast<int>(y))[x];
+            pixel = blend(color, pixel);
+        }
+    }
+}
+
+
+// Lines and polylines reaching far off a small canvas must draw exactly the visible steps of the unclipped line.
+auto LinesMatchBresenham() -> void {
+    using cherry::color::AlphaBlend;
+
+    constexpr auto width = 64;
+    constexpr auto height = 48;
+
+    auto random = std::mt19937(4);
+    const auto coordinate = [&](int extent) {
+        return random() % 2
+               ? std::uniform_int_distribution(-3000, 3000)(random)
+               : std::uniform_int_distribution(-20, extent + 20)(random);
+    };
+
+    auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto canvas = cherry::Canvas(buffer);
+    auto expected = cherry::utility::AlignedPixelBuffer(width, height);
+    auto expected_canvas = cherry::Canvas(expected);
+    const auto color = cherry::color::FromRGBA(250, 120, 10, 100);
+
+    for (auto i = 0; i < 500; i += 1) {
+        const auto x0 = coordinate(width), y0 = coordinate(height), x1 = coordinate(width), y1 = coordinate(height);
+
+        FillPattern(canvas);
+        FillPattern(expected_canvas);
+        cherry::drawing::Line<AlphaBlend>(canvas, x0, y0, x1, y1, color);
+        Plot<AlphaBlend>(expected_canvas, BresenhamSteps(x0, y0, x1, y1), color);
+
+        ExpectSame(
+                cherry::ConstCanvas(buffer),
+                cherry::ConstCanvas(expected),
+                "line (" + std::to_string(x0) + ", " + std::to_string(y0) + ") - (" + std::to_string(x1) + ", "
+                + std::to_string(y1) + ")"
+        );
+    }
+
+    // Horizontal, vertical and single-pixel lines take their own span paths, which random endpoints rarely reach
+    for (auto i = 0; i < 400; i += 1) {
+        const auto x0 = coordinate(width), y0 = coordinate(height);
+        const auto x1 = i % 4 == 0 ? coordinate(width) : x0;
+        const auto y1 = i % 4 == 1 ? coordinate(height) : y0;
+
+        FillPattern(canvas);
+        FillPattern(expected_canvas);
+        cherry::drawing::Line<AlphaBlend>(canvas, x0, y0, x1, y1, color);
+        Plot<AlphaBlend>(expected_canvas, BresenhamSteps(x0, y0, x1, y1), color);
+
+        ExpectSame(
+                cherry::ConstCanvas(buffer),
+                cherry::ConstCanvas(expected),
+                "line (" + std::to_string(x0) + ", " + std::to_string(y0) + ") - (" + std::to_string(x1) + ", "
+                + std::to_string(y1) + ")"
+        );
+    }
+
+    // Shared vertices are drawn once, so a translucent polyline shows where a vertex is drawn twice
+    for (auto i = 0; i < 300; i += 1) {
+        auto vertices = std::vector<std::pair<int, int>>(1 + random() % 6);
+        for (auto & vertex : vertices) {
+            vertex = { coordinate(width), coordinate(height) };
+        }
+        const auto closed = 0 == random() % 2;
+        const auto count = vertices.size();
+        const auto segments = closed and count > 2 ? count : std::max(count - 1, size_t{ 1 });
+
+        FillPattern(canvas);
+        FillPattern(expected_canvas);
+        cherry::drawing::Polyline<AlphaBlend>(canvas, vertices, color, closed);
+
+        for (auto s = size_t{ 0 }; s < segments; s += 1) {
+            const auto[x0, y0] = vertices[s];
+            const auto[x1, y1] = vertices[(s + 1) % count];
+
+            auto steps = BresenhamSteps(x0, y0, x1, y1);
+            if (closed and count > 2 and s + 1 == segments and not steps.empty()) {
+                steps.pop_back();
+            }
+            if (s > 0 and not steps.empty()) {
+                steps.erase(steps.begin());
+            }
+            Plot<AlphaBlend>(expected_canvas, steps, color);
+        }
+
+        ExpectSame(
+                cherry::ConstCanvas(buffer),
+                cherry::ConstCanvas(expected),
+                "polyline " + std::to_string(i) + (closed ? ", closed" : "")
+        );
+    }
+
+    // Endpoints a full int range apart, drawn both ways round
+    constexpr auto min = std::numeric_limits<int>::min();
+    constexpr auto max = std::numeric_limits<int>::max();
+    const auto diagonal = [](int x, int y) { return x == y; };
+    const auto row = [](int, int y) { return 7 == y; };
+    const auto far_lines = std::vector<std::pair<std::array<int, 4>, std::function<bool(int, int)>>>{
+            { { min, min, max, max }, diagonal },
+            { { max, max, min, min }, diagonal },
+            { { min, 7, max, 7 }, row },
+            { { max, 7, min, 7 }, row },
+    };
+
+    for (const auto &[line, on_line] : far_lines) {
+        FillPattern(canvas);
+        cherry::drawing::Line<cherry::color::Overwrite>(canvas, line[0], line[1], line[2], line[3], color);
+
+        for (auto y = 0; y < height; y += 1) {
+            for (auto x = 0; x < width; x += 1) {
+                Expect(
+                        (color == canvas.RowUnchecked(y)[x]) == on_line(x, y),
+                        "line (" + std::to_string(line[0]) + ", " + std::to_string(line[1]) + ") - ("
+                        + std::to_string(line[2]) + ", " + std::to_string(line[3]) + ") at pixel ("
+                        + std::to_string(x) + ", " + std::to_string(y) + ")"
+                );
+            }
+        }
+    }
+
+    // A closed far-off polyline covers the same pixels, each once, whichever way round it is given
+    const auto triangle = std::vector<std::pair<int, int>>{ { min, min }, { max, max }, { min, max } };
+    FillPattern(canvas);
+    FillPattern(expected_canvas);
+    cherry::drawing::Polyline<AlphaBlend>(canvas, triangle, color, true);
+    cherry::drawing::Polyline<AlphaBlend>(
+            expected_canvas,
+            std::vector<std::pair<int, int>>(triangle.rbegin(), triangle.rend()),
+            color,
+            true
+    );
+    ExpectSame(cherry::ConstCanvas(buffer), cherry::ConstCanvas(expected), "far-off closed polyline");
+}
+
+
+auto TiledMatchesSerial() -> void {
+    constexpr auto width = 203;
+    constexpr auto height = 157;
+
+    const auto sprite_image = MakeImage(37, 23);
+    const auto list = RandomCommands(1, width, height, cherry::ConstCanvas(sprite_image), 300);
+    const auto expected = Serial(list, width, height);
+
+    for (const auto tile_size : { 5, 16, 64, 1000 }) {
+        for (const auto pooled : { false, true }) {
+            auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+            auto canvas = cherry::Canvas(buffer);
+            FillPattern(canvas);
+
+            auto renderer = cherry::render::TiledRenderer(tile_size);
+            // Twice, the second time from the cached bins
+            for (auto pass = 0; pass < 2; pass += 1) {
+                if (pass) {
+                    FillPattern(canvas);
+                }
+                pooled ? renderer.Render(Pool(), list, canvas) : renderer.Render(list, canvas);
+
+                ExpectSame(
+                        cherry::ConstCanvas(buffer),
+                        cherry::ConstCanvas(expected),
+                        "tile size " + std::to_string(tile_size) + (pooled ? ", pooled" : "") + ", pass "
+                        + std::to_string(pass)
+                );
+            }
+        }
+    }
+}
+
+
+auto BandedMatchesSerial() -> void {
+    constexpr auto width = 203;
+    constexpr auto height = 157;
+    const auto background = cherry::color::FromRGBA(20, 40, 60, 255);
+
+    const auto sprite_image = MakeImage(37, 23);
+    const auto list = RandomCommands(2, width, height, cherry::ConstCanvas(sprite_image), 300);
+
+    auto expected = cherry::utility::AlignedPixelBuffer(width, height, background);
+    auto expected_canvas = cherry::Canvas(expected);
+    list.Execute(expected_canvas);
+
+    for (const auto band_height : { 1, 7, 64, 1000 }) {
+        for (const auto pooled : { false, true }) {
+            auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+            auto canvas = cherry::Canvas(buffer);
+            auto next_top = 0;
+
+            const auto sink = [&](const cherry::ConstCanvas & band, int top) {
+                Expect(top == next_top, "bands out of order");
+                next_top += band.Height;
+
+                for (auto y = 0; y < band.Height; y += 1) {
+                    std::copy_n(band.RowUnchecked(y), width, canvas.RowUnchecked(top + y));
+                }
+            };
+
+            auto renderer = cherry::render::BandedRenderer(band_height);
+            pooled
+            ? renderer.Render(Pool(), list, width, height, background, sink)
+            : renderer.Render(list, width, height, background, sink);
+
+            Expect(next_top == height, "bands do not cover the image");
+            ExpectSame(
+                    cherry::ConstCanvas(buffer),
+                    cherry::ConstCanvas(expected),
+                    "band height " + std::to_string(band_height) + (pooled ? ", pooled" : "")
+            );
+        }
+    }
+}
+
+
+template<typename Blend>
+auto ComposeReference(
+        cherry::render::Layer & layer,
+        cherry::Canvas & dst) -> void {
+    if (not layer.Visible or not layer.Opacity) {
+        return;
+    }
+
+    const auto pixels = cherry::ConstCanvas(layer.Pixels());
+    if (layer.Opacity >= 0xFF) {
+        cherry::transform::Copy<Blend>(pixels, dst, layer.X, layer.Y, layer.Transform);
+    }
+    else {
+        using Faded = cherry::color::WithOpacity<Blend>;
+        cherry::transform::Copy<Faded>(pixels, dst, layer.X, layer.Y, layer.Transform, Faded(layer.Opacity));
+    }
+}
+
+
+// The same stack as Populate builds: a backdrop, then blended sprites.
+using ReferenceFn = void (*)(cherry::render::Layer &, cherry::Canvas &);
+
+const auto REFERENCE_BLENDS = std::vector<ReferenceFn>{
+        &ComposeReference<cherry::color::Overwrite>,
+        &ComposeReference<cherry::color::FastAlphaBlend>,
+        &ComposeReference<cherry::color::AlphaBlend>,
+        &ComposeReference<cherry::color::FastAlphaBlend>,
+};
+
+
+auto Populate(cherry::render::Compositor & compositor) -> void {
+    using namespace cherry::color;
+
+    const auto images = std::array<cherry::utility::AlignedPixelBuffer, 4>{
+            MakeImage(120, 90),
+            MakeImage(61, 47),
+            MakeImage(33, 70),
+            MakeImage(80, 20),
+    };
+    const auto add = [&](cherry::render::Layer & layer, int index, int x, int y) {
+        auto pixels = layer.Pixels();
+        cherry::transform::Copy<Overwrite>(cherry::ConstCanvas(images[index]), pixels);
+        layer.X = x;
+        layer.Y = y;
+    };
+
+    add(compositor.AddLayer<Overwrite>(120, 90), 0, -10, 5);
+    add(compositor.AddLayer<FastAlphaBlend>(61, 47), 1, 20, 12);
+    add(compositor.AddLayer<AlphaBlend>(33, 70), 2, 70, -9);
+    add(compositor.AddLayer<FastAlphaBlend>(80, 20), 3, 5, 40);
+}
+
+
+auto FlattenReference(
+        cherry::render::Compositor & compositor,
+        int width,
+        int height,
+        uint32_t background) -> cherry::utility::AlignedPixelBuffer {
+    auto buffer = cherry::utility::AlignedPixelBuffer(width, height, background);
+    auto canvas = cherry::Canvas(buffer);
+    for (auto i = 0; i < compositor.LayerCount(); i += 1) {
+        REFERENCE_BLENDS[i](compositor[i], canvas);
+    }
+
+    return buffer;
+}
+
+
+// Frame edits that leave the cache valid, extend it, cut it short or force it to be dropped.
+const auto FRAME_EDITS = std::vector<std::function<void(cherry::render::Compositor &)>>{
+        [](cherry::render::Compositor &) {},
+        [](cherry::render::Compositor &) {},
+        [](cherry::render::Compositor & c) { c[3].X += 7; },
+        [](cherry::render::Compositor & c) { c[1].Opacity = 0x80; c[2].Visible = false; },
+        [](cherry::render::Compositor & c) {
+            auto pixels = c[0].Pixels();
+            cherry::drawing::FillRect<cherry::color::Overwrite>(pixels, { 10, 10, 50, 30 }, cherry::color::FromRGBA(255, 0, 0));
+            c[0].Touch();
+        },
+        [](cherry::render::Compositor & c) {
+            auto pixels = c[1].Pixels();
+            cherry::drawing::FillRect<cherry::color::Overwrite>(pixels, { 0, 0, 20, 20 }, cherry::color::FromRGBA(0, 255, 0, 128));
+            c.Invalidate();
+        },
+        [](cherry::render::Compositor & c) {
+            c[2].Visible = true;
+            c[2].Transform = { .RotationRadians = 0.7f, .OriginX = 16, .OriginY = 35, .ScaleX = 1.3f,
+                               .ScaleY = 0.8f, .Filter = cherry::transform::Sampling::Bilinear };
+        },
+        [](cherry::render::Compositor & c) { c[0].Visible = false; },
+        [](cherry::render::Compositor & c) { c[0].Visible = true; c[1].Opacity = 0; },
+        [](cherry::render::Compositor &) {},
+};
+
+
+auto CompositorMatchesMultipass() -> void {
+    constexpr auto width = 300;
+    constexpr auto height = 220;
+
+    for (const auto pooled : { false, true }) {
+        for (const auto background : { 0u, cherry::color::FromRGBA(30, 60, 90, 200) }) {
+            auto compositor = cherry::render::Compositor();
+            Populate(compositor);
+
+            auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+            auto canvas = cherry::Canvas(buffer);
+
+            for (auto frame = 0; frame < static_cast<int>(FRAME_EDITS.size()); frame += 1) {
+                FRAME_EDITS[frame](compositor);
+                FillPattern(canvas);
+                pooled ? compositor.Flatten(Pool(), canvas, background) : compositor.Flatten(canvas, background);
+
+                ExpectSame(
+                        cherry::ConstCanvas(buffer),
+                        cherry::ConstCanvas(FlattenReference(compositor, width, height, background)),
+                        "frame " + std::to_string(frame) + (pooled ? ", pooled" : "") + ", background "
+                        + Hex(background)
+                );
+            }
+        }
+    }
+}
+
+
+// Dense noise, flat runs, small steps and repeats of earlier colours, so every QOI chunk type is written.
+auto MakeCodecImage(
+        int width,
+        int height,
+        uint32_t seed) -> cherry::utility::AlignedPixelBuffer {
+    auto random = std::mt19937(seed);
+    auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+    auto canvas = cherry::Canvas(buffer);
+
+    auto previous = cherry::color::FromRGBA(0, 0, 0, 255);
+    for (auto y = 0; y < height; y += 1) {
+        for (auto x = 0; x < width; x += 1) {
+            const auto [r, g, b, a] = cherry::color::ToRGBA(previous);
+            switch (random() % 5) {
+                case 0:
+                    previous = static_cast<uint32_t>(random());
+                    break;
+                case 1:
+                    break;
+                case 2:
+                    previous = cherry::color::FromRGBA(r + random() % 3 - 1, g + random() % 3 - 1, b + random() % 3 - 1, a);
+                    break;
+                case 3:
+                    previous = cherry::color::FromRGBA(r + random() % 20, g + random() % 20, b + random() % 20, a);
+                    break;
+                default:
+                    previous = Pattern(random() % 8, 0);
+                    break;
+            }
+            canvas.RowUnchecked(y)[x] = previous;
+        }
+    }
+
+    return buffer;
+}
+
+
+template<typename Write, typename Read>
+auto ExpectRoundTrip(
+        const std::string & codec,
+        Write && write,
+        Read && read) -> void {
+    for (const auto &[width, height] : std::vector<std::pair<int, int>>{ { 1, 1 }, { 3, 2 }, { 37, 19 }, { 64, 64 }, { 200, 3 } }) {
+        const auto image = MakeCodecImage(width, height, width * 31 + height);
+
+        auto stream = std::stringstream();
+        write(stream, cherry::ConstCanvas(image));
+
+        const auto decoded = read(stream, width, height);
+        ExpectSame(
+                cherry::ConstCanvas(decoded),
+                cherry::ConstCanvas(image),
+                codec + " " + std::to_string(width) + "x" + std::to_string(height)
+        );
+    }
+}
+
+
+auto CodecRoundTrips() -> void {
+    ExpectRoundTrip(
+            "raw",
+            [](std::ostream & stream, const cherry::ConstCanvas & src) { cherry::io::WriteRaw(stream, src); },
+            [](std::istream & stream, int width, int height) {
+                auto buffer = cherry::utility::AlignedPixelBuffer(width, height);
+                auto canvas = cherry::Canvas(buffer);
+                cherry::io::ReadRaw(stream, canvas);
+                return buffer;
+            }
+    );
+    ExpectRoundTrip(
+            "BMP",
+            [](std::ostream & stream, const cherry::ConstCanvas & src) { cherry::io::WriteBmp(stream, src); },
+            [](std::istream & stream, int, int) { return cherry::io::Decode<cherry::io::BmpReader>(stream); }
+    );
+    ExpectRoundTrip(
+            "QOI",
+            [](std::ostream & stream, const cherry::ConstCanvas & src) { cherry::io::WriteQoi(stream, src); },
+            [](std::istream & stream, int, int) { return cherry::io::Decode<cherry::io::QoiReader>(stream); }
+    );
+
+    // Read into a canvas larger than the image, leaving the rest alone
+    const auto image = MakeCodecImage(13, 9, 5);
+    auto stream = std::stringstream();
+    cherry::io::WriteQoi(stream, cherry::ConstCanvas(image));
+
+    auto buffer = cherry::utility::AlignedPixelBuffer(20, 12);
+    auto canvas = cherry::Canvas(buffer);
+    FillPattern(canvas);
+    cherry::io::QoiReader(stream).Read(canvas);
+
+    auto expected = cherry::utility::AlignedPixelBuffer(20, 12);
+    auto expected_canvas = cherry::Canvas(expected);
+    FillPattern(expected_canvas);
+    cherry::transform::Copy<cherry::color::Overwrite>(cherry::ConstCanvas(image), expected_canvas);
+
+    ExpectSame(cherry::ConstCanvas(buffer), cherry::ConstCanvas(expected), "QOI into a larger canvas");
+}
+
+
+template<typename Exception, typename Fn>
+auto ExpectThrows(
+        const std::string & what,
+        Fn && fn) -> void {
+    try {
+        fn();
+    }
+    catch (const Exception &) {
+        return;
+    }
+
+    throw std::runtime_error(what + ": nothing thrown");
+}
+
+
+auto MalformedImagesThrow() -> void {
+    const auto image = MakeCodecImage(4, 3, 7);
+
+    auto bmp = std::stringstream();
+    cherry::io::WriteBmp(bmp, cherry::ConstCanvas(image));
+    const auto bmp_bytes = bmp.str();
+
+    // biHeight of INT32_MIN has no positive counterpart
+    auto min_height = bmp_bytes;
+    min_height[22] = 0;
+    min_height[23] = 0;
+    min_height[24] = 0;
+    min_height[25] = static_cast<char>(0x80);
+    ExpectThrows<std::invalid_argument>("BMP height INT32_MIN", [&] {
+        auto stream = std::stringstream(min_height);
+        [[maybe_unused]] const auto reader = cherry::io::BmpReader(stream);
+    });
+
+    ExpectThrows<std::runtime_error>("truncated BMP", [&] {
+        auto stream = std::stringstream(bmp_bytes.substr(0, bmp_bytes.size() - 5));
+        [[maybe_unused]] const auto decoded = cherry::io::Decode<cherry::io::BmpReader>(stream);
+    });
+
+    auto qoi = std::stringstream();
+    cherry::io::WriteQoi(qoi, cherry::ConstCanvas(image));
+    const auto qoi_bytes = qoi.str();
+
+    ExpectThrows<std::runtime_error>("truncated QOI", [&] {
+        auto stream = std::stringstream(qoi_bytes.substr(0, qoi_bytes.size() / 2));
+        [[maybe_unused]] const auto decoded = cherry::io::Decode<cherry::io::QoiReader>(stream);
+    });
+
+    ExpectThrows<std::invalid_argument>("QOI into a smaller canvas", [&] {
+        auto stream = std::stringstream(qoi_bytes);
+        auto buffer = cherry::utility::AlignedPixelBuffer(3, 3);
+        auto canvas = cherry::Canvas(buffer);
+        cherry::io::QoiReader(stream).Read(canvas);
+    });
+}
+
+
+// Renders frames numbered 1 to count, each cleared to its own number, and returns the numbers of the frames the
+// consumer was handed, having checked that every one arrived whole. The consumer dawdles now and then so that the
+// producer gets ahead of it.
+auto RunPipeline(
+        cherry::parallel::FramePipeline & pipeline,
+        int count) -> std::vector<uint64_t> {
+    auto producer = std::thread([&] {
+        for (auto i = 1; i <= count; i += 1) {
+            const auto frame = pipeline.AcquireRender();
+            cherry::drawing::Clear(frame->Pixels, static_cast<uint32_t>(i));
+            pipeline.ReleaseRender();
+        }
+        pipeline.Close();
+    });
+
+    auto presented = std::vector<uint64_t>();
+    auto torn = uint64_t{ 0 };
+    while (const auto frame = pipeline.AcquirePresent()) {
+        const auto & pixels = frame->Pixels;
+        const auto number = static_cast<uint32_t>(frame->Number);
+        if (pixels.RowUnchecked(0)[0] != number or pixels.RowUnchecked(pixels.Height - 1)[pixels.Width - 1] != number) {
+            torn = frame->Number;
+        }
+        presented.push_back(frame->Number);
+
+        if (0 == presented.size() % 7) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        pipeline.ReleasePresent();
+    }
+
+    producer.join();
+    Expect(0 == torn, "frame " + std::to_string(torn) + " was presented with another frame's pixels");
+
+    return presented;
+}
+
+
+// Queue must present every frame once and in order; Latest may skip frames but never go back, must end on the last
+// frame, and must count each frame it skipped as dropped.
+auto PipelinesKeepOrder() -> void {
+    using cherry::parallel::FramePipeline;
+    using cherry::parallel::Handoff;
+
+    constexpr auto count = 3000;
+
+    for (auto depth : { 2, 3, 5 }) {
+        auto pipeline = FramePipeline(37, 11, Handoff::Queue, depth);
+        const auto presented = RunPipeline(pipeline, count);
+
+        Expect(
+                presented.size() == count,
+                "Queue, depth " + std::to_string(depth) + ": presented " + std::to_string(presented.size()) + " of "
+                + std::to_string(count) + " frames"
+        );
+        for (auto i = size_t{ 0 }; i < presented.size(); i += 1) {
+            Expect(
+                    presented[i] == i + 1,
+                    "Queue, depth " + std::to_string(depth) + ": frame " + std::to_string(presented[i])
+                    + " presented in place of " + std::to_string(i + 1)
+            );
+        }
+    }
+
+    auto pipeline = FramePipeline(37, 11, Handoff::Latest);
+    const auto presented = RunPipeline(pipeline, count);
+
+    Expect(not presented.empty() and presented.back() == count, "Latest: the last frame was never presented");
+    for (auto i = size_t{ 1 }; i < presented.size(); i += 1) {
+        Expect(
+                presented[i] > presented[i - 1],
+                "Latest: frame " + std::to_string(presented[i]) + " presented after "
+                + std::to_string(presented[i - 1])
+        );
+    }
+    Expect(
+            presented.size() + pipeline.Dropped() == count,
+            "Latest: " + std::to_string(presented.size()) + " frames presented and "
+            + std::to_string(pipeline.Dropped()) + " dropped out of " + std::to_string(count)
+    );
+}
+
+
+#ifdef CHERRY_CLIP_BOUNDS
+
+constexpr auto PARENT_WIDTH = 64;
+constexpr auto PARENT_HEIGHT = 48;
+constexpr auto GUARD = 4;
+constexpr auto GUARD_COLOR = 0xDEADBEEFu;
+
+// Views of the parent, mostly hanging off one or more of its edges
+const auto VIEW_RECTS = std::vector<cherry::utility::Rect>{
+        { -8, -4, 32, 26 },
+        { -5, 0, 35, 30 },
+        { 0, -6, 40, 24 },
+        { 40, 30, 80, 60 },
+        { -20, -30, 90, 60 },
+        { -70, -10, -30, 20 },
+};
+
+
+// Draws into a view hanging off the edges of a parent and into a standalone canvas the size of the view, which holds
+// the same pixels as the view wherever the view is visible. The part of the parent under the view must come out as
+// the standalone canvas, the rest of the parent and the guard pixels around it untouched, and, when draw marks what
+// it touches, every changed pixel must be in the dirty region.
+auto ExpectClippedLikeUnclipped(
+        const std::string & name,
+        const std::function<void(cherry::Canvas &)> & draw,
+        bool marks_dirty = true) -> void {
+    for (const auto & rect : VIEW_RECTS) {
+        const auto where = name + " in view (" + std::to_string(rect.Left) + ", " + std::to_string(rect.Top) + ")";
+
+        auto storage = cherry::utility::AlignedPixelBuffer(
+                PARENT_WIDTH + 2 * GUARD,
+                PARENT_HEIGHT + 2 * GUARD,
+                GUARD_COLOR
+        );
+        auto parent = cherry::Canvas(storage).View(GUARD, GUARD, PARENT_WIDTH, PARENT_HEIGHT);
+        FillPattern(parent);
+
+        auto dirty = cherry::utility::DirtyRegion();
+        parent.TrackDirty(&dirty);
+
+        auto view = parent.View(rect.Left, rect.Top, rect.Width(), rect.Height());
+        Expect(
+                view.Data >= storage.Data() and view.Data < storage.Data() + storage.Size(),
+                where + ": view data lies outside its parent"
+        );
+        draw(view);
+
+        auto reference = cherry::utility::AlignedPixelBuffer(view.Width, view.Height);
+        auto reference_canvas = cherry::Canvas(reference);
+        FillPattern(reference_canvas, rect.Left, rect.Top);
+        draw(reference_canvas);
+
+        const auto in_view = [&](int x, int y) {
+            return x >= rect.Left and y >= rect.Top and x < rect.Left + view.Width and y < rect.Top + view.Height;
+        };
+        const auto rects = dirty.Rects();
+        const auto is_dirty = [&](int x, int y) {
+            return std::any_of(rects.begin(), rects.end(), [&](const cherry::utility::Rect & r) {
+                return x >= r.Left and y >= r.Top and x < r.Right and y < r.Bottom;
+            });
+        };
+
+        for (auto y = -GUARD; y < PARENT_HEIGHT + GUARD; y += 1) {
+            for (auto x = -GUARD; x < PARENT_WIDTH + GUARD; x += 1) {
+                const auto actual = storage.Data()[storage.Stride() * (y + GUARD) + x + GUARD];
+                const auto in_parent = x >= 0 and y >= 0 and x < PARENT_WIDTH and y < PARENT_HEIGHT;
+
+                auto expected = GUARD_COLOR;
+                if (in_parent) {
+                    expected = in_view(x, y)
+                               ? reference.Data()[reference.Stride() * (y - rect.Top) + x - rect.Left]
+                               : Pattern(x, y);
+                }
+
+                const auto at = " at parent pixel (" + std::to_string(x) + ", " + std::to_string(y) + ")";
+                Expect(actual == expected, where + ": " + Hex(actual) + ", expected " + Hex(expected) + at);
+                Expect(
+                        not marks_dirty or not in_parent or actual == Pattern(x, y) or is_dirty(x, y),
+                        where + ": not marked dirty" + at
+                );
+            }
+        }
+    }
+}
+
+
+auto ClippedViewsMatchUnclipped() -> void {
+    using namespace cherry::color;
+    using cherry::transform::Sampling;
+
+    const auto sprite_image = MakeImage(23, 17);
+    const auto sprite = cherry::ConstCanvas(sprite_image);
+    const auto mips = cherry::transform::MipChain(sprite);
+
+    const auto background_image = MakeImage(PARENT_WIDTH, PARENT_HEIGHT);
+    auto restored = cherry::utility::DirtyRegion();
+    restored.Add({ 2, 3, 20, 15 });
+    restored.Add({ 25, 0, 40, 40 });
+
+    const auto list = RandomCommands(3, 40, 30, sprite, 60);
+    const auto rotated = cherry::transform::Transform{
+            .RotationRadians = 0.6f,
+            .OriginX = 11,
+            .OriginY = 8,
+            .ScaleX = 1.4f,
+            .ScaleY = 0.9f,
+            .Filter = Sampling::Bilinear
+    };
+    const auto instances = std::vector<cherry::transform::Instance>{
+            { .X = 3, .Y = 2 },
+            { .X = 20, .Y = 10, .Source = { 4, 4, 15, 12 } },
+            { .X = 15, .Y = 15, .Tf = rotated },
+            { .X = -5, .Y = 25, .Tf = { .ScaleX = -1.5f, .ScaleY = 2.0f } },
+    };
+    const auto mesh = cherry::drawing::Mesh{
+            .Vertices = { { -3, -2 }, { 30, 4 }, { 12, 28 }, { 38, 29 } },
+            .Indices = { 0, 1, 2, 1, 3, 2 },
+            .Colors = { FromRGBA(200, 10, 10, 160), FromRGBA(10, 200, 10, 255) }
+    };
+    const auto flatten = [](bool pooled) {
+        return [pooled](cherry::Canvas & canvas) {
+            auto compositor = cherry::render::Compositor();
+            Populate(compositor);
+            for (const auto & edit : FRAME_EDITS) {
+                edit(compositor);
+                pooled ? compositor.Flatten(Pool(), canvas, 0x80402010u) : compositor.Flatten(canvas, 0x80402010u);
+            }
+        };
+    };
+
+    const auto cases = std::vector<std::pair<std::string, std::function<void(cherry::Canvas &)>>>{
+            { "Execute", [&](cherry::Canvas & c) { list.Execute(c); } },
+            { "TiledRenderer", [&](cherry::Canvas & c) { cherry::render::TiledRenderer(8).Render(list, c); } },
+            { "TiledRenderer pooled", [&](cherry::Canvas & c) { cherry::render::TiledRenderer(8).Render(Pool(), list, c); } },
+            { "Copy", [&](cherry::Canvas & c) { cherry::transform::Copy<AlphaBlend>(sprite, c, 3, 2); } },
+            {
+                    "Copy scaled",
+                    [&](cherry::Canvas & c) {
+                        cherry::transform::Copy<FastAlphaBlend>(sprite, c, 30, 4, { .ScaleX = -1.7f, .ScaleY = 1.3f });
+                    }
+            },
+            { "Copy rotated", [&](cherry::Canvas & c) { cherry::transform::Copy<FastAlphaBlend>(sprite, c, 12, 10, rotated); } },
+            { "Copy mips", [&](cherry::Canvas & c) { cherry::transform::Copy<FastAlphaBlend>(mips, c, 12, 10, rotated); } },
+            { "parallel::Copy", [&](cherry::Canvas & c) { cherry::parallel::Copy<AlphaBlend>(Pool(), sprite, c, 12, 10, rotated); } },
+            { "CopyBatch", [&](cherry::Canvas & c) { cherry::transform::CopyBatch<FastAlphaBlend>(sprite, c, instances); } },
+            {
+                    "parallel::CopyBatch",
+                    [&](cherry::Canvas & c) { cherry::parallel::CopyBatch<FastAlphaBlend>(Pool(), sprite, c, instances); }
+            },
+            { "Swizzle", [&](cherry::Canvas & c) { cherry::transform::Swizzle<RGBA, BGRA>(sprite, c); } },
+            {
+                    "FillRect",
+                    [&](cherry::Canvas & c) { cherry::drawing::FillRect<AlphaBlend>(c, { -3, 5, 30, 50 }, FromRGBA(9, 99, 199, 99)); }
+            },
+            {
+                    "FillRect linear gradient",
+                    [&](cherry::Canvas & c) {
+                        cherry::drawing::FillRect<FastAlphaBlend>(c, { -5, -5, 35, 20 }, cherry::drawing::LinearGradient{
+                                .X0 = 2.0f, .Y0 = 1.0f, .X1 = 30.0f, .Y1 = 17.0f,
+                                .Ramp = { FromRGBA(255, 0, 0, 40), FromRGBA(0, 0, 255, 220) }
+                        });
+                    }
+            },
+            {
+                    "FillRect radial gradient",
+                    [&](cherry::Canvas & c) {
+                        cherry::drawing::FillRect<AlphaBlend>(c, { 0, 0, 40, 30 }, cherry::drawing::RadialGradient{
+                                .CenterX = 10.0f, .CenterY = 12.0f, .Radius = 25.0f,
+                                .Ramp = { FromRGBA(255, 255, 0, 255), FromRGBA(0, 255, 255, 0) }
+                        });
+                    }
+            },
+            { "DrawMesh", [&](cherry::Canvas & c) { cherry::drawing::DrawMesh<FastAlphaBlend>(c, mesh, 2, 1); } },
+            { "parallel::DrawMesh", [&](cherry::Canvas & c) { cherry::parallel::DrawMesh<FastAlphaBlend>(Pool(), c, mesh, 2, 1); } },
+            { "Compositor::Flatten", flatten(false) },
+            { "Compositor::Flatten pooled", flatten(true) },
+    };
+
+    for (const auto &[name, draw] : cases) {
+        ExpectClippedLikeUnclipped(name, draw);
+    }
+
+    // Restore leaves marking to its caller, who already holds the region
+    ExpectClippedLikeUnclipped(
+            "Restore",
+            [&](cherry::Canvas & c) { cherry::transform::Restore(cherry::ConstCanvas(background_image), c, restored); },
+            false
+    );
+}
+
+
+// Readers decode from the canvas origin, so they must refuse a view clipped at its top or left edge and write nothing.
+auto ClippedViewsRejectReaders() -> void {
+    const auto image = MakeCodecImage(20, 15, 11);
+    const auto encode = [&](auto write) {
+        auto stream = std::stringstream();
+        write(stream, cherry::ConstCanvas(image));
+        return stream.str();
+    };
+
+    const auto raw = encode(cherry::io::WriteRaw);
+    const auto bmp = encode(cherry::io::WriteBmp);
+    const auto qoi = encode(cherry::io::WriteQoi);
+
+    const auto readers = std::vector<std::pair<std::string, std::function<void(cherry::Canvas &)>>>{
+            {
+                    "ReadRaw",
+                    [&](cherry::Canvas & c) {
+                        auto stream = std::stringstream(raw);
+                        cherry::io::ReadRaw(stream, c);
+                    }
+            },
+            {
+                    "BmpReader",
+                    [&](cherry::Canvas & c) {
+                        auto stream = std::stringstream(bmp);
+                        cherry::io::BmpReader(stream).Read(c);
+                    }
+            },
+            {
+                    "QoiReader",
+                    [&](cherry::Canvas & c) {
+                        auto stream = std::stringstream(qoi);
+                        cherry::io::QoiReader(stream).Read(c);
+                    }
+            },
+    };
+
+    for (const auto &[name, read] : readers) {
+        for (const auto & rect : { cherry::utility::Rect{ -8, -4, 12, 11 }, { -1, 0, 19, 15 }, { 0, -3, 20, 12 } }) {
+            auto storage = cherry::utility::AlignedPixelBuffer(PARENT_WIDTH + 2 * GUARD, PARENT_HEIGHT + 2 * GUARD, GUARD_COLOR);
+            auto parent = cherry::Canvas(storage).View(GUARD, GUARD, PARENT_WIDTH, PARENT_HEIGHT);
+            FillPattern(parent);
+
+            auto expected = cherry::utility::AlignedPixelBuffer(PARENT_WIDTH + 2 * GUARD, PARENT_HEIGHT + 2 * GUARD, GUARD_COLOR);
+            auto expected_parent = cherry::Canvas(expected).View(GUARD, GUARD, PARENT_WIDTH, PARENT_HEIGHT);
+            FillPattern(expected_parent);
+
+            auto view = parent.View(rect.Left, rect.Top, rect.Width(), rect.Height());
+            const auto where = name + " into view (" + std::to_string(rect.Left) + ", " + std::to_string(rect.Top) + ")";
+
+            ExpectThrows<std::invalid_argument>(where, [&] { read(view); });
+            ExpectSame(cherry::ConstCanvas(storage), cherry::ConstCanvas(expected), where);
+        }
+
+        // A view clipped only at its right and bottom edges is read into like any other canvas
+        auto storage = cherry::utility::AlignedPixelBuffer(PARENT_WIDTH, PARENT_HEIGHT);
+        auto view = cherry::Canvas(storage).View(PARENT_WIDTH - 20, PARENT_HEIGHT - 15, 30, 20);
+        read(view);
+
+        ExpectSame(
+                cherry::ConstCanvas(view),
+                cherry::ConstCanvas(image),
+                name + " into a view clipped at its right and bottom edges"
+        );
+    }
+}
+
+#endif
+
+
+auto Main() -> int {
+    const auto tests = std::vector<Test>{
+            { "Spans match scalar blends", SpansMatchScalar },
+            { "Fills match scalar blends", FillsMatchScalar },
+            { "Scaled copies match division", ScaledCopiesMatchDivision },
+            { "Mip copies match Copy", MipCopiesMatchCopy },
+            { "Batches match sequential copies", BatchesMatchCopies },
+            { "Triangles match edge functions", TrianglesMatchEdgeFunctions },
+            { "Polygons match winding numbers", PolygonsMatchWinding },
+            { "Lines match Bresenham", LinesMatchBresenham },
+            { "Tiled renderer matches serial Execute", TiledMatchesSerial },
+            { "Banded renderer matches serial Execute", BandedMatchesSerial },
+            { "Compositor matches multipass reference", CompositorMatchesMultipass },
+            { "Codec round trips", CodecRoundTrips },
+            { "Malformed images throw", MalformedImagesThrow },
+            { "Frame pipelines keep order", PipelinesKeepOrder },
+#ifdef CHERRY_CLIP_BOUNDS
+            { "Clipped views match unclipped canvases", ClippedViewsMatchUnclipped },
+            { "Clipped views reject readers", ClippedViewsRejectReaders },
+#endif
+    };
+
+    auto failures = 0;
+    for (const auto & test : tests) {
+        try {
+            test.Run();
+            std::cout << "[ OK ] " << test.Name << std::endl;
+        }
+        catch (const std::exception & e) {
+            std::cout << "[FAIL] " << test.Name << ": " << e.what() << std::endl;
+            failures += 1;
+        }
+    }
+
+    std::cout << tests.size() - failures << "/" << tests.size() << " passed" << std::endl;
+
+    return failures;
+}
+
+
+auto main() -> int {
+    return Main() ? EXIT_FAILURE : EXIT_SUCCESS;
+}